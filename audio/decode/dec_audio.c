@@ -28,6 +28,8 @@
 #include "common/codecs.h"
 #include "common/msg.h"
 #include "common/recorder.h"
+#include "common/perf_counters.h"
+#include "common/tracing.h"
 #include "misc/bstr.h"
 #include "options/options.h"
 
@@ -220,7 +222,13 @@ void audio_work(struct dec_audio *da)
         da->packet = NULL;
     }
 
-    if (da->ad_driver->send_packet(da, da->packet)) {
+    mp_trace_begin("audio-send-packet");
+    bool sent = da->ad_driver->send_packet(da, da->packet);
+    mp_trace_end("audio-send-packet");
+
+    if (sent) {
+        if (da->packet)
+            mp_perf_inc(MP_PERF_AUDIO_DEC_PACKETS);
         if (da->recorder_sink)
             mp_recorder_feed_packet(da->recorder_sink, da->packet);
 
@@ -228,7 +236,12 @@ void audio_work(struct dec_audio *da)
         da->packet = NULL;
     }
 
+    mp_trace_begin("audio-receive-frame");
     bool progress = da->ad_driver->receive_frame(da, &da->current_frame);
+    mp_trace_end("audio-receive-frame");
+
+    if (da->current_frame)
+        mp_perf_inc(MP_PERF_AUDIO_DEC_FRAMES);
 
     da->current_state = da->current_frame ? DATA_OK : DATA_AGAIN;
     if (!progress)
@@ -23,9 +23,12 @@
 
 #include "common/common.h"
 #include "common/global.h"
+#include "common/perf_counters.h"
+#include "common/tracing.h"
 
 #include "options/m_option.h"
 #include "options/m_config.h"
+#include "osdep/timer.h"
 
 #include "audio/audio_buffer.h"
 #include "af.h"
@@ -168,6 +171,8 @@ static struct af_instance *af_create(struct af_stream *s, char *name,
         .opts = s->opts,
         .global = s->global,
         .out_pool = mp_audio_pool_create(af),
+        .time_counter = mp_perf_counter_register(
+                            mp_tprintf(80, "af-%s-time-us", name)),
     };
     struct m_config *config =
         m_config_from_obj_desc_and_args(af, s->log, NULL, &desc,
@@ -520,6 +525,7 @@ struct af_stream *af_new(struct mpv_global *global)
         .filter_frame = dummy_filter,
         .priv = s,
         .data = &s->input,
+        .time_counter = -1,
     };
 
     static const struct af_info out = { .name = "out" };
@@ -532,6 +538,7 @@ struct af_stream *af_new(struct mpv_global *global)
         .filter_frame = dummy_filter,
         .priv = s,
         .data = &s->filter_output,
+        .time_counter = -1,
     };
 
     s->first->next = s->last;
@@ -708,10 +715,27 @@ void af_add_output_frame(struct af_instance *af, struct mp_audio *frame)
     }
 }
 
+// Time a call to one of the filter functions, for tracing and the
+// performance counters.
+static int64_t filter_begin(struct af_instance *af)
+{
+    mp_trace_begin(af->info->name);
+    return mp_time_us();
+}
+
+static void filter_end(struct af_instance *af, int64_t start)
+{
+    mp_perf_add(af->time_counter, mp_time_us() - start);
+    mp_trace_end(af->info->name);
+}
+
 static bool af_has_output_frame(struct af_instance *af)
 {
     if (!af->num_out_queued && af->filter_out) {
-        if (af->filter_out(af) < 0)
+        int64_t t = filter_begin(af);
+        int r = af->filter_out(af);
+        filter_end(af, t);
+        if (r < 0)
             MP_ERR(af, "Error filtering frame.\n");
     }
     return af->num_out_queued > 0;
@@ -741,7 +765,9 @@ static int af_do_filter(struct af_instance *af, struct mp_audio *frame)
 {
     if (frame)
         assert(mp_audio_config_equals(&af->fmt_in, frame));
+    int64_t t = filter_begin(af);
     int r = af->filter_frame(af, frame);
+    filter_end(af, t);
     if (r < 0)
         MP_ERR(af, "Error filtering frame.\n");
     return r;
@@ -86,6 +86,7 @@ struct af_instance {
     int num_out_queued;
 
     struct mp_audio_pool *out_pool;
+    int time_counter; // perf. counter for time spent filtering (-1 if none)
 };
 
 // Current audio stream
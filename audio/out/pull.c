@@ -25,6 +25,7 @@
 
 #include "common/msg.h"
 #include "common/common.h"
+#include "common/perf_counters.h"
 
 #include "input/input.h"
 
@@ -64,8 +65,6 @@ struct ao_pull_state {
 
     // Device delay of the last written sample, in realtime.
     atomic_llong end_time_us;
-
-    char *convert_buffer;
 };
 
 static void set_state(struct ao *ao, int new_state)
@@ -119,29 +118,55 @@ static int play(struct ao *ao, void **data, int samples, int flags)
     bool draining = write_samples == samples && (flags & AOPLAY_FINAL_CHUNK);
     atomic_store(&p->draining, draining);
 
+    mp_perf_inc(MP_PERF_AO_WRITES);
+
+    // (Counted here instead of in the audio callback, which must not block.)
     int underflow = atomic_fetch_and(&p->underflow, 0);
-    if (underflow)
+    if (underflow) {
         MP_WARN(ao, "Audio underflow by %d samples.\n", underflow);
+        mp_perf_inc(MP_PERF_AO_UNDERRUNS);
+    }
 
     return write_samples;
 }
 
-// Read the given amount of samples in the user-provided data buffer. Returns
-// the number of samples copied. If there is not enough data (buffer underrun
-// or EOF), return the number of samples that could be copied, and fill the
-// rest of the user-provided buffer with silence.
-// This basically assumes that the audio device doesn't care about underruns.
-// If this is called in paused mode, it will always return 0.
-// The caller should set out_time_us to the expected delay until the last sample
-// reaches the speakers, in microseconds, using mp_time_us() as reference.
-int ao_read_data(struct ao *ao, void **data, int samples, int64_t out_time_us)
+// Copy the first part of the spans to data (advancing the data pointers), and
+// leave the second part in the first. If fmt is not NULL, the samples are
+// post-processed and converted in place in the ring memory before copying.
+static void copy_span(struct ao *ao, struct ao_convert_fmt *fmt,
+                      struct mp_ring_span *spans, void **data)
 {
-    assert(ao->api == &ao_api_pull);
+    int bytes = spans[0].len[0];
+    void *src[MP_NUM_CHANNELS];
+    for (int n = 0; n < ao->num_planes; n++)
+        src[n] = spans[n].data[0];
+
+    if (fmt) {
+        int samples = bytes / ao->sstride;
+        ao_post_process_data(ao, src, samples);
+        ao_convert_inplace(fmt, src, samples);
+        bytes = bytes / af_fmt_to_bytes(fmt->src_fmt) * fmt->dst_bits / 8;
+    }
+
+    for (int n = 0; n < ao->num_planes; n++) {
+        memcpy(data[n], src[n], bytes);
+        data[n] = (char *)data[n] + bytes;
+        spans[n].data[0] = spans[n].data[1];
+        spans[n].len[0] = spans[n].len[1];
+        spans[n].len[1] = 0;
+    }
+}
 
+static int read_buffer(struct ao *ao, struct ao_convert_fmt *fmt, void **data,
+                       int samples, int64_t out_time_us)
+{
     struct ao_pull_state *p = ao->api_priv;
     int full_bytes = samples * ao->sstride;
     bool need_wakeup = false;
     int bytes = 0;
+    void *dst[MP_NUM_CHANNELS];
+    for (int n = 0; n < ao->num_planes; n++)
+        dst[n] = data[n];
 
     // Play silence in states other than AO_STATE_PLAY.
     if (!atomic_compare_exchange_strong(&p->state, &(int){AO_STATE_PLAY},
@@ -153,16 +178,24 @@ int ao_read_data(struct ao *ao, void **data, int samples, int64_t out_time_us)
     int buffered_bytes = mp_ring_buffered(p->buffers[0]);
     bytes = MPMIN(buffered_bytes, full_bytes);
 
-    if (buffered_bytes < bytes && !atomic_load(&p->draining))
-        atomic_fetch_add(&p->underflow, (bytes - buffered_bytes) / ao->sstride);
+    if (buffered_bytes < full_bytes && !atomic_load(&p->draining))
+        atomic_fetch_add(&p->underflow,
+                         (full_bytes - buffered_bytes) / ao->sstride);
 
     if (bytes > 0)
         atomic_store(&p->end_time_us, out_time_us);
 
+    // Access the data in place. All planes have the same size and position,
+    // so the spans are split at the same offset.
+    struct mp_ring_span spans[MP_NUM_CHANNELS];
     for (int n = 0; n < ao->num_planes; n++) {
-        int r = mp_ring_read(p->buffers[n], data[n], bytes);
-        bytes = MPMIN(bytes, r);
+        int r = mp_ring_peek(p->buffers[n], bytes, &spans[n]);
+        assert(r == bytes);
     }
+    copy_span(ao, fmt, spans, dst);
+    copy_span(ao, fmt, spans, dst);
+    for (int n = 0; n < ao->num_planes; n++)
+        mp_ring_drain(p->buffers[n], bytes);
 
     // Half of the buffer played -> request more.
     need_wakeup = buffered_bytes - bytes <= mp_ring_size(p->buffers[0]) / 2;
@@ -175,15 +208,39 @@ end:
     if (need_wakeup)
         ao->wakeup_cb(ao->wakeup_ctx);
 
-    // pad with silence (underflow/paused/eof)
-    for (int n = 0; n < ao->num_planes; n++)
-        af_fill_silence((char *)data[n] + bytes, full_bytes - bytes, ao->format);
+    if (!fmt)
+        ao_post_process_data(ao, data, bytes / ao->sstride);
 
-    ao_post_process_data(ao, data, samples);
+    // pad with silence (underflow/paused/eof)
+    int pad_bytes = full_bytes - bytes;
+    if (fmt) {
+        // Conversion only supports signed integer formats, where silence is 0.
+        pad_bytes = pad_bytes / af_fmt_to_bytes(fmt->src_fmt) * fmt->dst_bits / 8;
+        for (int n = 0; n < ao->num_planes; n++)
+            memset(dst[n], 0, pad_bytes);
+    } else {
+        for (int n = 0; n < ao->num_planes; n++)
+            af_fill_silence(dst[n], pad_bytes, ao->format);
+    }
 
     return bytes / ao->sstride;
 }
 
+// Read the given amount of samples in the user-provided data buffer. Returns
+// the number of samples copied. If there is not enough data (buffer underrun
+// or EOF), return the number of samples that could be copied, and fill the
+// rest of the user-provided buffer with silence.
+// This basically assumes that the audio device doesn't care about underruns.
+// If this is called in paused mode, it will always return 0.
+// The caller should set out_time_us to the expected delay until the last sample
+// reaches the speakers, in microseconds, using mp_time_us() as reference.
+int ao_read_data(struct ao *ao, void **data, int samples, int64_t out_time_us)
+{
+    assert(ao->api == &ao_api_pull);
+
+    return read_buffer(ao, NULL, data, samples, out_time_us);
+}
+
 // Same as ao_read_data(), but convert data according to *fmt.
 // fmt->src_fmt and fmt->channels must be the same as the AO parameters.
 int ao_read_data_converted(struct ao *ao, struct ao_convert_fmt *fmt,
@@ -191,37 +248,15 @@ int ao_read_data_converted(struct ao *ao, struct ao_convert_fmt *fmt,
 {
     assert(ao->api == &ao_api_pull);
 
-    struct ao_pull_state *p = ao->api_priv;
-    void *ndata[MP_NUM_CHANNELS] = {0};
-
     if (!ao_need_conversion(fmt))
         return ao_read_data(ao, data, samples, out_time_us);
 
     assert(ao->format == fmt->src_fmt);
     assert(ao->channels.num == fmt->channels);
 
-    bool planar = af_fmt_is_planar(fmt->src_fmt);
-    int planes = planar ? fmt->channels : 1;
-    int plane_samples = samples * (planar ? 1: fmt->channels);
-    int src_plane_size = plane_samples * af_fmt_to_bytes(fmt->src_fmt);
-    int dst_plane_size = plane_samples * fmt->dst_bits / 8;
-
-    int needed = src_plane_size * planes;
-    if (needed > talloc_get_size(p->convert_buffer) || !p->convert_buffer) {
-        talloc_free(p->convert_buffer);
-        p->convert_buffer = talloc_size(NULL, needed);
-    }
-
-    for (int n = 0; n < planes; n++)
-        ndata[n] = p->convert_buffer + n * src_plane_size;
-
-    int res = ao_read_data(ao, ndata, samples, out_time_us);
-
-    ao_convert_inplace(fmt, ndata, samples);
-    for (int n = 0; n < planes; n++)
-        memcpy(data[n], ndata[n], dst_plane_size);
-
-    return res;
+    // The samples are converted in the ringbuffer memory, and then copied
+    // to data, instead of going through an intermediate buffer.
+    return read_buffer(ao, fmt, data, samples, out_time_us);
 }
 
 static int control(struct ao *ao, enum aocontrol cmd, void *arg)
@@ -300,11 +335,7 @@ static void drain(struct ao *ao)
 
 static void uninit(struct ao *ao)
 {
-    struct ao_pull_state *p = ao->api_priv;
-
     ao->driver->uninit(ao);
-
-    talloc_free(p->convert_buffer);
 }
 
 static int init(struct ao *ao)
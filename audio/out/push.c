@@ -30,6 +30,8 @@
 
 #include "common/msg.h"
 #include "common/common.h"
+#include "common/perf_counters.h"
+#include "common/tracing.h"
 
 #include "input/input.h"
 
@@ -54,6 +56,7 @@ struct ao_push_state {
     bool terminate;
     bool wait_on_ao;
     bool still_playing;
+    bool underrun;
     bool need_wakeup;
     bool paused;
 
@@ -125,6 +128,7 @@ static void audio_pause(struct ao *ao)
     if (ao->driver->pause)
         ao->driver->pause(ao);
     p->paused = true;
+    p->underrun = true; // an empty device after resuming is not an underrun
     wakeup_playthread(ao);
     pthread_mutex_unlock(&p->lock);
 }
@@ -294,6 +298,14 @@ static void ao_play_data(struct ao *ao)
     } else {
         mp_audio_buffer_peek(p->buffer, &planes, &samples);
     }
+    if (!play_silence) {
+        // The device played everything it had while we were still playing.
+        bool underrun = p->still_playing && !p->final_chunk &&
+                        ao->device_buffer > 0 && space >= ao->device_buffer;
+        if (underrun && !p->underrun)
+            mp_perf_inc(MP_PERF_AO_UNDERRUNS);
+        p->underrun = underrun;
+    }
     int max = samples;
     if (samples > space)
         samples = space;
@@ -304,10 +316,14 @@ static void ao_play_data(struct ao *ao)
         samples = samples / ao->period_size * ao->period_size;
     }
     MP_STATS(ao, "start ao fill");
+    mp_trace_begin("ao-fill");
     ao_post_process_data(ao, (void **)planes, samples);
     int r = 0;
-    if (samples)
+    if (samples) {
         r = ao->driver->play(ao, (void **)planes, samples, flags);
+        mp_perf_inc(MP_PERF_AO_WRITES);
+    }
+    mp_trace_end("ao-fill");
     MP_STATS(ao, "end ao fill");
     if (r > samples) {
         MP_ERR(ao, "Audio device returned non-sense value.\n");
@@ -328,6 +344,7 @@ static void ao_play_data(struct ao *ao)
     }
     if (!play_silence)
         mp_audio_buffer_skip(p->buffer, r);
+    mp_trace_counter("ao-buffered", mp_audio_buffer_samples(p->buffer));
     if (r > 0)
         p->expected_end_time = 0;
     // Nothing written, but more input data than space - this must mean the
@@ -363,6 +380,7 @@ static void *playthread(void *arg)
 
         if (!p->need_wakeup) {
             MP_STATS(ao, "start audio wait");
+            mp_trace_begin("ao-wait");
             if (!p->wait_on_ao || !playing) {
                 // Avoid busy waiting, because the audio API will still report
                 // that it needs new data, even if we're not ready yet, or if
@@ -411,6 +429,7 @@ static void *playthread(void *arg)
                     }
                 }
             }
+            mp_trace_end("ao-wait");
             MP_STATS(ao, "end audio wait");
         }
         p->need_wakeup = false;
@@ -8,6 +8,8 @@ struct mpv_global {
     struct mp_log *log;
     struct m_config_shadow *config;
     struct mp_client_api *client_api;
+    // Shared directory listing cache (misc/dir_cache.h), can be NULL.
+    struct mp_dir_cache *dir_cache;
 
     // Using this is deprecated and should be avoided (missing synchronization).
     // Use m_config_cache to access mpv_global.config instead.
@@ -0,0 +1,58 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+
+#include "osdep/atomic.h"
+
+#include "mem_account.h"
+
+static atomic_llong usage[MP_MEM_DOMAIN_COUNT];
+
+static const char *const domain_names[MP_MEM_DOMAIN_COUNT] = {
+    [MP_MEM_DEMUXER_CACHE]  = "demuxer-cache",
+    [MP_MEM_STREAM_CACHE]   = "stream-cache",
+    [MP_MEM_IMAGE_POOLS]    = "image-pools",
+    [MP_MEM_SCRIPTS]        = "scripts",
+};
+
+void mp_mem_account(enum mp_mem_domain domain, int64_t delta)
+{
+    assert(domain >= 0 && domain < MP_MEM_DOMAIN_COUNT);
+    if (delta)
+        atomic_fetch_add(&usage[domain], delta);
+}
+
+int64_t mp_mem_get_usage(enum mp_mem_domain domain)
+{
+    assert(domain >= 0 && domain < MP_MEM_DOMAIN_COUNT);
+    return atomic_load_explicit(&usage[domain], memory_order_relaxed);
+}
+
+int64_t mp_mem_get_total_usage(void)
+{
+    int64_t total = 0;
+    for (int n = 0; n < MP_MEM_DOMAIN_COUNT; n++)
+        total += mp_mem_get_usage(n);
+    return total;
+}
+
+const char *mp_mem_domain_name(enum mp_mem_domain domain)
+{
+    assert(domain >= 0 && domain < MP_MEM_DOMAIN_COUNT);
+    return domain_names[domain];
+}
@@ -0,0 +1,47 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MP_MEM_ACCOUNT_H
+#define MP_MEM_ACCOUNT_H
+
+#include <stdint.h>
+
+// Memory domains. Each is a process-wide counter of bytes currently allocated
+// by a subsystem. The counters are updated by the code that owns the memory,
+// at the points where large buffers are allocated and freed. Small
+// allocations are not tracked.
+enum mp_mem_domain {
+    MP_MEM_DEMUXER_CACHE,   // packets buffered by the demuxer (demux.c)
+    MP_MEM_STREAM_CACHE,    // byte cache ringbuffer (stream/cache.c)
+    MP_MEM_IMAGE_POOLS,     // image data owned by mp_image_pools
+    MP_MEM_SCRIPTS,         // Lua and JavaScript heaps
+    MP_MEM_DOMAIN_COUNT
+};
+
+// Add delta bytes (can be negative) to the domain. Thread-safe.
+void mp_mem_account(enum mp_mem_domain domain, int64_t delta);
+
+// Bytes currently accounted to the domain.
+int64_t mp_mem_get_usage(enum mp_mem_domain domain);
+
+// Sum of all domains.
+int64_t mp_mem_get_total_usage(void);
+
+// Name of the domain, as used in the memory-usage property.
+const char *mp_mem_domain_name(enum mp_mem_domain domain);
+
+#endif
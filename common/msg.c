@@ -36,6 +36,7 @@
 #include "options/path.h"
 #include "osdep/terminal.h"
 #include "osdep/io.h"
+#include "osdep/threads.h"
 #include "osdep/timer.h"
 
 #include "libmpv/client.h"
@@ -43,6 +44,28 @@
 #include "msg.h"
 #include "msg_control.h"
 
+/* Messages which go to the terminal are printed synchronously (keeping them in
+ * order with the status line and other terminal output). Everything else (log
+ * file, --dump-stats file, client log buffers) is handled by a writer thread:
+ * mp_msg_va() formats the text into a per-thread buffer, and pushes a copy to
+ * a lock-free queue. If the writer can't keep up, the total size of the queued
+ * messages is bounded by MAX_QUEUED_BYTES, and new messages are dropped (which
+ * is reported in the log file and the log buffers).
+ */
+
+// Maximum size of all messages queued for the writer thread.
+#define MAX_QUEUED_BYTES (4 * 1024 * 1024)
+
+struct log_msg {
+    struct log_msg *next;
+    int level;
+    int terminal_level;         // of the mp_log at the time of logging
+    int64_t time;               // mp_time_us()
+    size_t size;                // allocation size for MAX_QUEUED_BYTES
+    char *prefix;               // verbose prefix
+    char *text;                 // full lines (single line for MSGL_STATS)
+};
+
 struct mp_log_root {
     struct mpv_global *global;
     // --- protected by mp_msg_lock
@@ -59,27 +82,41 @@ struct mp_log_root {
     bool force_stderr;
     struct mp_log_buffer **buffers;
     int num_buffers;
+    bool has_log_file;
+    bool has_stats_file;
+    // All mp_logs, so that their levels can be updated on changes.
+    struct mp_log **logs;
+    int num_logs;
+    bstr buffer;
+    // --- protected by writer_lock
     FILE *log_file;
     FILE *stats_file;
     char *log_path;
     char *stats_path;
+    bool writer_exit;
+    uint64_t dropped_reported;
+    // --- writer thread
+    pthread_t writer;
+    pthread_mutex_t writer_lock;
+    pthread_cond_t writer_wakeup;
     // --- must be accessed atomically
-    /* This is incremented every time the msglevels must be reloaded.
-     * (This is perhaps better than maintaining a globally accessible and
-     * synchronized mp_log tree.) */
-    atomic_ulong reload_counter;
-    // --- protected by mp_msg_lock
-    bstr buffer;
+    atomic_uintptr_t queue;     // struct log_msg stack (newest first)
+    atomic_bool writer_idle;    // writer might wait on writer_wakeup
+    atomic_bool async_outputs;  // whether the writer has anything to do
+    atomic_llong queued_bytes;
+    atomic_ullong dropped;
 };
 
 struct mp_log {
     struct mp_log_root *root;
     const char *prefix;
     const char *verbose_prefix;
-    int level;                  // minimum log level for any outputs
+    atomic_int level;           // minimum log level for any outputs
     int terminal_level;         // minimum log level for terminal output
-    atomic_ulong reload_counter;
+    int index;                  // in root->logs[]
+    // --- protected by mp_msg_lock
     char *partial;
+    atomic_bool has_partial;    // partial[0] != '\0'
 };
 
 struct mp_log_buffer {
@@ -93,8 +130,27 @@ struct mp_log_buffer {
 // Protects some (not all) state in mp_log_root
 static pthread_mutex_t mp_msg_lock = PTHREAD_MUTEX_INITIALIZER;
 
-static const struct mp_log null_log = {0};
-struct mp_log *const mp_null_log = (struct mp_log *)&null_log;
+static struct mp_log null_log = { .level = ATOMIC_VAR_INIT(-1) };
+struct mp_log *const mp_null_log = &null_log;
+
+// Per-thread buffer for formatting messages.
+struct format_buf {
+    char *text;
+    size_t size;
+};
+
+static pthread_once_t format_buf_once = PTHREAD_ONCE_INIT;
+static pthread_key_t format_buf_key;
+
+static void free_format_buf(void *p)
+{
+    talloc_free(p);
+}
+
+static void init_format_buf_key(void)
+{
+    pthread_key_create(&format_buf_key, free_format_buf);
+}
 
 static bool match_mod(const char *name, const char *mod)
 {
@@ -105,41 +161,44 @@ static bool match_mod(const char *name, const char *mod)
     return bstr_eatstart0(&b, mod) && (bstr_eatstart0(&b, "/") || !b.len);
 }
 
+// Called with mp_msg_lock held.
 static void update_loglevel(struct mp_log *log)
 {
     struct mp_log_root *root = log->root;
-    pthread_mutex_lock(&mp_msg_lock);
-    log->level = MSGL_STATUS + root->verbose; // default log level
+    int level = MSGL_STATUS + root->verbose; // default log level
     if (root->really_quiet)
-        log->level -= 10;
+        level -= 10;
     for (int n = 0; root->msg_levels && root->msg_levels[n * 2 + 0]; n++) {
         if (match_mod(log->verbose_prefix, root->msg_levels[n * 2 + 0]))
-            log->level = mp_msg_find_level(root->msg_levels[n * 2 + 1]);
+            level = mp_msg_find_level(root->msg_levels[n * 2 + 1]);
     }
-    log->terminal_level = log->level;
-    for (int n = 0; n < log->root->num_buffers; n++)
-        log->level = MPMAX(log->level, log->root->buffers[n]->level);
-    if (log->root->log_file)
-        log->level = MPMAX(log->level, MSGL_V);
-    if (log->root->stats_file)
-        log->level = MPMAX(log->level, MSGL_STATS);
-    atomic_store(&log->reload_counter, atomic_load(&log->root->reload_counter));
-    pthread_mutex_unlock(&mp_msg_lock);
+    log->terminal_level = level;
+    for (int n = 0; n < root->num_buffers; n++)
+        level = MPMAX(level, root->buffers[n]->level);
+    if (root->has_log_file)
+        level = MPMAX(level, MSGL_V);
+    if (root->has_stats_file)
+        level = MPMAX(level, MSGL_STATS);
+    atomic_store(&log->level, level);
+}
+
+// Called with mp_msg_lock held, whenever something affecting the log levels
+// changes. The levels are updated eagerly, so that mp_msg_test() doesn't need
+// to check for changes.
+static void update_all_loglevels(struct mp_log_root *root)
+{
+    for (int n = 0; n < root->num_logs; n++)
+        update_loglevel(root->logs[n]);
+    atomic_store(&root->async_outputs, root->num_buffers > 0 ||
+                 root->has_log_file || root->has_stats_file);
 }
 
 // Return whether the message at this verbosity level would be actually printed.
 // Thread-safety: see mp_msg().
 bool mp_msg_test(struct mp_log *log, int lev)
 {
-    struct mp_log_root *root = log->root;
-    if (!root)
-        return false;
-    if (atomic_load_explicit(&log->reload_counter, memory_order_relaxed) !=
-        atomic_load_explicit(&root->reload_counter, memory_order_relaxed))
-    {
-        update_loglevel(log);
-    }
-    return lev <= log->level;
+    // (Logs without root have level -1.)
+    return lev <= atomic_load_explicit(&log->level, memory_order_relaxed);
 }
 
 // Reposition cursor and clear lines for outputting the status line. In certain
@@ -281,60 +340,74 @@ static void print_terminal_line(struct mp_log *log, int lev,
     fflush(stream);
 }
 
-static void write_log_file(struct mp_log *log, int lev, char *text)
+// Push a copy of the text to the writer thread. Lock-free.
+static void queue_msg(struct mp_log *log, int lev, const char *text, size_t len)
 {
     struct mp_log_root *root = log->root;
 
-    if (!root->log_file || lev > MPMAX(MSGL_V, log->terminal_level))
+    if (!atomic_load_explicit(&root->async_outputs, memory_order_relaxed))
         return;
 
-    fprintf(root->log_file, "[%8.3f][%c][%s] %s",
-            (mp_time_us() - MP_START_TIME) / 1e6,
-            mp_log_levels[lev][0],
-            log->verbose_prefix, text);
-    fflush(root->log_file);
-}
+    size_t prefix_len = strlen(log->verbose_prefix);
+    size_t size = sizeof(struct log_msg) + prefix_len + 1 + len + 1;
+    if (atomic_fetch_add(&root->queued_bytes, size) + size > MAX_QUEUED_BYTES) {
+        atomic_fetch_add(&root->queued_bytes, -(long long)size);
+        atomic_fetch_add(&root->dropped, 1);
+        return;
+    }
 
-static void write_msg_to_buffers(struct mp_log *log, int lev, char *text)
-{
-    struct mp_log_root *root = log->root;
-    for (int n = 0; n < root->num_buffers; n++) {
-        struct mp_log_buffer *buffer = root->buffers[n];
-        int buffer_level = buffer->level;
-        if (buffer_level == MP_LOG_BUFFER_MSGL_TERM)
-            buffer_level = log->terminal_level;
-        if (lev <= buffer_level && lev != MSGL_STATUS) {
-            // Assuming a single writer (serialized by msg lock)
-            int avail = mp_ring_available(buffer->ring) / sizeof(void *);
-            if (avail < 1)
-                continue;
-            struct mp_log_buffer_entry *entry = talloc_ptrtype(NULL, entry);
-            if (avail > 1) {
-                *entry = (struct mp_log_buffer_entry) {
-                    .prefix = talloc_strdup(entry, log->verbose_prefix),
-                    .level = lev,
-                    .text = talloc_strdup(entry, text),
-                };
-            } else {
-                // write overflow message to signal that messages might be lost
-                *entry = (struct mp_log_buffer_entry) {
-                    .prefix = "overflow",
-                    .level = MSGL_FATAL,
-                    .text = "log message buffer overflow\n",
-                };
-            }
-            mp_ring_write(buffer->ring, (unsigned char *)&entry, sizeof(entry));
-            if (buffer->wakeup_cb)
-                buffer->wakeup_cb(buffer->wakeup_cb_ctx);
-        }
+    struct log_msg *msg = talloc_size(NULL, size);
+    *msg = (struct log_msg){
+        .level = lev,
+        .terminal_level = log->terminal_level,
+        .time = mp_time_us(),
+        .size = size,
+        .prefix = (char *)(msg + 1),
+    };
+    msg->text = msg->prefix + prefix_len + 1;
+    memcpy(msg->prefix, log->verbose_prefix, prefix_len + 1);
+    memcpy(msg->text, text, len);
+    msg->text[len] = '\0';
+
+    uintptr_t head = atomic_load(&root->queue);
+    do {
+        msg->next = (struct log_msg *)head;
+    } while (!atomic_compare_exchange_strong(&root->queue, &head, (uintptr_t)msg));
+
+    if (atomic_load(&root->writer_idle)) {
+        pthread_mutex_lock(&root->writer_lock);
+        pthread_cond_signal(&root->writer_wakeup);
+        pthread_mutex_unlock(&root->writer_lock);
     }
 }
 
-static void dump_stats(struct mp_log *log, int lev, char *text)
+// Format the message into the calling thread's buffer. Returns NULL on errors.
+static char *format_msg(size_t *out_len, const char *format, va_list va)
 {
-    struct mp_log_root *root = log->root;
-    if (lev == MSGL_STATS && root->stats_file)
-        fprintf(root->stats_file, "%"PRId64" %s\n", mp_time_us(), text);
+    pthread_once(&format_buf_once, init_format_buf_key);
+
+    struct format_buf *buf = pthread_getspecific(format_buf_key);
+    if (!buf) {
+        buf = talloc_zero(NULL, struct format_buf);
+        buf->size = 256;
+        buf->text = talloc_size(buf, buf->size);
+        pthread_setspecific(format_buf_key, buf);
+    }
+
+    va_list copy;
+    va_copy(copy, va);
+    int len = vsnprintf(buf->text, buf->size, format, copy);
+    va_end(copy);
+    if (len < 0)
+        return NULL;
+    if (len >= buf->size) {
+        buf->size = len + 1;
+        buf->text = talloc_realloc_size(buf, buf->text, buf->size);
+        vsnprintf(buf->text, buf->size, format, va);
+    }
+
+    *out_len = len;
+    return buf->text;
 }
 
 void mp_msg_va(struct mp_log *log, int lev, const char *format, va_list va)
@@ -342,23 +415,36 @@ void mp_msg_va(struct mp_log *log, int lev, const char *format, va_list va)
     if (!mp_msg_test(log, lev))
         return; // do not display
 
-    pthread_mutex_lock(&mp_msg_lock);
-
     struct mp_log_root *root = log->root;
 
+    size_t len;
+    char *text = format_msg(&len, format, va);
+    if (!text)
+        return;
+
+    if (lev == MSGL_STATS) {
+        queue_msg(log, lev, text, len);
+        return;
+    }
+
+    // Full lines, which don't go to the terminal, don't need the lock.
+    if (lev != MSGL_STATUS && !test_terminal_level(log, lev) &&
+        len && text[len - 1] == '\n' && !atomic_load(&log->has_partial))
+    {
+        queue_msg(log, lev, text, len);
+        return;
+    }
+
+    pthread_mutex_lock(&mp_msg_lock);
+
     root->buffer.len = 0;
 
-    if (log->partial[0])
-        bstr_xappend_asprintf(root, &root->buffer, "%s", log->partial);
+    bstr_xappend_asprintf(root, &root->buffer, "%s%s", log->partial, text);
     log->partial[0] = '\0';
 
-    bstr_xappend_vasprintf(root, &root->buffer, format, va);
-
-    char *text = root->buffer.start;
+    text = root->buffer.start;
 
-    if (lev == MSGL_STATS) {
-        dump_stats(log, lev, text);
-    } else if (lev == MSGL_STATUS && !test_terminal_level(log, lev)) {
+    if (lev == MSGL_STATUS && !test_terminal_level(log, lev)) {
         /* discard */
     } else {
         if (lev == MSGL_STATUS && root->termosd)
@@ -374,12 +460,14 @@ void mp_msg_va(struct mp_log *log, int lev, const char *format, va_list va)
             char saved = next[0];
             next[0] = '\0';
             print_terminal_line(log, lev, text, "");
-            write_log_file(log, lev, text);
-            write_msg_to_buffers(log, lev, text);
             next[0] = saved;
             text = next;
         }
 
+        char *start = root->buffer.start;
+        if (text > start)
+            queue_msg(log, lev, start, text - start);
+
         if (lev == MSGL_STATUS) {
             if (text[0])
                 print_terminal_line(log, lev, text, root->termosd ? "\r" : "\n");
@@ -391,12 +479,170 @@ void mp_msg_va(struct mp_log *log, int lev, const char *format, va_list va)
         }
     }
 
+    atomic_store(&log->has_partial, log->partial[0] != '\0');
+
     pthread_mutex_unlock(&mp_msg_lock);
 }
 
+// Write the message to the log and stats files. Called with writer_lock held.
+static void write_msg_to_files(struct mp_log_root *root, struct log_msg *msg)
+{
+    int lev = msg->level;
+
+    if (lev == MSGL_STATS) {
+        if (root->stats_file)
+            fprintf(root->stats_file, "%"PRId64" %s\n", msg->time, msg->text);
+        return;
+    }
+
+    if (!root->log_file || lev > MPMAX(MSGL_V, msg->terminal_level))
+        return;
+
+    char *text = msg->text;
+    while (text[0]) {
+        char *end = strchr(text, '\n');
+        int len = end ? end - text + 1 : strlen(text);
+        fprintf(root->log_file, "[%8.3f][%c][%s] %.*s",
+                (msg->time - MP_START_TIME) / 1e6,
+                mp_log_levels[lev][0], msg->prefix, len, text);
+        text += len;
+    }
+}
+
+// Called with mp_msg_lock held.
+static void write_msg_to_buffers(struct mp_log_root *root, struct log_msg *msg)
+{
+    int lev = msg->level;
+    if (lev == MSGL_STATUS || lev == MSGL_STATS)
+        return;
+
+    for (int n = 0; n < root->num_buffers; n++) {
+        struct mp_log_buffer *buffer = root->buffers[n];
+        int buffer_level = buffer->level;
+        if (buffer_level == MP_LOG_BUFFER_MSGL_TERM)
+            buffer_level = msg->terminal_level;
+        if (lev > buffer_level)
+            continue;
+        char *text = msg->text;
+        while (text[0]) {
+            char *end = strchr(text, '\n');
+            int len = end ? end - text + 1 : strlen(text);
+            // Assuming a single writer (serialized by msg lock)
+            int avail = mp_ring_available(buffer->ring) / sizeof(void *);
+            if (avail < 1)
+                break;
+            struct mp_log_buffer_entry *entry = talloc_ptrtype(NULL, entry);
+            if (avail > 1) {
+                *entry = (struct mp_log_buffer_entry) {
+                    .prefix = talloc_strdup(entry, msg->prefix),
+                    .level = lev,
+                    .text = talloc_strndup(entry, text, len),
+                };
+            } else {
+                // write overflow message to signal that messages might be lost
+                *entry = (struct mp_log_buffer_entry) {
+                    .prefix = "overflow",
+                    .level = MSGL_FATAL,
+                    .text = "log message buffer overflow\n",
+                };
+            }
+            mp_ring_write(buffer->ring, (unsigned char *)&entry, sizeof(entry));
+            if (buffer->wakeup_cb)
+                buffer->wakeup_cb(buffer->wakeup_cb_ctx);
+            text += len;
+        }
+    }
+}
+
+static void *writer_thread(void *p)
+{
+    struct mp_log_root *root = p;
+
+    mpthread_set_name("msg");
+
+    pthread_mutex_lock(&root->writer_lock);
+    while (1) {
+        atomic_store(&root->writer_idle, true);
+        struct log_msg *list = (void *)atomic_exchange(&root->queue, 0);
+        if (!list) {
+            if (root->writer_exit)
+                break;
+            pthread_cond_wait(&root->writer_wakeup, &root->writer_lock);
+            continue;
+        }
+        atomic_store(&root->writer_idle, false);
+
+        // The queue is a stack; restore the original order.
+        struct log_msg *msgs = NULL;
+        while (list) {
+            struct log_msg *next = list->next;
+            list->next = msgs;
+            msgs = list;
+            list = next;
+        }
+
+        // Report dropped messages after the messages that were not dropped.
+        uint64_t dropped = atomic_load(&root->dropped);
+        struct log_msg drop_msg = {
+            .level = MSGL_WARN,
+            .terminal_level = MSGL_WARN,
+            .time = mp_time_us(),
+            .prefix = "msg",
+        };
+        if (dropped != root->dropped_reported) {
+            drop_msg.text = talloc_asprintf(NULL, "%"PRIu64" log messages "
+                                "dropped (writing logs is too slow).\n",
+                                dropped - root->dropped_reported);
+            root->dropped_reported = dropped;
+            struct log_msg **last = &msgs;
+            while (*last)
+                last = &(*last)->next;
+            *last = &drop_msg;
+        }
+
+        for (struct log_msg *msg = msgs; msg; msg = msg->next)
+            write_msg_to_files(root, msg);
+        if (root->log_file)
+            fflush(root->log_file);
+        if (root->stats_file)
+            fflush(root->stats_file);
+        pthread_mutex_unlock(&root->writer_lock);
+
+        pthread_mutex_lock(&mp_msg_lock);
+        for (struct log_msg *msg = msgs; msg; msg = msg->next)
+            write_msg_to_buffers(root, msg);
+        pthread_mutex_unlock(&mp_msg_lock);
+
+        while (msgs) {
+            struct log_msg *next = msgs->next;
+            if (msgs != &drop_msg) {
+                atomic_fetch_add(&root->queued_bytes, -(long long)msgs->size);
+                talloc_free(msgs);
+            }
+            msgs = next;
+        }
+        talloc_free(drop_msg.text);
+
+        pthread_mutex_lock(&root->writer_lock);
+    }
+    pthread_mutex_unlock(&root->writer_lock);
+
+    return NULL;
+}
+
 static void destroy_log(void *ptr)
 {
     struct mp_log *log = ptr;
+    struct mp_log_root *root = log->root;
+
+    pthread_mutex_lock(&mp_msg_lock);
+    assert(root->logs[log->index] == log);
+    struct mp_log *last = root->logs[root->num_logs - 1];
+    root->logs[log->index] = last;
+    last->index = log->index;
+    root->num_logs--;
+    pthread_mutex_unlock(&mp_msg_lock);
+
     // This is not managed via talloc itself, because mp_msg calls must be
     // thread-safe, while talloc is not thread-safe.
     talloc_free(log->partial);
@@ -416,8 +662,10 @@ struct mp_log *mp_log_new(void *talloc_ctx, struct mp_log *parent,
 {
     assert(parent);
     struct mp_log *log = talloc_zero(talloc_ctx, struct mp_log);
-    if (!parent->root)
+    if (!parent->root) {
+        atomic_store(&log->level, -1);
         return log; // same as null_log
+    }
     talloc_set_destructor(log, destroy_log);
     log->root = parent->root;
     log->partial = talloc_strdup(NULL, "");
@@ -443,6 +691,14 @@ struct mp_log *mp_log_new(void *talloc_ctx, struct mp_log *parent,
         log->prefix = talloc_strdup(log, parent->prefix);
         log->verbose_prefix = talloc_strdup(log, parent->verbose_prefix);
     }
+
+    struct mp_log_root *root = log->root;
+    pthread_mutex_lock(&mp_msg_lock);
+    log->index = root->num_logs;
+    MP_TARRAY_APPEND(root, root->logs, root->num_logs, log);
+    update_loglevel(log);
+    pthread_mutex_unlock(&mp_msg_lock);
+
     return log;
 }
 
@@ -453,8 +709,11 @@ void mp_msg_init(struct mpv_global *global)
     struct mp_log_root *root = talloc_zero(NULL, struct mp_log_root);
     *root = (struct mp_log_root){
         .global = global,
-        .reload_counter = ATOMIC_VAR_INIT(1),
     };
+    pthread_mutex_init(&root->writer_lock, NULL);
+    pthread_cond_init(&root->writer_wakeup, NULL);
+    if (pthread_create(&root->writer, NULL, writer_thread, root))
+        abort();
 
     struct mp_log dummy = { .root = root };
     struct mp_log *log = mp_log_new(root, &dummy, "");
@@ -467,10 +726,12 @@ void mp_msg_init(struct mpv_global *global)
 // If opt is different from *current_path, reopen *file and update *current_path.
 // If there's an error, _append_ it to err_buf.
 // *current_path and *file are, rather trickily, only accessible under the
-// mp_msg_lock.
+// writer_lock. *is_open is set under mp_msg_lock.
 static void reopen_file(char *opt, char **current_path, FILE **file,
-                        const char *type, struct mpv_global *global)
+                        bool *is_open, const char *type,
+                        struct mpv_global *global)
 {
+    struct mp_log_root *root = global->log->root;
     void *tmp = talloc_new(NULL);
     bool fail = false;
 
@@ -478,7 +739,7 @@ static void reopen_file(char *opt, char **current_path, FILE **file,
     if (!new_path)
         new_path = "";
 
-    pthread_mutex_lock(&mp_msg_lock); // for *current_path/*file
+    pthread_mutex_lock(&root->writer_lock); // for *current_path/*file
 
     char *old_path = *current_path ? *current_path : "";
     if (strcmp(old_path, new_path) != 0) {
@@ -492,7 +753,15 @@ static void reopen_file(char *opt, char **current_path, FILE **file,
             fail = !*file;
         }
     }
+    bool open = !!*file;
+
+    pthread_mutex_unlock(&root->writer_lock);
 
+    pthread_mutex_lock(&mp_msg_lock);
+    if (*is_open != open) {
+        *is_open = open;
+        update_all_loglevels(root);
+    }
     pthread_mutex_unlock(&mp_msg_lock);
 
     if (fail)
@@ -525,14 +794,14 @@ void mp_msg_update_msglevels(struct mpv_global *global)
     m_option_type_msglevels.copy(NULL, &root->msg_levels,
                                  &global->opts->msg_levels);
 
-    atomic_fetch_add(&root->reload_counter, 1);
+    update_all_loglevels(root);
     pthread_mutex_unlock(&mp_msg_lock);
 
     reopen_file(opts->log_file, &root->log_path, &root->log_file,
-                "log", global);
+                &root->has_log_file, "log", global);
 
     reopen_file(opts->dump_stats, &root->stats_path, &root->stats_file,
-                "stats", global);
+                &root->has_stats_file, "stats", global);
 }
 
 void mp_msg_force_stderr(struct mpv_global *global, bool force_stderr)
@@ -549,7 +818,7 @@ bool mp_msg_has_log_file(struct mpv_global *global)
     struct mp_log_root *root = global->log->root;
 
     pthread_mutex_lock(&mp_msg_lock);
-    bool res = !!root->log_file;
+    bool res = root->has_log_file;
     pthread_mutex_unlock(&mp_msg_lock);
 
     return res;
@@ -558,6 +827,18 @@ bool mp_msg_has_log_file(struct mpv_global *global)
 void mp_msg_uninit(struct mpv_global *global)
 {
     struct mp_log_root *root = global->log->root;
+
+    talloc_free(global->log);
+
+    // The writer thread exits after writing all queued messages.
+    pthread_mutex_lock(&root->writer_lock);
+    root->writer_exit = true;
+    pthread_cond_signal(&root->writer_wakeup);
+    pthread_mutex_unlock(&root->writer_lock);
+    pthread_join(root->writer, NULL);
+    pthread_cond_destroy(&root->writer_wakeup);
+    pthread_mutex_destroy(&root->writer_lock);
+
     if (root->stats_file)
         fclose(root->stats_file);
     talloc_free(root->stats_path);
@@ -595,7 +876,7 @@ struct mp_log_buffer *mp_msg_log_buffer_new(struct mpv_global *global,
 
     MP_TARRAY_APPEND(root, root->buffers, root->num_buffers, buffer);
 
-    atomic_fetch_add(&root->reload_counter, 1);
+    update_all_loglevels(root);
     pthread_mutex_unlock(&mp_msg_lock);
 
     return buffer;
@@ -628,7 +909,7 @@ found:
     }
     talloc_free(buffer);
 
-    atomic_fetch_add(&root->reload_counter, 1);
+    update_all_loglevels(root);
     pthread_mutex_unlock(&mp_msg_lock);
 }
 
@@ -0,0 +1,175 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/* Performance counters:
+ *
+ * Every thread that updates a counter gets its own block of counter values,
+ * which only it writes to. Updating a counter is therefore a relaxed load and
+ * store without any locking or cache line bouncing. Reading a counter sums
+ * the values of all blocks.
+ *
+ * Blocks are never freed, and keep their values when their thread exits, so
+ * that the sums never decrease. The block of an exited thread is reused by
+ * the next new thread. If there are too many threads, the remaining ones
+ * share a block, and use atomic additions instead.
+ */
+
+#include <string.h>
+#include <pthread.h>
+
+#include "mpv_talloc.h"
+#include "common/common.h"
+#include "osdep/atomic.h"
+
+#include "perf_counters.h"
+
+#define MAX_BLOCKS 256
+
+struct counter_block {
+    bool dead;      // protected by lock
+    bool shared;
+    atomic_ullong values[MP_PERF_MAX_COUNTERS];
+};
+
+static const char *const fixed_names[MP_PERF_NUM_FIXED] = {
+    [MP_PERF_DEMUX_VIDEO_PACKETS]   = "demux-video-packets",
+    [MP_PERF_DEMUX_AUDIO_PACKETS]   = "demux-audio-packets",
+    [MP_PERF_DEMUX_SUB_PACKETS]     = "demux-sub-packets",
+    [MP_PERF_DEMUX_VIDEO_DROPPED]   = "demux-video-dropped",
+    [MP_PERF_DEMUX_AUDIO_DROPPED]   = "demux-audio-dropped",
+    [MP_PERF_DEMUX_SUB_DROPPED]     = "demux-sub-dropped",
+    [MP_PERF_VIDEO_DEC_PACKETS]     = "video-decoder-packets",
+    [MP_PERF_VIDEO_DEC_FRAMES]      = "video-decoder-frames",
+    [MP_PERF_VIDEO_DEC_DROPPED]     = "video-decoder-dropped",
+    [MP_PERF_AUDIO_DEC_PACKETS]     = "audio-decoder-packets",
+    [MP_PERF_AUDIO_DEC_FRAMES]      = "audio-decoder-frames",
+    [MP_PERF_VO_RENDERED]           = "vo-rendered",
+    [MP_PERF_VO_REDRAWN]            = "vo-redrawn",
+    [MP_PERF_VO_DROPPED]            = "vo-dropped",
+    [MP_PERF_AO_WRITES]             = "ao-writes",
+    [MP_PERF_AO_UNDERRUNS]          = "ao-underruns",
+};
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static struct counter_block *blocks[MAX_BLOCKS];
+static int num_blocks;
+static struct counter_block shared_block = {.shared = true};
+static char *names[MP_PERF_MAX_COUNTERS];
+static int num_counters = MP_PERF_NUM_FIXED;
+
+static pthread_once_t thread_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t thread_key;
+
+static void free_thread(void *p)
+{
+    struct counter_block *b = p;
+    if (!b->shared) {
+        pthread_mutex_lock(&lock);
+        b->dead = true;
+        pthread_mutex_unlock(&lock);
+    }
+}
+
+static void init_thread_key(void)
+{
+    pthread_key_create(&thread_key, free_thread);
+}
+
+static struct counter_block *get_block(void)
+{
+    pthread_once(&thread_key_once, init_thread_key);
+
+    struct counter_block *b = pthread_getspecific(thread_key);
+    if (b)
+        return b;
+
+    pthread_mutex_lock(&lock);
+    for (int n = 0; n < num_blocks; n++) {
+        if (blocks[n]->dead) {
+            b = blocks[n];
+            b->dead = false;
+            break;
+        }
+    }
+    if (!b && num_blocks < MAX_BLOCKS) {
+        b = talloc_zero(NULL, struct counter_block);
+        blocks[num_blocks++] = b;
+    }
+    if (!b)
+        b = &shared_block;
+    pthread_mutex_unlock(&lock);
+
+    pthread_setspecific(thread_key, b);
+    return b;
+}
+
+void mp_perf_add(int id, uint64_t value)
+{
+    if (id < 0 || id >= MP_PERF_MAX_COUNTERS)
+        return;
+    struct counter_block *b = get_block();
+    atomic_ullong *v = &b->values[id];
+    if (b->shared) {
+        atomic_fetch_add(v, value);
+    } else {
+        uint64_t cur = atomic_load_explicit(v, memory_order_relaxed);
+        atomic_store_explicit(v, cur + value, memory_order_relaxed);
+    }
+}
+
+int mp_perf_counter_register(const char *name)
+{
+    int id = -1;
+    pthread_mutex_lock(&lock);
+    for (int n = 0; n < num_counters; n++) {
+        if (strcmp(mp_perf_counter_name(n), name) == 0) {
+            id = n;
+            break;
+        }
+    }
+    if (id < 0 && num_counters < MP_PERF_MAX_COUNTERS) {
+        id = num_counters++;
+        names[id] = talloc_strdup(NULL, name);
+    }
+    pthread_mutex_unlock(&lock);
+    return id;
+}
+
+int mp_perf_counters_get(uint64_t *values)
+{
+    pthread_mutex_lock(&lock);
+    int num = num_counters;
+    for (int n = 0; n < num; n++)
+        values[n] = atomic_load_explicit(&shared_block.values[n],
+                                         memory_order_relaxed);
+    for (int i = 0; i < num_blocks; i++) {
+        for (int n = 0; n < num; n++) {
+            values[n] += atomic_load_explicit(&blocks[i]->values[n],
+                                              memory_order_relaxed);
+        }
+    }
+    pthread_mutex_unlock(&lock);
+    return num;
+}
+
+const char *mp_perf_counter_name(int id)
+{
+    if (id < 0 || id >= MP_PERF_MAX_COUNTERS)
+        return NULL;
+    return id < MP_PERF_NUM_FIXED ? fixed_names[id] : names[id];
+}
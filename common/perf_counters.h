@@ -0,0 +1,66 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MP_PERF_COUNTERS_H
+#define MP_PERF_COUNTERS_H
+
+#include <stdint.h>
+
+// Counters that are always active. They only ever increase (until the process
+// exits), so readers compute rates from the difference of two samples.
+enum mp_perf_counter {
+    MP_PERF_DEMUX_VIDEO_PACKETS,
+    MP_PERF_DEMUX_AUDIO_PACKETS,
+    MP_PERF_DEMUX_SUB_PACKETS,
+    MP_PERF_DEMUX_VIDEO_DROPPED,
+    MP_PERF_DEMUX_AUDIO_DROPPED,
+    MP_PERF_DEMUX_SUB_DROPPED,
+    MP_PERF_VIDEO_DEC_PACKETS,
+    MP_PERF_VIDEO_DEC_FRAMES,
+    MP_PERF_VIDEO_DEC_DROPPED,
+    MP_PERF_AUDIO_DEC_PACKETS,
+    MP_PERF_AUDIO_DEC_FRAMES,
+    MP_PERF_VO_RENDERED,
+    MP_PERF_VO_REDRAWN,
+    MP_PERF_VO_DROPPED,
+    MP_PERF_AO_WRITES,
+    MP_PERF_AO_UNDERRUNS,
+    MP_PERF_NUM_FIXED,
+    // Counters registered with mp_perf_counter_register() follow.
+};
+
+// Maximum number of counters (fixed and registered).
+#define MP_PERF_MAX_COUNTERS 256
+
+// Add value to the counter. This is cheap: the calling thread updates its own
+// copy of the counters with relaxed atomics. id < 0 is ignored.
+void mp_perf_add(int id, uint64_t value);
+
+#define mp_perf_inc(id) mp_perf_add(id, 1)
+
+// Return the ID of the counter with the given name, and create it if it does
+// not exist yet. Returns -1 if there are too many counters. IDs and names
+// stay valid until the process exits.
+int mp_perf_counter_register(const char *name);
+
+// Store the sum over all threads of each counter to values (which must have
+// MP_PERF_MAX_COUNTERS entries), and return the number of counters.
+int mp_perf_counters_get(uint64_t *values);
+
+const char *mp_perf_counter_name(int id);
+
+#endif
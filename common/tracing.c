@@ -0,0 +1,292 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Timeline tracing:
+ *
+ * Every thread that records an event gets its own fixed size ring buffer, so
+ * recording an event is a few stores without any locking. Only the owning
+ * thread writes to a buffer. Old events are overwritten when the buffer is
+ * full, so a dump contains the most recent events of each thread.
+ *
+ * Buffers are never freed, because a dump may read them concurrently. When a
+ * thread exits, its buffer is marked as dead; it is kept around for dumping,
+ * and reused for a new thread only when the limit of buffers is reached.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+#include <pthread.h>
+
+#include "mpv_talloc.h"
+#include "common/common.h"
+#include "common/msg.h"
+#include "osdep/atomic.h"
+#include "osdep/io.h"
+#include "osdep/timer.h"
+
+#include "tracing.h"
+
+#define EVENTS_PER_THREAD 16384 // must be a power of 2
+#define MAX_BUFFERS 256
+
+struct trace_event {
+    int64_t time;
+    const char *name;
+    double value;
+    int type;
+};
+
+struct trace_buffer {
+    // All fields except the events are protected by buffers_lock.
+    int tid;
+    char name[32];
+    bool dead;
+    // Number of events ever written. Written by the owner thread only.
+    atomic_ullong pos;
+    struct trace_event events[EVENTS_PER_THREAD];
+};
+
+// Per-thread state.
+struct trace_thread {
+    char name[32];
+    struct trace_buffer *buffer;
+};
+
+atomic_bool mp_tracing_active = ATOMIC_VAR_INIT(false);
+
+static pthread_mutex_t buffers_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct trace_buffer *buffers[MAX_BUFFERS];
+static int num_buffers;
+static int next_tid;
+static int num_users;
+static int64_t start_time;
+
+static pthread_once_t thread_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t thread_key;
+
+static void free_thread(void *p)
+{
+    struct trace_thread *t = p;
+    if (t->buffer) {
+        pthread_mutex_lock(&buffers_lock);
+        t->buffer->dead = true;
+        pthread_mutex_unlock(&buffers_lock);
+    }
+    talloc_free(t);
+}
+
+static void init_thread_key(void)
+{
+    pthread_key_create(&thread_key, free_thread);
+}
+
+static struct trace_thread *get_thread(void)
+{
+    pthread_once(&thread_key_once, init_thread_key);
+
+    struct trace_thread *t = pthread_getspecific(thread_key);
+    if (!t) {
+        t = talloc_zero(NULL, struct trace_thread);
+        pthread_setspecific(thread_key, t);
+    }
+    return t;
+}
+
+// Returns NULL if no buffer is available.
+static struct trace_buffer *get_buffer(struct trace_thread *t)
+{
+    pthread_mutex_lock(&buffers_lock);
+    struct trace_buffer *buf = NULL;
+    if (num_buffers < MAX_BUFFERS) {
+        buf = talloc_zero(NULL, struct trace_buffer);
+        buffers[num_buffers++] = buf;
+    } else {
+        for (int n = 0; n < num_buffers; n++) {
+            if (buffers[n]->dead) {
+                buf = buffers[n];
+                // The events of the exited thread are lost.
+                atomic_store(&buf->pos, 0);
+                buf->dead = false;
+                break;
+            }
+        }
+    }
+    if (buf) {
+        buf->tid = ++next_tid;
+        snprintf(buf->name, sizeof(buf->name), "%s", t->name);
+    }
+    pthread_mutex_unlock(&buffers_lock);
+    return buf;
+}
+
+void mp_tracing_event(int type, const char *name, double value)
+{
+    struct trace_thread *t = get_thread();
+    if (!t->buffer) {
+        t->buffer = get_buffer(t);
+        if (!t->buffer)
+            return;
+    }
+    struct trace_buffer *buf = t->buffer;
+    uint64_t pos = atomic_load_explicit(&buf->pos, memory_order_relaxed);
+    buf->events[pos & (EVENTS_PER_THREAD - 1)] = (struct trace_event){
+        .time = mp_time_us(),
+        .name = name,
+        .value = value,
+        .type = type,
+    };
+    // Publishes the event to mp_tracing_dump().
+    atomic_store(&buf->pos, pos + 1);
+}
+
+void mp_tracing_set_thread_name(const char *name)
+{
+    struct trace_thread *t = get_thread();
+    snprintf(t->name, sizeof(t->name), "%s", name);
+    if (t->buffer) {
+        pthread_mutex_lock(&buffers_lock);
+        snprintf(t->buffer->name, sizeof(t->buffer->name), "%s", name);
+        pthread_mutex_unlock(&buffers_lock);
+    }
+}
+
+void mp_tracing_start(void)
+{
+    pthread_mutex_lock(&buffers_lock);
+    if (num_users++ == 0) {
+        mp_time_init();
+        start_time = mp_time_us();
+        atomic_store(&mp_tracing_active, true);
+    }
+    pthread_mutex_unlock(&buffers_lock);
+}
+
+void mp_tracing_stop(void)
+{
+    pthread_mutex_lock(&buffers_lock);
+    assert(num_users > 0);
+    if (--num_users == 0)
+        atomic_store(&mp_tracing_active, false);
+    pthread_mutex_unlock(&buffers_lock);
+}
+
+static void write_name(FILE *f, const char *name)
+{
+    fputc('"', f);
+    for (const unsigned char *s = (const unsigned char *)name; *s; s++) {
+        if (*s < 32 || *s == '"' || *s == '\\') {
+            fprintf(f, "\\u%04x", *s);
+        } else {
+            fputc(*s, f);
+        }
+    }
+    fputc('"', f);
+}
+
+// Copy the valid events of buf to dst, and return the number of events.
+static int copy_events(struct trace_buffer *buf, struct trace_event *dst)
+{
+    uint64_t end = atomic_load(&buf->pos);
+    uint64_t start = end > EVENTS_PER_THREAD ? end - EVENTS_PER_THREAD : 0;
+    for (uint64_t n = start; n < end; n++)
+        dst[n - start] = buf->events[n & (EVENTS_PER_THREAD - 1)];
+    // The owner might have overwritten the oldest events while copying. (The
+    // copy itself races with the owner; such events are discarded here.) It
+    // might also be writing the slot of event new_end right now, which is the
+    // same slot as new_end - EVENTS_PER_THREAD.
+    uint64_t new_end = atomic_load(&buf->pos);
+    uint64_t skip = 0;
+    if (new_end >= EVENTS_PER_THREAD) {
+        uint64_t valid_start = new_end - EVENTS_PER_THREAD + 1;
+        if (valid_start > start)
+            skip = MPMIN(valid_start - start, end - start);
+    }
+    memmove(dst, dst + skip, (end - start - skip) * sizeof(dst[0]));
+    return end - start - skip;
+}
+
+static void write_event(FILE *f, int tid, int64_t t0, struct trace_event *ev)
+{
+    static const char ph[] = {
+        [MP_TRACE_BEGIN]    = 'B',
+        [MP_TRACE_END]      = 'E',
+        [MP_TRACE_COUNTER]  = 'C',
+        [MP_TRACE_INSTANT]  = 'i',
+    };
+    fprintf(f, ",\n{\"ph\":\"%c\",\"pid\":1,\"tid\":%d,\"ts\":%lld,\"name\":",
+            ph[ev->type], tid, (long long)(ev->time - t0));
+    write_name(f, ev->name);
+    if (ev->type == MP_TRACE_COUNTER)
+        fprintf(f, ",\"args\":{\"value\":%f}",
+                isfinite(ev->value) ? ev->value : 0);
+    if (ev->type == MP_TRACE_INSTANT)
+        fprintf(f, ",\"s\":\"t\"");
+    fputc('}', f);
+}
+
+bool mp_tracing_dump(struct mp_log *log, const char *filename)
+{
+    FILE *f = fopen(filename, "wb");
+    if (!f) {
+        mp_err(log, "Could not open trace file '%s'.\n", filename);
+        return false;
+    }
+
+    struct trace_event *events =
+        talloc_array(NULL, struct trace_event, EVENTS_PER_THREAD);
+    int num_events = 0;
+
+    fprintf(f, "{\"traceEvents\":[\n");
+    fprintf(f, "{\"ph\":\"M\",\"pid\":1,\"name\":\"process_name\","
+               "\"args\":{\"name\":\"mpv\"}}");
+
+    // Holding the lock while writing blocks new threads from recording their
+    // first event, but nothing else.
+    pthread_mutex_lock(&buffers_lock);
+    int64_t t0 = start_time;
+    for (int n = 0; n < num_buffers; n++) {
+        struct trace_buffer *buf = buffers[n];
+        fprintf(f, ",\n{\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+                   "\"name\":\"thread_name\",\"args\":{\"name\":", buf->tid);
+        write_name(f, buf->name[0] ? buf->name : "unnamed");
+        fprintf(f, "}}");
+
+        int num = copy_events(buf, events);
+        for (int i = 0; i < num; i++) {
+            if (events[i].time >= t0) {
+                write_event(f, buf->tid, t0, &events[i]);
+                num_events++;
+            }
+        }
+    }
+    pthread_mutex_unlock(&buffers_lock);
+
+    fprintf(f, "\n]}\n");
+    talloc_free(events);
+
+    bool ok = !ferror(f);
+    if (fclose(f) != 0)
+        ok = false;
+    if (ok) {
+        mp_info(log, "Wrote %d trace events to '%s'.\n", num_events, filename);
+    } else {
+        mp_err(log, "Error writing trace file '%s'.\n", filename);
+    }
+    return ok;
+}
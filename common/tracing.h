@@ -0,0 +1,73 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MP_TRACING_H
+#define MP_TRACING_H
+
+#include <stdbool.h>
+
+#include "osdep/atomic.h"
+
+struct mp_log;
+
+enum mp_trace_type {
+    MP_TRACE_BEGIN,
+    MP_TRACE_END,
+    MP_TRACE_COUNTER,
+    MP_TRACE_INSTANT,
+};
+
+extern atomic_bool mp_tracing_active;
+
+static inline bool mp_tracing_enabled(void)
+{
+    return atomic_load_explicit(&mp_tracing_active, memory_order_relaxed);
+}
+
+// Record an event into the calling thread's trace buffer. Only the name
+// pointer is stored, so it must point to a string with static storage
+// duration (like a string literal, or the name in a static filter info).
+void mp_tracing_event(int type, const char *name, double value);
+
+// Begin/end a duration slice on the calling thread. Slices can nest, but
+// must be properly closed on the same thread.
+#define mp_trace_begin(name) \
+    do { if (mp_tracing_enabled()) \
+        mp_tracing_event(MP_TRACE_BEGIN, name, 0); } while (0)
+#define mp_trace_end(name) \
+    do { if (mp_tracing_enabled()) \
+        mp_tracing_event(MP_TRACE_END, name, 0); } while (0)
+#define mp_trace_counter(name, value) \
+    do { if (mp_tracing_enabled()) \
+        mp_tracing_event(MP_TRACE_COUNTER, name, value); } while (0)
+#define mp_trace_instant(name) \
+    do { if (mp_tracing_enabled()) \
+        mp_tracing_event(MP_TRACE_INSTANT, name, 0); } while (0)
+
+// Tracing is enabled while there is at least one user. Events recorded before
+// the first start are not part of the dump.
+void mp_tracing_start(void);
+void mp_tracing_stop(void);
+
+// Write the contents of all trace buffers as Chrome trace JSON (as understood
+// by chrome://tracing and Perfetto). Can be called while tracing is active.
+bool mp_tracing_dump(struct mp_log *log, const char *filename);
+
+// Called by mpthread_set_name().
+void mp_tracing_set_thread_name(const char *name);
+
+#endif
@@ -34,7 +34,11 @@
 #include "mpv_talloc.h"
 #include "common/msg.h"
 #include "common/global.h"
+#include "common/mem_account.h"
+#include "common/perf_counters.h"
+#include "common/tracing.h"
 #include "osdep/threads.h"
+#include "osdep/timer.h"
 
 #include "stream/stream.h"
 #include "demux.h"
@@ -158,6 +162,7 @@ struct demux_internal {
     int max_bytes;
     int max_bytes_bw;
     bool seekable_cache;
+    bool low_memory;            // prune all backward packets
 
     // At least one decoder actually requested data since init or the last seek.
     // Do this to allow the decoder thread to select streams before starting.
@@ -460,7 +465,9 @@ static void remove_head_packet(struct demux_queue *queue)
     if (queue->keyframe_latest == dp)
         queue->keyframe_latest = NULL;
 
-    queue->ds->in->total_bytes -= demux_packet_estimate_total_size(dp);
+    size_t bytes = demux_packet_estimate_total_size(dp);
+    queue->ds->in->total_bytes -= bytes;
+    mp_mem_account(MP_MEM_DEMUXER_CACHE, -(int64_t)bytes);
 
     if (queue->num_index && queue->index[0] == dp)
         MP_TARRAY_REMOVE_AT(queue->index, queue->num_index, 0);
@@ -480,7 +487,9 @@ static void clear_queue(struct demux_queue *queue)
     struct demux_packet *dp = queue->head;
     while (dp) {
         struct demux_packet *dn = dp->next;
-        in->total_bytes -= demux_packet_estimate_total_size(dp);
+        size_t bytes = demux_packet_estimate_total_size(dp);
+        in->total_bytes -= bytes;
+        mp_mem_account(MP_MEM_DEMUXER_CACHE, -(int64_t)bytes);
         assert(ds->reader_head != dp);
         talloc_free(dp);
         dp = dn;
@@ -607,6 +616,18 @@ void demux_set_ts_offset(struct demuxer *demuxer, double offset)
     pthread_mutex_unlock(&in->lock);
 }
 
+// If set, keep only packets which still have to be read (i.e. drop the
+// backbuffer and inactive seek ranges), regardless of options.
+// Used if the player is over its memory limit. This takes effect as the
+// reader consumes packets.
+void demux_set_low_memory(struct demuxer *demuxer, bool low_memory)
+{
+    struct demux_internal *in = demuxer->in;
+    pthread_mutex_lock(&in->lock);
+    in->low_memory = low_memory;
+    pthread_mutex_unlock(&in->lock);
+}
+
 static void add_missing_streams(struct demux_internal *in,
                                 struct demux_cached_range *range)
 {
@@ -1093,6 +1114,12 @@ static void adjust_seek_range_on_packet(struct demux_stream *ds,
         attempt_range_joining(ds->in);
 }
 
+static const int packet_counters[STREAM_TYPE_COUNT][2] = {
+    [STREAM_VIDEO] = {MP_PERF_DEMUX_VIDEO_PACKETS, MP_PERF_DEMUX_VIDEO_DROPPED},
+    [STREAM_AUDIO] = {MP_PERF_DEMUX_AUDIO_PACKETS, MP_PERF_DEMUX_AUDIO_DROPPED},
+    [STREAM_SUB]   = {MP_PERF_DEMUX_SUB_PACKETS,   MP_PERF_DEMUX_SUB_DROPPED},
+};
+
 void demux_add_packet(struct sh_stream *stream, demux_packet_t *dp)
 {
     struct demux_stream *ds = stream ? stream->ds : NULL;
@@ -1121,6 +1148,8 @@ void demux_add_packet(struct sh_stream *stream, demux_packet_t *dp)
         drop = true;
     }
 
+    mp_perf_inc(packet_counters[stream->type][drop]);
+
     if (drop) {
         pthread_mutex_unlock(&in->lock);
         talloc_free(dp);
@@ -1146,6 +1175,7 @@ void demux_add_packet(struct sh_stream *stream, demux_packet_t *dp)
 
     size_t bytes = demux_packet_estimate_total_size(dp);
     ds->in->total_bytes += bytes;
+    mp_mem_account(MP_MEM_DEMUXER_CACHE, bytes);
     if (ds->reader_head) {
         ds->fw_packs++;
         ds->fw_bytes += bytes;
@@ -1259,10 +1289,12 @@ static bool read_packet(struct demux_internal *in)
 
     struct demuxer *demux = in->d_thread;
 
+    mp_trace_begin("demux-read");
     bool eof = true;
     if (demux->desc->fill_buffer && !demux_cancel_test(demux))
         eof = demux->desc->fill_buffer(demux) <= 0;
     update_cache(in);
+    mp_trace_end("demux-read");
 
     pthread_mutex_lock(&in->lock);
 
@@ -1295,6 +1327,8 @@ static void prune_old_packets(struct demux_internal *in)
     // prune the oldest packet runs, as long as the total cache amount is too
     // big.
     size_t max_bytes = in->seekable_cache ? in->max_bytes_bw : 0;
+    if (in->low_memory)
+        max_bytes = 0;
     while (in->total_bytes - in->fw_bytes > max_bytes) {
         // (Start from least recently used range.)
         struct demux_cached_range *range = in->ranges[0];
@@ -1395,8 +1429,10 @@ static void execute_seek(struct demux_internal *in)
 
     MP_VERBOSE(in, "execute seek (to %f flags %d)\n", pts, flags);
 
+    mp_trace_begin("demux-seek");
     if (in->d_thread->desc->seek)
         in->d_thread->desc->seek(in->d_thread, pts, flags);
+    mp_trace_end("demux-seek");
 
     MP_VERBOSE(in, "seek done\n");
 
@@ -2107,6 +2143,7 @@ struct demuxer *demux_open_url(const char *url,
         return NULL;
     if (!params->disable_cache)
         stream_enable_cache_defaults(&s);
+    params->stream_opened = mp_time_sec();
     struct demuxer *d = demux_open(s, params, global);
     if (d) {
         demux_maybe_replace_stream(d);
@@ -177,6 +177,7 @@ struct demuxer_params {
     bool disable_cache;
     // result
     bool demuxer_failed;
+    double stream_opened;   // mp_time_sec() after the stream was opened
 };
 
 typedef struct demuxer {
@@ -277,6 +278,7 @@ bool demux_cancel_test(struct demuxer *demuxer);
 void demux_flush(struct demuxer *demuxer);
 int demux_seek(struct demuxer *demuxer, double rel_seek_secs, int flags);
 void demux_set_ts_offset(struct demuxer *demuxer, double offset);
+void demux_set_low_memory(struct demuxer *demuxer, bool low_memory);
 
 int demux_control(struct demuxer *demuxer, int cmd, void *arg);
 
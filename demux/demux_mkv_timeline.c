@@ -19,7 +19,6 @@
 #include <stdbool.h>
 #include <inttypes.h>
 #include <assert.h>
-#include <dirent.h>
 #include <string.h>
 #include <strings.h>
 #include <sys/types.h>
@@ -31,6 +30,7 @@
 
 #include "mpv_talloc.h"
 
+#include "common/global.h"
 #include "common/msg.h"
 #include "demux/demux.h"
 #include "demux/timeline.h"
@@ -39,6 +39,7 @@
 #include "options/options.h"
 #include "options/path.h"
 #include "misc/bstr.h"
+#include "misc/dir_cache.h"
 #include "common/common.h"
 #include "common/playlist.h"
 #include "stream/stream.h"
@@ -97,30 +98,31 @@ static bool test_matroska_ext(const char *filename)
     return false;
 }
 
-static char **find_files(const char *original_file)
+static char **find_files(struct tl_ctx *ctx, const char *original_file)
 {
     void *tmpmem = talloc_new(NULL);
     char *basename = mp_basename(original_file);
     struct bstr directory = mp_dirname(original_file);
     char **results = talloc_size(NULL, 0);
     char *dir_zero = bstrdup0(tmpmem, directory);
-    DIR *dp = opendir(dir_zero);
-    if (!dp) {
+    struct mp_dir_listing *dir =
+        mp_dir_cache_get(ctx->global->dir_cache, ctx->log, dir_zero);
+    if (!dir) {
         talloc_free(tmpmem);
         return results;
     }
     struct find_entry *entries = NULL;
-    struct dirent *ep;
     int num_results = 0;
-    while ((ep = readdir(dp))) {
-        if (!test_matroska_ext(ep->d_name))
+    for (int n = 0; n < dir->num_entries; n++) {
+        char *d_name = dir->entries[n].name;
+        if (!test_matroska_ext(d_name))
             continue;
         // don't list the original name
-        if (!strcmp(ep->d_name, basename))
+        if (!strcmp(d_name, basename))
             continue;
 
-        char *name = mp_path_join_bstr(results, directory, bstr0(ep->d_name));
-        char *s1 = ep->d_name;
+        char *name = mp_path_join_bstr(results, directory, bstr0(d_name));
+        char *s1 = d_name;
         char *s2 = basename;
         int matchlen = 0;
         while (*s1 && *s1++ == *s2++)
@@ -138,7 +140,7 @@ static char **find_files(const char *original_file)
         entries[num_results] = (struct find_entry) { name, matchlen, size };
         num_results++;
     }
-    closedir(dp);
+    mp_dir_listing_unref(dir);
     // NOTE: maybe should make it compare pointers instead
     if (entries)
         qsort(entries, num_results, sizeof(struct find_entry), cmp_entry);
@@ -273,7 +275,7 @@ static void find_ordered_chapter_sources(struct tl_ctx *ctx)
         } else {
             MP_INFO(ctx, "Will scan other files in the "
                     "same directory to find referenced sources.\n");
-            filenames = find_files(main_filename);
+            filenames = find_files(ctx, main_filename);
             num_filenames = MP_TALLOC_AVAIL(filenames);
             talloc_steal(tmp, filenames);
         }
@@ -22,6 +22,7 @@
 
 #include "config.h"
 #include "common/common.h"
+#include "options/m_config.h"
 #include "options/options.h"
 #include "common/msg.h"
 #include "common/playlist.h"
@@ -56,6 +57,10 @@ struct pl_parser {
     enum demux_check check_level;
     struct stream *real_stream;
     char *format;
+    int dir_mode;
+    // DIR_LAZY: stat data of the directories on the path being opened.
+    struct stat *path_dirs;
+    int num_path_dirs;
 };
 
 static char *pl_get_line0(struct pl_parser *p)
@@ -230,11 +235,50 @@ static int parse_txt(struct pl_parser *p)
 
 #define MAX_DIR_STACK 20
 
+enum dir_mode {
+    DIR_RECURSIVE,
+    DIR_LAZY,
+    DIR_IGNORE,
+};
+
+struct demux_playlist_opts {
+    int dir_mode;
+};
+
+#define OPT_BASE_STRUCT struct demux_playlist_opts
+
+const struct m_sub_options demux_playlist_conf = {
+    .opts = (const struct m_option[]){
+        OPT_CHOICE("directory-mode", dir_mode, 0,
+                   ({"recursive", DIR_RECURSIVE},
+                    {"lazy", DIR_LAZY},
+                    {"ignore", DIR_IGNORE})),
+        {0}
+    },
+    .size = sizeof(struct demux_playlist_opts),
+    .defaults = &(const struct demux_playlist_opts){
+        .dir_mode = DIR_RECURSIVE,
+    },
+};
+
 static bool same_st(struct stat *st1, struct stat *st2)
 {
     return st1->st_dev == st2->st_dev && st1->st_ino == st2->st_ino;
 }
 
+// Return whether the directory entry ep (with full path file) is a directory.
+// If it is, *st is set to its stat data. This avoids the stat() call for
+// plain files if the OS reports the file type with readdir().
+static bool dirent_is_dir(struct dirent *ep, char *file, struct stat *st)
+{
+#ifdef DT_UNKNOWN
+    if (ep->d_type != DT_UNKNOWN && ep->d_type != DT_LNK &&
+        ep->d_type != DT_DIR)
+        return false;
+#endif
+    return stat(file, st) == 0 && S_ISDIR(st->st_mode);
+}
+
 // Return true if this was a readable directory.
 static bool scan_dir(struct pl_parser *p, char *path,
                      struct stat *dir_stack, int num_dir_stack,
@@ -260,7 +304,23 @@ static bool scan_dir(struct pl_parser *p, char *path,
         char *file = mp_path_join(p, path, ep->d_name);
 
         struct stat st;
-        if (stat(file, &st) == 0 && S_ISDIR(st.st_mode)) {
+        if (dirent_is_dir(ep, file, &st)) {
+            if (p->dir_mode == DIR_IGNORE)
+                goto skip;
+
+            // Leave expansion to when the entry is opened as playlist. That
+            // opens the full path, so a directory already on it is a loop.
+            if (p->dir_mode == DIR_LAZY) {
+                for (int n = 0; n < p->num_path_dirs; n++) {
+                    if (same_st(&p->path_dirs[n], &st)) {
+                        MP_VERBOSE(p, "Skip recursive entry: %s\n", file);
+                        goto skip;
+                    }
+                }
+                MP_TARRAY_APPEND(p, *files, *num_files, file);
+                goto skip;
+            }
+
             for (int n = 0; n < num_dir_stack; n++) {
                 if (same_st(&dir_stack[n], &st)) {
                     MP_VERBOSE(p, "Skip recursive entry: %s\n", file);
@@ -281,6 +341,31 @@ static bool scan_dir(struct pl_parser *p, char *path,
     return true;
 }
 
+// Set p->path_dirs to the directories path consists of (including path).
+// With lazy expansion, each expanded subdirectory is a separate open, so this
+// replaces the stack of directories entered by recursive scanning.
+static void stat_path_dirs(struct pl_parser *p, char *path)
+{
+    char *tmp = talloc_strdup(p, path);
+    for (char *s = tmp; ; s++) {
+        char c = *s;
+        bool sep = c == '/' || !c;
+#if HAVE_DOS_PATHS
+        sep |= c == '\\';
+#endif
+        if (sep && s > tmp) {
+            *s = '\0';
+            struct stat st;
+            if (stat(tmp, &st) == 0 && S_ISDIR(st.st_mode))
+                MP_TARRAY_APPEND(p, p->path_dirs, p->num_path_dirs, st);
+            *s = c;
+        }
+        if (!c)
+            break;
+    }
+    talloc_free(tmp);
+}
+
 static int cmp_filename(const void *a, const void *b)
 {
     return strcmp(*(char **)a, *(char **)b);
@@ -301,6 +386,9 @@ static int parse_dir(struct pl_parser *p)
     int num_files = 0;
     struct stat dir_stack[MAX_DIR_STACK];
 
+    if (p->dir_mode == DIR_LAZY)
+        stat_path_dirs(p, path);
+
     scan_dir(p, path, dir_stack, 0, &files, &num_files);
 
     if (files)
@@ -364,6 +452,10 @@ static int open_file(struct demuxer *demuxer, enum demux_check check)
     p->real_stream = demuxer->stream;
     p->add_base = true;
 
+    struct demux_playlist_opts *opts =
+        mp_get_config_group(p, demuxer->global, &demux_playlist_conf);
+    p->dir_mode = opts->dir_mode;
+
     bstr probe_buf = stream_peek(demuxer->stream, PROBE_SIZE);
     p->s = open_memory_stream(probe_buf.start, probe_buf.len);
     p->s->mime_type = demuxer->stream->mime_type;
@@ -86,6 +86,8 @@ enum mp_command_type {
 
     MP_CMD_DROP_BUFFERS,
 
+    MP_CMD_DUMP_TRACE,
+
     MP_CMD_MOUSE,
     MP_CMD_KEYPRESS,
     MP_CMD_KEYDOWN,
@@ -267,6 +267,10 @@ struct mp_client_api;
 struct mp_ipc_ctx *mp_init_ipc(struct mp_client_api *client_api,
                                struct mpv_global *global);
 void mp_uninit_ipc(struct mp_ipc_ctx *ctx);
+// Set dst to an array with information about each connected client (such as
+// the number of bytes waiting to be written). ctx can be NULL.
+struct mpv_node;
+void mp_ipc_get_client_stats(struct mp_ipc_ctx *ctx, struct mpv_node *dst);
 
 // Serialize the given mpv_event structure to JSON. Returns an allocated string.
 struct mpv_event;
@@ -277,4 +281,24 @@ char *mp_json_encode_event(struct mpv_event *event);
 struct mpv_handle;
 char *mp_ipc_consume_next_command(struct mpv_handle *client, void *ctx, bstr *buf);
 
+// Wire protocol of an IPC connection. Clients start with JSON, and can switch
+// with the "set_protocol" command.
+enum mp_ipc_protocol {
+    MP_IPC_PROTOCOL_JSON,       // newline-separated JSON
+    MP_IPC_PROTOCOL_MSGPACK,    // size-prefixed MessagePack frames
+};
+
+// Serialize the event using the given mp_ipc_protocol, and append it to *dst
+// (see bstr_xappend()).
+void mp_ipc_encode_event(void *ta_parent, struct mpv_event *event, int protocol,
+                         bstr *dst);
+
+// Execute all complete commands in the raw IPC input buffer "buf", remove them
+// from it, and append the replies to *out (see bstr_xappend()). *protocol is the
+// current mp_ipc_protocol of the connection, and is updated if a command
+// switches it. Returns <0 if the input can't be processed anymore, and the
+// connection should be closed.
+int mp_ipc_consume_commands(struct mpv_handle *client, int *protocol,
+                            bstr *buf, void *ta_parent, bstr *out);
+
 #endif /* MPLAYER_INPUT_H */
@@ -1,6 +1,7 @@
 #include <stddef.h>
 
 #include "input/input.h"
+#include "misc/node.h"
 
 struct mp_ipc_ctx *mp_init_ipc(struct mp_client_api *client_api,
                                struct mpv_global *global)
@@ -11,3 +12,8 @@ struct mp_ipc_ctx *mp_init_ipc(struct mp_client_api *client_api,
 void mp_uninit_ipc(struct mp_ipc_ctx *ctx)
 {
 }
+
+void mp_ipc_get_client_stats(struct mp_ipc_ctx *ctx, struct mpv_node *dst)
+{
+    node_init(dst, MPV_FORMAT_NODE_ARRAY, NULL);
+}
@@ -28,6 +28,7 @@
 
 #include "config.h"
 
+#include "osdep/atomic.h"
 #include "osdep/io.h"
 #include "osdep/threads.h"
 
@@ -36,6 +37,7 @@
 #include "common/msg.h"
 #include "input/input.h"
 #include "libmpv/client.h"
+#include "misc/node.h"
 #include "options/options.h"
 #include "options/path.h"
 #include "player/client.h"
@@ -44,188 +46,274 @@
 #define MSG_NOSIGNAL 0
 #endif
 
+// All clients (and the listening socket) are served by a single thread, which
+// multiplexes them with poll().
 struct mp_ipc_ctx {
     struct mp_log *log;
     struct mp_client_api *client_api;
     const char *path;
+    char *input_file;
+    int max_queue;              // --input-ipc-max-queue
+    int slow_client;            // --input-ipc-slow-client
 
     pthread_t thread;
-    int death_pipe[2];
+    int wakeup_pipe[2];         // used by mp_uninit_ipc() and client wakeups
+    atomic_bool terminate;
+
+    pthread_mutex_t lock;       // protects clients[]
+    struct client_arg **clients;
+    int num_clients;
+};
+
+enum {
+    SLOW_CLIENT_THROTTLE,
+    SLOW_CLIENT_DISCONNECT,
 };
 
 struct client_arg {
     struct mp_log *log;
     struct mpv_handle *client;
+    struct mp_ipc_ctx *ipc;
 
     char *client_name;
     int client_fd;
     bool close_client_fd;
+    bool nonblocking;           // client_fd was set to O_NONBLOCK by us
 
     bool writable;
+    bool dead;                  // remove on next loop iteration
+
+    atomic_bool wakeup;         // mpv_handle has (possibly) new events
+    bstr client_msg;            // unterminated input
+    int protocol;               // mp_ipc_protocol
+    bstr out;                   // replies/events before queuing them
+
+    // Data not yet written to the socket: write_buf[write_pos..write_len].
+    // The sizes are protected by ipc->lock (for mp_ipc_get_client_stats()).
+    char *write_buf;
+    size_t write_pos, write_len;
+    size_t peak_queue;
 };
 
-static int ipc_write_str(struct client_arg *client, const char *buf)
+static size_t client_queue_size(struct client_arg *client)
+{
+    return client->write_len - client->write_pos;
+}
+
+// Whether we should stop reading from the client and the mpv_handle until
+// the write queue has drained.
+static bool client_throttled(struct client_arg *client)
+{
+    return client_queue_size(client) >= (size_t)client->ipc->max_queue;
+}
+
+// Write as much of the queued data as possible without blocking.
+static int ipc_flush(struct client_arg *client)
 {
-    size_t count = strlen(buf);
-    while (count > 0) {
-        ssize_t rc = send(client->client_fd, buf, count, MSG_NOSIGNAL);
+    while (client_queue_size(client) > 0) {
+        // MSG_DONTWAIT: the FD is not necessarily set to O_NONBLOCK.
+        ssize_t rc = send(client->client_fd,
+                          client->write_buf + client->write_pos,
+                          client_queue_size(client),
+                          MSG_NOSIGNAL | MSG_DONTWAIT);
         if (rc <= 0) {
             if (rc == 0)
                 return -1;
 
-            if (errno == EBADF) {
+            if (errno == EBADF || errno == ENOTSOCK) {
                 client->writable = false;
-                return 0;
+                break;
             }
 
-            if (errno == EINTR || errno == EAGAIN)
+            if (errno == EINTR)
                 continue;
 
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return 0;
+
             return rc;
         }
 
-        count -= rc;
-        buf   += rc;
+        pthread_mutex_lock(&client->ipc->lock);
+        client->write_pos += rc;
+        pthread_mutex_unlock(&client->ipc->lock);
     }
 
+    pthread_mutex_lock(&client->ipc->lock);
+    client->write_pos = client->write_len = 0;
+    pthread_mutex_unlock(&client->ipc->lock);
     return 0;
 }
 
-static void *client_thread(void *p)
+// Queue the data for writing, and write as much as possible right away.
+static int ipc_write(struct client_arg *client, bstr data)
 {
-    pthread_detach(pthread_self());
-
-    // We don't use MSG_NOSIGNAL because the moldy fruit OS doesn't support it.
-    struct sigaction sa = { .sa_handler = SIG_IGN, .sa_flags = SA_RESTART };
-    sigfillset(&sa.sa_mask);
-    sigaction(SIGPIPE, &sa, NULL);
-
-    int rc;
-
-    struct client_arg *arg = p;
-    bstr client_msg = { talloc_strdup(NULL, ""), 0 };
-
-    mpthread_set_name(arg->client_name);
-
-    int pipe_fd = mpv_get_wakeup_pipe(arg->client);
-    if (pipe_fd < 0) {
-        MP_ERR(arg, "Could not get wakeup pipe\n");
-        goto done;
+    if (!client->writable || !data.len)
+        return 0;
+
+    size_t count = data.len;
+
+    pthread_mutex_lock(&client->ipc->lock);
+    if (client->write_pos > 0 && client->write_pos >= client->write_len / 2) {
+        // Compact the buffer instead of letting it grow indefinitely.
+        memmove(client->write_buf, client->write_buf + client->write_pos,
+                client_queue_size(client));
+        client->write_len -= client->write_pos;
+        client->write_pos = 0;
+    }
+    MP_TARRAY_GROW(client, client->write_buf, client->write_len + count);
+    memcpy(client->write_buf + client->write_len, data.start, count);
+    client->write_len += count;
+    client->peak_queue = MPMAX(client->peak_queue, client_queue_size(client));
+    pthread_mutex_unlock(&client->ipc->lock);
+
+    int rc = ipc_flush(client);
+    if (rc < 0)
+        return rc;
+
+    if (client_queue_size(client) > (size_t)client->ipc->max_queue &&
+        client->ipc->slow_client == SLOW_CLIENT_DISCONNECT)
+    {
+        MP_WARN(client, "Client doesn't read its data fast enough (%zu bytes "
+                "queued), disconnecting.\n", client_queue_size(client));
+        return -1;
     }
 
-    MP_VERBOSE(arg, "Client connected\n");
-
-    struct pollfd fds[2] = {
-        {.events = POLLIN, .fd = pipe_fd},
-        {.events = POLLIN, .fd = arg->client_fd},
-    };
-
-    fcntl(arg->client_fd, F_SETFL, fcntl(arg->client_fd, F_GETFL, 0) | O_NONBLOCK);
-
-    while (1) {
-        rc = poll(fds, 2, 0);
-        if (rc == 0)
-            rc = poll(fds, 2, -1);
-        if (rc < 0) {
-            MP_ERR(arg, "Poll error\n");
-            continue;
-        }
-
-        if (fds[0].revents & POLLIN) {
-            mp_flush_wakeup_pipe(pipe_fd);
-
-            while (1) {
-                mpv_event *event = mpv_wait_event(arg->client, 0);
-
-                if (event->event_id == MPV_EVENT_NONE)
-                    break;
-
-                if (event->event_id == MPV_EVENT_SHUTDOWN)
-                    goto done;
+    return 0;
+}
 
-                if (!arg->writable)
-                    continue;
+static void client_wakeup(void *p)
+{
+    struct client_arg *client = p;
+    atomic_store(&client->wakeup, true);
+    (void)write(client->ipc->wakeup_pipe[1], &(char){0}, 1);
+}
 
-                char *event_msg = mp_json_encode_event(event);
-                if (!event_msg) {
-                    MP_ERR(arg, "Encoding error\n");
-                    goto done;
-                }
+// Send all pending events to the client. Stops early if the client is
+// throttled; client->wakeup is left set in this case, so this is retried as
+// soon as the write queue drains. The mpv_handle queues events meanwhile, and
+// if it overflows, the client gets an "event-queue-overflow" event.
+static int client_send_events(struct client_arg *client)
+{
+    while (!client_throttled(client)) {
+        atomic_store(&client->wakeup, false);
+
+        mpv_event events[64];
+        int num = mpv_wait_events(client->client, 0, events,
+                                  MP_ARRAY_SIZE(events));
+        if (num <= 0)
+            break;
+
+        // Encode the whole batch, so it's sent with a single write.
+        client->out.len = 0;
+        for (int n = 0; n < num; n++) {
+            mpv_event *event = &events[n];
+
+            if (event->event_id == MPV_EVENT_SHUTDOWN) {
+                // Don't lose the events encoded before this one.
+                ipc_write(client, client->out);
+                return -1;
+            }
 
-                rc = ipc_write_str(arg, event_msg);
-                talloc_free(event_msg);
-                if (rc < 0) {
-                    MP_ERR(arg, "Write error (%s)\n", mp_strerror(errno));
-                    goto done;
-                }
+            if (client->writable) {
+                mp_ipc_encode_event(client, event, client->protocol,
+                                    &client->out);
             }
         }
 
-        if (fds[1].revents & (POLLIN | POLLHUP)) {
-            while (1) {
-                char buf[128];
-                bstr append = { buf, 0 };
+        if (ipc_write(client, client->out) < 0) {
+            MP_ERR(client, "Write error (%s)\n", mp_strerror(errno));
+            return -1;
+        }
 
-                ssize_t bytes = read(arg->client_fd, buf, sizeof(buf));
-                if (bytes < 0) {
-                    if (errno == EAGAIN)
-                        break;
+        // mpv_wait_events() may have left some events if the array was full.
+        atomic_store(&client->wakeup, true);
+    }
+    return 0;
+}
 
-                    MP_ERR(arg, "Read error (%s)\n", mp_strerror(errno));
-                    goto done;
-                }
+static int client_read(struct client_arg *client)
+{
+    // Limit the amount read at once, so other clients get their turn. Only
+    // the first read is guaranteed not to block if the FD is blocking.
+    int max_reads = client->nonblocking ? 16 : 1;
+    for (int i = 0; i < max_reads && !client_throttled(client); i++) {
+        char buf[4096];
+        bstr append = { buf, 0 };
+
+        ssize_t bytes = read(client->client_fd, buf, sizeof(buf));
+        if (bytes < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+
+            if (errno == EINTR)
+                continue;
 
-                if (bytes == 0) {
-                    MP_VERBOSE(arg, "Client disconnected\n");
-                    goto done;
-                }
+            MP_ERR(client, "Read error (%s)\n", mp_strerror(errno));
+            return -1;
+        }
 
-                append.len = bytes;
+        if (bytes == 0) {
+            MP_VERBOSE(client, "Client disconnected\n");
+            return -1;
+        }
 
-                bstr_xappend(NULL, &client_msg, append);
+        append.len = bytes;
 
-                while (bstrchr(client_msg, '\n') != -1) {
-                    char *reply_msg = mp_ipc_consume_next_command(arg->client,
-                        NULL, &client_msg);
+        bstr_xappend(client, &client->client_msg, append);
 
-                    if (reply_msg && arg->writable) {
-                        rc = ipc_write_str(arg, reply_msg);
-                        if (rc < 0) {
-                            MP_ERR(arg, "Write error (%s)\n", mp_strerror(errno));
-                            talloc_free(reply_msg);
-                            goto done;
-                        }
-                    }
+        // All replies to the commands received so far are sent at once.
+        client->out.len = 0;
+        int rc = mp_ipc_consume_commands(client->client, &client->protocol,
+                                         &client->client_msg, client,
+                                         &client->out);
 
-                    talloc_free(reply_msg);
-                }
-            }
+        if (ipc_write(client, client->out) < 0) {
+            MP_ERR(client, "Write error (%s)\n", mp_strerror(errno));
+            return -1;
         }
+
+        if (rc < 0)
+            return -1;
     }
+    return 0;
+}
 
-done:
-    if (client_msg.len > 0)
-        MP_WARN(arg, "Ignoring unterminated command on disconnect.\n");
-    talloc_free(client_msg.start);
-    if (arg->close_client_fd)
-        close(arg->client_fd);
-    mpv_detach_destroy(arg->client);
-    talloc_free(arg);
-    return NULL;
+static void client_destroy(struct client_arg *client)
+{
+    if (client->client_msg.len > 0)
+        MP_WARN(client, "Ignoring unterminated command on disconnect.\n");
+    // Make sure client_wakeup() is not running or called anymore.
+    mpv_set_wakeup_callback(client->client, NULL, NULL);
+    if (client->close_client_fd)
+        close(client->client_fd);
+    mpv_detach_destroy(client->client);
+    talloc_free(client);
 }
 
 static void ipc_start_client(struct mp_ipc_ctx *ctx, struct client_arg *client)
 {
+    client->ipc    = ctx;
     client->client = mp_new_client(ctx->client_api, client->client_name),
     client->log    = mp_client_get_log(client->client);
-
-    pthread_t client_thr;
-    if (pthread_create(&client_thr, NULL, client_thread, client)) {
-        mpv_detach_destroy(client->client);
-        if (client->close_client_fd)
-            close(client->client_fd);
-        talloc_free(client);
+    client->client_msg = (bstr){ talloc_strdup(client, ""), 0 };
+
+    // FDs we don't own (stdin, fd://) share their file status flags with
+    // other users of the same open file, so leave them alone.
+    if (client->close_client_fd) {
+        fcntl(client->client_fd, F_SETFL,
+              fcntl(client->client_fd, F_GETFL, 0) | O_NONBLOCK);
+        client->nonblocking = true;
     }
+
+    MP_VERBOSE(client, "Client connected\n");
+
+    pthread_mutex_lock(&ctx->lock);
+    MP_TARRAY_APPEND(ctx, ctx->clients, ctx->num_clients, client);
+    pthread_mutex_unlock(&ctx->lock);
+
+    // Triggers the initial client_wakeup() call.
+    mpv_set_wakeup_callback(client->client, client_wakeup, client);
 }
 
 static void ipc_start_client_json(struct mp_ipc_ctx *ctx, int id, int fd)
@@ -284,23 +372,17 @@ static void ipc_start_client_text(struct mp_ipc_ctx *ctx, const char *path)
     ipc_start_client(ctx, client);
 }
 
-static void *ipc_thread(void *p)
+static int ipc_listen(struct mp_ipc_ctx *arg)
 {
     int rc;
 
     int ipc_fd;
     struct sockaddr_un ipc_un = {0};
 
-    struct mp_ipc_ctx *arg = p;
-
-    mpthread_set_name("ipc socket listener");
-
-    MP_VERBOSE(arg, "Starting IPC master\n");
-
     ipc_fd = socket(AF_UNIX, SOCK_STREAM, 0);
     if (ipc_fd < 0) {
         MP_ERR(arg, "Could not create IPC socket\n");
-        goto done;
+        goto error;
     }
 
 #if HAVE_FCHMOD
@@ -310,7 +392,7 @@ static void *ipc_thread(void *p)
     size_t path_len = strlen(arg->path);
     if (path_len >= sizeof(ipc_un.sun_path) - 1) {
         MP_ERR(arg, "Could not create IPC socket\n");
-        goto done;
+        goto error;
     }
 
     ipc_un.sun_family = AF_UNIX,
@@ -327,46 +409,125 @@ static void *ipc_thread(void *p)
     rc = bind(ipc_fd, (struct sockaddr *) &ipc_un, addr_len);
     if (rc < 0) {
         MP_ERR(arg, "Could not bind IPC socket\n");
-        goto done;
+        goto error;
     }
 
     rc = listen(ipc_fd, 10);
     if (rc < 0) {
         MP_ERR(arg, "Could not listen on IPC socket\n");
-        goto done;
+        goto error;
     }
 
     MP_VERBOSE(arg, "Listening to IPC socket.\n");
 
-    int client_num = 0;
+    return ipc_fd;
 
-    struct pollfd fds[2] = {
-        {.events = POLLIN, .fd = arg->death_pipe[0]},
-        {.events = POLLIN, .fd = ipc_fd},
-    };
+error:
+    if (ipc_fd >= 0)
+        close(ipc_fd);
+    return -1;
+}
+
+static void ipc_remove_client(struct mp_ipc_ctx *arg, int index)
+{
+    struct client_arg *client = arg->clients[index];
+    pthread_mutex_lock(&arg->lock);
+    MP_TARRAY_REMOVE_AT(arg->clients, arg->num_clients, index);
+    pthread_mutex_unlock(&arg->lock);
+    client_destroy(client);
+}
+
+static void *ipc_thread(void *p)
+{
+    struct mp_ipc_ctx *arg = p;
+
+    mpthread_set_name("ipc");
+
+    // We don't use MSG_NOSIGNAL because the moldy fruit OS doesn't support it.
+    struct sigaction sa = { .sa_handler = SIG_IGN, .sa_flags = SA_RESTART };
+    sigfillset(&sa.sa_mask);
+    sigaction(SIGPIPE, &sa, NULL);
+
+    MP_VERBOSE(arg, "Starting IPC master\n");
+
+    int ipc_fd = -1;
+    if (arg->path && arg->path[0])
+        ipc_fd = ipc_listen(arg);
+
+    int client_num = 0;
+    struct pollfd *fds = NULL;
+
+    while (!atomic_load(&arg->terminate)) {
+        // Entry 0 is the wakeup pipe, entry 1 the listening socket (ignored
+        // by poll() if negative), followed by one entry per client.
+        MP_TARRAY_GROW(arg, fds, arg->num_clients + 2);
+        fds[0] = (struct pollfd){.events = POLLIN, .fd = arg->wakeup_pipe[0]};
+        fds[1] = (struct pollfd){.events = POLLIN, .fd = ipc_fd};
+        for (int n = 0; n < arg->num_clients; n++) {
+            struct client_arg *client = arg->clients[n];
+            fds[n + 2] = (struct pollfd){.fd = client->client_fd};
+            // Backpressure: don't accept new commands while throttled.
+            if (!client_throttled(client))
+                fds[n + 2].events |= POLLIN;
+            if (client_queue_size(client) > 0)
+                fds[n + 2].events |= POLLOUT;
+        }
+        int num_clients = arg->num_clients;
 
-    while (1) {
-        rc = poll(fds, 2, -1);
+        int rc = poll(fds, num_clients + 2, -1);
         if (rc < 0) {
-            MP_ERR(arg, "Poll error\n");
+            if (errno != EINTR)
+                MP_ERR(arg, "Poll error\n");
             continue;
         }
 
         if (fds[0].revents & POLLIN)
-            goto done;
+            mp_flush_wakeup_pipe(arg->wakeup_pipe[0]);
+
+        for (int n = num_clients - 1; n >= 0; n--) {
+            struct client_arg *client = arg->clients[n];
+            int revents = fds[n + 2].revents;
+
+            if (revents & POLLOUT) {
+                if (ipc_flush(client) < 0) {
+                    MP_ERR(client, "Write error (%s)\n", mp_strerror(errno));
+                    client->dead = true;
+                }
+            }
+
+            if (!client->dead && atomic_load(&client->wakeup)) {
+                if (client_send_events(client) < 0)
+                    client->dead = true;
+            }
+
+            if (!client->dead && (revents & (POLLIN | POLLHUP | POLLERR))) {
+                // A throttled client that hung up will never drain its queue.
+                if (client_throttled(client) && !(revents & POLLIN)) {
+                    client->dead = true;
+                } else if (client_read(client) < 0) {
+                    client->dead = true;
+                }
+            }
+
+            if (client->dead || (revents & POLLNVAL))
+                ipc_remove_client(arg, n);
+        }
 
         if (fds[1].revents & POLLIN) {
             int client_fd = accept(ipc_fd, NULL, NULL);
             if (client_fd < 0) {
                 MP_ERR(arg, "Could not accept IPC client\n");
-                goto done;
+            } else {
+                ipc_start_client_json(arg, client_num++, client_fd);
             }
-
-            ipc_start_client_json(arg, client_num++, client_fd);
         }
     }
 
-done:
+    while (arg->num_clients)
+        ipc_remove_client(arg, arg->num_clients - 1);
+
+    talloc_free(fds);
+
     if (ipc_fd >= 0)
         close(ipc_fd);
 
@@ -383,29 +544,37 @@ struct mp_ipc_ctx *mp_init_ipc(struct mp_client_api *client_api,
         .log        = mp_log_new(arg, global->log, "ipc"),
         .client_api = client_api,
         .path       = mp_get_user_path(arg, global, opts->ipc_path),
-        .death_pipe = {-1, -1},
+        .max_queue  = opts->ipc_max_queue,
+        .slow_client = opts->ipc_slow_client,
+        .wakeup_pipe = {-1, -1},
     };
     char *input_file = mp_get_user_path(arg, global, opts->input_file);
 
-    if (input_file && *input_file)
-        ipc_start_client_text(arg, input_file);
-
-    if (!opts->ipc_path || !*opts->ipc_path)
+    bool have_input_file = input_file && *input_file;
+    if (!have_input_file && (!arg->path || !*arg->path))
         goto out;
 
-    if (mp_make_wakeup_pipe(arg->death_pipe) < 0)
-        goto out;
+    pthread_mutex_init(&arg->lock, NULL);
+
+    if (mp_make_wakeup_pipe(arg->wakeup_pipe) < 0)
+        goto out_lock;
+
+    if (have_input_file)
+        ipc_start_client_text(arg, input_file);
 
     if (pthread_create(&arg->thread, NULL, ipc_thread, arg))
-        goto out;
+        goto out_clients;
 
     return arg;
 
+out_clients:
+    while (arg->num_clients)
+        ipc_remove_client(arg, arg->num_clients - 1);
+    close(arg->wakeup_pipe[0]);
+    close(arg->wakeup_pipe[1]);
+out_lock:
+    pthread_mutex_destroy(&arg->lock);
 out:
-    if (arg->death_pipe[0] >= 0) {
-        close(arg->death_pipe[0]);
-        close(arg->death_pipe[1]);
-    }
     talloc_free(arg);
     return NULL;
 }
@@ -415,10 +584,30 @@ void mp_uninit_ipc(struct mp_ipc_ctx *arg)
     if (!arg)
         return;
 
-    (void)write(arg->death_pipe[1], &(char){0}, 1);
+    atomic_store(&arg->terminate, true);
+    (void)write(arg->wakeup_pipe[1], &(char){0}, 1);
     pthread_join(arg->thread, NULL);
 
-    close(arg->death_pipe[0]);
-    close(arg->death_pipe[1]);
+    close(arg->wakeup_pipe[0]);
+    close(arg->wakeup_pipe[1]);
+    pthread_mutex_destroy(&arg->lock);
     talloc_free(arg);
 }
+
+void mp_ipc_get_client_stats(struct mp_ipc_ctx *arg, struct mpv_node *dst)
+{
+    node_init(dst, MPV_FORMAT_NODE_ARRAY, NULL);
+    if (!arg)
+        return;
+
+    pthread_mutex_lock(&arg->lock);
+    for (int n = 0; n < arg->num_clients; n++) {
+        struct client_arg *client = arg->clients[n];
+        struct mpv_node *entry = node_array_add(dst, MPV_FORMAT_NODE_MAP);
+        node_map_add_string(entry, "name", client->client_name);
+        node_map_add_int64(entry, "write-queue", client_queue_size(client));
+        node_map_add_int64(entry, "peak-write-queue", client->peak_queue);
+        node_map_add_flag(entry, "throttled", client_throttled(client));
+    }
+    pthread_mutex_unlock(&arg->lock);
+}
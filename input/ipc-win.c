@@ -29,6 +29,7 @@
 #include "common/msg.h"
 #include "input/input.h"
 #include "libmpv/client.h"
+#include "misc/node.h"
 #include "options/options.h"
 #include "player/client.h"
 
@@ -498,3 +499,9 @@ void mp_uninit_ipc(struct mp_ipc_ctx *arg)
     CloseHandle(arg->death_event);
     talloc_free(arg);
 }
+
+void mp_ipc_get_client_stats(struct mp_ipc_ctx *arg, struct mpv_node *dst)
+{
+    // Not tracked; each client is served by its own thread with blocking I/O.
+    node_init(dst, MPV_FORMAT_NODE_ARRAY, NULL);
+}
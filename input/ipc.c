@@ -20,6 +20,7 @@
 #include "common/msg.h"
 #include "input/input.h"
 #include "misc/json.h"
+#include "misc/msgpack.h"
 #include "options/m_option.h"
 #include "options/options.h"
 #include "options/path.h"
@@ -193,33 +194,71 @@ char *mp_json_encode_event(mpv_event *event)
     return output;
 }
 
-// Function is allowed to modify src[n].
-static char *json_execute_command(struct mpv_handle *client, void *ta_parent,
-                                  char *src)
+static const char *const protocol_names[] = {
+    [MP_IPC_PROTOCOL_JSON]      = "json",
+    [MP_IPC_PROTOCOL_MSGPACK]   = "msgpack",
+};
+
+// Binary frames larger than this are treated as protocol error. The client is
+// disconnected, because there's no reliable way to skip the frame.
+#define MAX_FRAME_SIZE (64 * 1024 * 1024)
+
+// Append node as binary frame to *dst: the size of the payload as 32 bit big
+// endian integer, followed by the MessagePack encoded node. On errors, nothing
+// is appended, and -1 is returned.
+static int write_frame(void *ta_parent, bstr *dst, mpv_node *node)
 {
-    int rc;
-    const char *cmd = NULL;
-    struct mp_log *log = mp_client_get_log(client);
+    size_t start = dst->len;
+    bstr_xappend(ta_parent, dst, (bstr){(unsigned char[4]){0}, 4});
+    if (msgpack_write(ta_parent, dst, node) < 0) {
+        dst->len = start;
+        return -1;
+    }
+    size_t size = dst->len - start - 4;
+    for (int n = 0; n < 4; n++)
+        dst->start[start + n] = size >> (8 * (3 - n));
+    return 0;
+}
 
-    mpv_node msg_node;
-    mpv_node reply_node = {.format = MPV_FORMAT_NODE_MAP, .u.list = NULL};
-    mpv_node *reqid_node = NULL;
+void mp_ipc_encode_event(void *ta_parent, mpv_event *event, int protocol,
+                         bstr *dst)
+{
+    void *tmp = talloc_new(NULL);
+    mpv_node event_node = {.format = MPV_FORMAT_NODE_MAP, .u.list = NULL};
 
-    rc = json_parse(ta_parent, &msg_node, &src, 50);
-    if (rc < 0) {
-        mp_err(log, "malformed JSON received: '%s'\n", src);
-        rc = MPV_ERROR_INVALID_PARAMETER;
-        goto error;
+    mpv_event_to_node(tmp, event, &event_node);
+
+    if (protocol == MP_IPC_PROTOCOL_MSGPACK) {
+        write_frame(ta_parent, dst, &event_node);
+    } else {
+        char *output = talloc_strdup(tmp, "");
+        json_write(&output, &event_node);
+        bstr_xappend(ta_parent, dst, bstr0(output));
+        bstr_xappend(ta_parent, dst, bstr0("\n"));
     }
 
-    if (msg_node.format != MPV_FORMAT_NODE_MAP) {
+    talloc_free(tmp);
+}
+
+// Execute the command in msg_node, and add the reply fields to reply_node.
+// If protocol is not NULL, the client is allowed to switch the protocol with
+// the "set_protocol" command, and *protocol is set to the new protocol.
+static void execute_command(struct mpv_handle *client, void *ta_parent,
+                            mpv_node *msg_node, mpv_node *reply_node,
+                            int *protocol)
+{
+    int rc;
+    const char *cmd = NULL;
+    mpv_node *reqid_node = NULL;
+
+    if (msg_node->format != MPV_FORMAT_NODE_MAP) {
         rc = MPV_ERROR_INVALID_PARAMETER;
         goto error;
     }
 
-    reqid_node = mpv_node_map_get(&msg_node, "request_id");
+    reqid_node = mpv_node_map_get(msg_node, "request_id");
 
-    mpv_node *cmd_node = mpv_node_map_get(&msg_node, "command");
+    mpv_node *cmd_node = mpv_node_map_get(msg_node, "command");
     if (!cmd_node ||
         (cmd_node->format != MPV_FORMAT_NODE_ARRAY) ||
         !cmd_node->u.list->num)
@@ -238,15 +277,15 @@ static char *json_execute_command(struct mpv_handle *client, void *ta_parent,
 
     if (!strcmp("client_name", cmd)) {
         const char *client_name = mpv_client_name(client);
-        mpv_node_map_add_string(ta_parent, &reply_node, "data", client_name);
+        mpv_node_map_add_string(ta_parent, reply_node, "data", client_name);
         rc = MPV_ERROR_SUCCESS;
     } else if (!strcmp("get_time_us", cmd)) {
         int64_t time_us = mpv_get_time_us(client);
-        mpv_node_map_add_int64(ta_parent, &reply_node, "data", time_us);
+        mpv_node_map_add_int64(ta_parent, reply_node, "data", time_us);
         rc = MPV_ERROR_SUCCESS;
     } else if (!strcmp("get_version", cmd)) {
         int64_t ver = mpv_client_api_version();
-        mpv_node_map_add_int64(ta_parent, &reply_node, "data", ver);
+        mpv_node_map_add_int64(ta_parent, reply_node, "data", ver);
         rc = MPV_ERROR_SUCCESS;
     } else if (!strcmp("get_property", cmd)) {
         mpv_node result_node;
@@ -264,7 +303,7 @@ static char *json_execute_command(struct mpv_handle *client, void *ta_parent,
         rc = mpv_get_property(client, cmd_node->u.list->values[1].u.string,
                               MPV_FORMAT_NODE, &result_node);
         if (rc >= 0) {
-            mpv_node_map_add(ta_parent, &reply_node, "data", &result_node);
+            mpv_node_map_add(ta_parent, reply_node, "data", &result_node);
             mpv_free_node_contents(&result_node);
         }
     } else if (!strcmp("get_property_string", cmd)) {
@@ -281,11 +320,42 @@ static char *json_execute_command(struct mpv_handle *client, void *ta_parent,
         char *result = mpv_get_property_string(client,
                                         cmd_node->u.list->values[1].u.string);
         if (!result) {
-            mpv_node_map_add_null(ta_parent, &reply_node, "data");
+            mpv_node_map_add_null(ta_parent, reply_node, "data");
         } else {
-            mpv_node_map_add_string(ta_parent, &reply_node, "data", result);
+            mpv_node_map_add_string(ta_parent, reply_node, "data", result);
             mpv_free(result);
         }
+    } else if (!strcmp("get_properties", cmd)) {
+        struct mpv_node_list *args = cmd_node->u.list;
+        int num = args->num - 1;
+        const char **names = talloc_array(ta_parent, const char *, num);
+        for (int n = 0; n < num; n++) {
+            if (args->values[n + 1].format != MPV_FORMAT_STRING) {
+                rc = MPV_ERROR_INVALID_PARAMETER;
+                goto error;
+            }
+            names[n] = args->values[n + 1].u.string;
+        }
+
+        mpv_node *values = talloc_zero_array(ta_parent, mpv_node, num);
+        int *errors = talloc_zero_array(ta_parent, int, num);
+        mpv_get_properties(client, num, names, MPV_FORMAT_NODE, values, errors);
+
+        mpv_node data_node = {.format = MPV_FORMAT_NODE_MAP, .u.list = NULL};
+        mpv_node errors_node = {.format = MPV_FORMAT_NODE_MAP, .u.list = NULL};
+        for (int n = 0; n < num; n++) {
+            if (errors[n] >= 0) {
+                mpv_node_map_add(ta_parent, &data_node, names[n], &values[n]);
+                mpv_free_node_contents(&values[n]);
+            } else {
+                mpv_node_map_add_null(ta_parent, &data_node, names[n]);
+            }
+            mpv_node_map_add_string(ta_parent, &errors_node, names[n],
+                                    mpv_error_string(errors[n]));
+        }
+        mpv_node_map_add(ta_parent, reply_node, "data", &data_node);
+        mpv_node_map_add(ta_parent, reply_node, "errors", &errors_node);
+        rc = MPV_ERROR_SUCCESS;
     } else if (!strcmp("set_property", cmd)) {
         if (cmd_node->u.list->num != 3) {
             rc = MPV_ERROR_INVALID_PARAMETER;
@@ -318,46 +388,70 @@ static char *json_execute_command(struct mpv_handle *client, void *ta_parent,
         rc = mpv_set_property_string(client,
                                      cmd_node->u.list->values[1].u.string,
                                      cmd_node->u.list->values[2].u.string);
-    } else if (!strcmp("observe_property", cmd)) {
-        if (cmd_node->u.list->num != 3) {
+    } else if (!strcmp("set_properties", cmd)) {
+        if (cmd_node->u.list->num != 2) {
             rc = MPV_ERROR_INVALID_PARAMETER;
             goto error;
         }
 
-        if (cmd_node->u.list->values[1].format != MPV_FORMAT_INT64) {
+        mpv_node *props = &cmd_node->u.list->values[1];
+        if (props->format != MPV_FORMAT_NODE_MAP) {
             rc = MPV_ERROR_INVALID_PARAMETER;
             goto error;
         }
 
-        if (cmd_node->u.list->values[2].format != MPV_FORMAT_STRING) {
-            rc = MPV_ERROR_INVALID_PARAMETER;
-            goto error;
+        int num = props->u.list->num;
+        int *errors = talloc_zero_array(ta_parent, int, num);
+        mpv_set_properties(client, num, (const char **)props->u.list->keys,
+                           MPV_FORMAT_NODE, props->u.list->values, errors);
+
+        mpv_node errors_node = {.format = MPV_FORMAT_NODE_MAP, .u.list = NULL};
+        for (int n = 0; n < num; n++) {
+            mpv_node_map_add_string(ta_parent, &errors_node,
+                                    props->u.list->keys[n],
+                                    mpv_error_string(errors[n]));
         }
+        mpv_node_map_add(ta_parent, reply_node, "errors", &errors_node);
+        rc = MPV_ERROR_SUCCESS;
+    } else if (!strcmp("observe_property", cmd) ||
+               !strcmp("observe_property_string", cmd))
+    {
+        mpv_format format = !strcmp("observe_property", cmd) ?
+                            MPV_FORMAT_NODE : MPV_FORMAT_STRING;
+        struct mpv_node_list *args = cmd_node->u.list;
 
-        rc = mpv_observe_property(client,
-                                  cmd_node->u.list->values[1].u.int64,
-                                  cmd_node->u.list->values[2].u.string,
-                                  MPV_FORMAT_NODE);
-    } else if (!strcmp("observe_property_string", cmd)) {
-        if (cmd_node->u.list->num != 3) {
+        // Optional: minimum interval and minimum delta.
+        double limits[2] = {0};
+        if (args->num < 3 || args->num > 5) {
             rc = MPV_ERROR_INVALID_PARAMETER;
             goto error;
         }
 
-        if (cmd_node->u.list->values[1].format != MPV_FORMAT_INT64) {
+        if (args->values[1].format != MPV_FORMAT_INT64) {
             rc = MPV_ERROR_INVALID_PARAMETER;
             goto error;
         }
 
-        if (cmd_node->u.list->values[2].format != MPV_FORMAT_STRING) {
+        if (args->values[2].format != MPV_FORMAT_STRING) {
             rc = MPV_ERROR_INVALID_PARAMETER;
             goto error;
         }
 
-        rc = mpv_observe_property(client,
-                                  cmd_node->u.list->values[1].u.int64,
-                                  cmd_node->u.list->values[2].u.string,
-                                  MPV_FORMAT_STRING);
+        for (int n = 3; n < args->num; n++) {
+            if (args->values[n].format == MPV_FORMAT_INT64) {
+                limits[n - 3] = args->values[n].u.int64;
+            } else if (args->values[n].format == MPV_FORMAT_DOUBLE) {
+                limits[n - 3] = args->values[n].u.double_;
+            } else {
+                rc = MPV_ERROR_INVALID_PARAMETER;
+                goto error;
+            }
+        }
+
+        rc = mpv_observe_property_throttled(client,
+                                            args->values[1].u.int64,
+                                            args->values[2].u.string,
+                                            format, limits[0], limits[1]);
     } else if (!strcmp("unobserve_property", cmd)) {
         if (cmd_node->u.list->num != 2) {
             rc = MPV_ERROR_INVALID_PARAMETER;
@@ -417,12 +511,31 @@ static char *json_execute_command(struct mpv_handle *client, void *ta_parent,
             }
             rc = mpv_request_event(client, event, enable);
         }
+    } else if (protocol && !strcmp("set_protocol", cmd)) {
+        if (cmd_node->u.list->num != 2) {
+            rc = MPV_ERROR_INVALID_PARAMETER;
+            goto error;
+        }
+
+        if (cmd_node->u.list->values[1].format != MPV_FORMAT_STRING) {
+            rc = MPV_ERROR_INVALID_PARAMETER;
+            goto error;
+        }
+
+        char *name = cmd_node->u.list->values[1].u.string;
+        rc = MPV_ERROR_INVALID_PARAMETER;
+        for (int n = 0; n < MP_ARRAY_SIZE(protocol_names); n++) {
+            if (strcmp(protocol_names[n], name) == 0) {
+                *protocol = n;
+                rc = MPV_ERROR_SUCCESS;
+            }
+        }
     } else {
         mpv_node result_node;
 
         rc = mpv_command_node(client, cmd_node, &result_node);
         if (rc >= 0)
-            mpv_node_map_add(ta_parent, &reply_node, "data", &result_node);
+            mpv_node_map_add(ta_parent, reply_node, "data", &result_node);
     }
 
 error:
@@ -431,10 +544,27 @@ error:
      * the original requests.
      */
     if (reqid_node) {
-        mpv_node_map_add(ta_parent, &reply_node, "request_id", reqid_node);
+        mpv_node_map_add(ta_parent, reply_node, "request_id", reqid_node);
     }
 
-    mpv_node_map_add_string(ta_parent, &reply_node, "error", mpv_error_string(rc));
+    mpv_node_map_add_string(ta_parent, reply_node, "error", mpv_error_string(rc));
+}
+
+// Function is allowed to modify src[n].
+static char *json_execute_command(struct mpv_handle *client, void *ta_parent,
+                                  char *src, int *protocol)
+{
+    struct mp_log *log = mp_client_get_log(client);
+
+    mpv_node msg_node;
+    mpv_node reply_node = {.format = MPV_FORMAT_NODE_MAP, .u.list = NULL};
+
+    if (json_parse(ta_parent, &msg_node, &src, 50) < 0) {
+        mp_err(log, "malformed JSON received: '%s'\n", src);
+        msg_node = (mpv_node){.format = MPV_FORMAT_NONE};
+    }
+
+    execute_command(client, ta_parent, &msg_node, &reply_node, protocol);
 
     char *output = talloc_strdup(ta_parent, "");
     json_write(&output, &reply_node);
@@ -443,6 +573,74 @@ error:
     return output;
 }
 
+// If the reply can't be encoded (e.g. because a property returned data that
+// can't be represented), replace it with an error reply, which keeps only the
+// request_id. Otherwise a client waiting for the reply would hang.
+static void fix_reply(void *ta_parent, mpv_node *reply_node)
+{
+    bstr tmp = {0};
+    int r = msgpack_write(NULL, &tmp, reply_node);
+    talloc_free(tmp.start);
+    if (r >= 0)
+        return;
+
+    mpv_node error_node = {.format = MPV_FORMAT_NODE_MAP, .u.list = NULL};
+    mpv_node *reqid_node = mpv_node_map_get(reply_node, "request_id");
+    if (reqid_node)
+        mpv_node_map_add(ta_parent, &error_node, "request_id", reqid_node);
+    mpv_node_map_add_string(ta_parent, &error_node, "error",
+                            mpv_error_string(MPV_ERROR_UNSUPPORTED));
+    *reply_node = error_node;
+}
+
+// Execute a binary frame, and append the reply frame to *out. If the frame
+// contains an array, each element is executed as separate command, and the
+// reply is an array with a reply for each command, in the same order.
+static void msgpack_execute_frame(struct mpv_handle *client, void *ta_parent,
+                                  bstr frame, int *protocol, bstr *out)
+{
+    void *tmp = talloc_new(NULL);
+    struct mp_log *log = mp_client_get_log(client);
+
+    mpv_node msg_node;
+    mpv_node reply_node = {.format = MPV_FORMAT_NODE_MAP, .u.list = NULL};
+
+    if (msgpack_parse(tmp, &msg_node, &frame, 50) < 0 || frame.len) {
+        mp_err(log, "malformed binary frame received\n");
+        msg_node = (mpv_node){.format = MPV_FORMAT_NONE};
+    }
+
+    if (msg_node.format == MPV_FORMAT_NODE_ARRAY) {
+        struct mpv_node_list *cmds = msg_node.u.list;
+        struct mpv_node_list *replies = talloc_zero(tmp, mpv_node_list);
+        replies->values = talloc_zero_array(replies, mpv_node, cmds->num);
+        replies->num = cmds->num;
+        for (int n = 0; n < cmds->num; n++) {
+            replies->values[n].format = MPV_FORMAT_NODE_MAP;
+            execute_command(client, tmp, &cmds->values[n], &replies->values[n],
+                            protocol);
+        }
+        reply_node = (mpv_node){.format = MPV_FORMAT_NODE_ARRAY,
+                                .u.list = replies};
+    } else {
+        execute_command(client, tmp, &msg_node, &reply_node, protocol);
+    }
+
+    if (write_frame(ta_parent, out, &reply_node) < 0) {
+        mp_err(log, "could not encode reply\n");
+        if (reply_node.format == MPV_FORMAT_NODE_ARRAY) {
+            struct mpv_node_list *replies = reply_node.u.list;
+            for (int n = 0; n < replies->num; n++)
+                fix_reply(tmp, &replies->values[n]);
+        } else {
+            fix_reply(tmp, &reply_node);
+        }
+        write_frame(ta_parent, out, &reply_node);
+    }
+
+    talloc_free(tmp);
+}
+
 static char *text_execute_command(struct mpv_handle *client, void *tmp, char *src)
 {
     mpv_command_string(client, src);
@@ -450,15 +648,11 @@ static char *text_execute_command(struct mpv_handle *client, void *tmp, char *sr
     return NULL;
 }
 
-char *mp_ipc_consume_next_command(struct mpv_handle *client, void *ctx, bstr *buf)
+// Execute a line of the text protocol (JSON, or input.conf style commands).
+static char *execute_line(struct mpv_handle *client, void *tmp, bstr line,
+                          int *protocol)
 {
-    void *tmp = talloc_new(NULL);
-
-    bstr rest;
-    bstr line = bstr_getline(*buf, &rest);
     char *line0 = bstrto0(tmp, line);
-    talloc_steal(tmp, buf->start);
-    *buf = bstrdup(NULL, rest);
 
     json_skip_whitespace(&line0);
 
@@ -466,12 +660,70 @@ char *mp_ipc_consume_next_command(struct mpv_handle *client, void *ctx, bstr *bu
     if (line0[0] == '\0' || line0[0] == '#') {
         // skip
     } else if (line0[0] == '{') {
-        reply_msg = json_execute_command(client, tmp, line0);
+        reply_msg = json_execute_command(client, tmp, line0, protocol);
     } else {
         reply_msg = text_execute_command(client, tmp, line0);
     }
 
+    return reply_msg;
+}
+
+char *mp_ipc_consume_next_command(struct mpv_handle *client, void *ctx, bstr *buf)
+{
+    void *tmp = talloc_new(NULL);
+
+    bstr rest;
+    bstr line = bstr_getline(*buf, &rest);
+    char *reply_msg = execute_line(client, tmp, line, NULL);
+    talloc_steal(tmp, buf->start);
+    *buf = bstrdup(NULL, rest);
+
     talloc_steal(ctx, reply_msg);
     talloc_free(tmp);
     return reply_msg;
 }
+
+int mp_ipc_consume_commands(struct mpv_handle *client, int *protocol,
+                            bstr *buf, void *ta_parent, bstr *out)
+{
+    struct mp_log *log = mp_client_get_log(client);
+    bstr rest = *buf;
+    int r = 0;
+
+    // Note that each command can switch the protocol for the following data.
+    while (1) {
+        if (*protocol == MP_IPC_PROTOCOL_MSGPACK) {
+            if (rest.len < 4)
+                break;
+            uint32_t size = ((uint32_t)rest.start[0] << 24) |
+                            (rest.start[1] << 16) | (rest.start[2] << 8) |
+                            rest.start[3];
+            if (size > MAX_FRAME_SIZE) {
+                mp_err(log, "binary frame too large (%u bytes)\n",
+                       (unsigned)size);
+                r = -1;
+                break;
+            }
+            if (rest.len - 4 < size)
+                break;
+            bstr frame = {rest.start + 4, size};
+            rest = bstr_cut(rest, 4 + size);
+            msgpack_execute_frame(client, ta_parent, frame, protocol, out);
+        } else {
+            if (bstrchr(rest, '\n') < 0)
+                break;
+            void *tmp = talloc_new(NULL);
+            bstr line = bstr_getline(rest, &rest);
+            char *reply_msg = execute_line(client, tmp, line, protocol);
+            if (reply_msg)
+                bstr_xappend(ta_parent, out, bstr0(reply_msg));
+            talloc_free(tmp);
+        }
+    }
+
+    // Keep the unprocessed data at the start of the buffer.
+    if (rest.start != buf->start)
+        memmove(buf->start, rest.start, rest.len);
+    buf->len = rest.len;
+    return r;
+}
@@ -205,7 +205,7 @@ extern "C" {
  * relational operators (<, >, <=, >=).
  */
 #define MPV_MAKE_VERSION(major, minor) (((major) << 16) | (minor) | 0UL)
-#define MPV_CLIENT_API_VERSION MPV_MAKE_VERSION(1, 26)
+#define MPV_CLIENT_API_VERSION MPV_MAKE_VERSION(1, 29)
 
 /**
  * The API user is allowed to "#define MPV_ENABLE_DEPRECATED 0" before
@@ -983,6 +983,46 @@ int mpv_set_property_string(mpv_handle *ctx, const char *name, const char *data)
 int mpv_set_property_async(mpv_handle *ctx, uint64_t reply_userdata,
                            const char *name, mpv_format format, void *data);
 
+/**
+ * Set multiple properties at once. This is like calling mpv_set_property() on
+ * each item, except that all properties are set within a single access to the
+ * player core, in the order they appear in the list. In particular, the player
+ * will not react to the first change before the last one has been applied.
+ *
+ * Setting a property doesn't stop on the first failure; the remaining items
+ * are still processed.
+ *
+ * @param num Number of entries in names, data and errors.
+ * @param names Array of property names.
+ * @param format see enum mpv_format. Used for all items.
+ * @param[in] data Array of num values of the C type corresponding to format
+ *                 (e.g. int64_t[] for MPV_FORMAT_INT64).
+ * @param[out] errors If not NULL, an array of num integers, which will be set
+ *                    to the error code of each item.
+ * @return error code; if any item failed, this is the error of the first item
+ *         that failed
+ */
+int mpv_set_properties(mpv_handle *ctx, int num, const char **names,
+                       mpv_format format, void *data, int *errors);
+
+/**
+ * Asynchronous version of mpv_set_properties(). You will receive one
+ * MPV_EVENT_SET_PROPERTY_REPLY event per item, in the same order as the items
+ * appear in the names array. All of them use the given reply_userdata, and
+ * they are queued at once (either all of them or none are sent). If num is 0,
+ * a single reply with error set to 0 is sent.
+ *
+ * @param reply_userdata see section about asynchronous calls
+ * @param num Number of entries in names and data.
+ * @param names Array of property names.
+ * @param format see enum mpv_format.
+ * @param[in] data Array of values. They will be copied by the function.
+ * @return error code if sending the request failed
+ */
+int mpv_set_properties_async(mpv_handle *ctx, uint64_t reply_userdata,
+                             int num, const char **names, mpv_format format,
+                             void *data);
+
 /**
  * Read the value of the given property.
  *
@@ -1041,6 +1081,47 @@ char *mpv_get_property_osd_string(mpv_handle *ctx, const char *name);
 int mpv_get_property_async(mpv_handle *ctx, uint64_t reply_userdata,
                            const char *name, mpv_format format);
 
+/**
+ * Read multiple properties at once. This is like calling mpv_get_property() on
+ * each item, except that all properties are read within a single access to the
+ * player core. This is faster than reading them one by one, and the result is
+ * a consistent snapshot: all values come from the same playloop iteration
+ * (e.g. "time-pos" and "percent-pos" always agree with each other).
+ *
+ * Reading doesn't stop on the first failure; the data entries of failed items
+ * are left untouched.
+ *
+ * @param num Number of entries in names, data and errors.
+ * @param names Array of property names.
+ * @param format see enum mpv_format. Used for all items.
+ * @param[out] data Array of num values of the C type corresponding to format
+ *                  (e.g. mpv_node[] for MPV_FORMAT_NODE). Each successfully
+ *                  read entry must be freed as with mpv_get_property().
+ * @param[out] errors If not NULL, an array of num integers, which will be set
+ *                    to the error code of each item.
+ * @return error code; if any item failed, this is the error of the first item
+ *         that failed
+ */
+int mpv_get_properties(mpv_handle *ctx, int num, const char **names,
+                       mpv_format format, void *data, int *errors);
+
+/**
+ * Asynchronous version of mpv_get_properties(). You will receive one
+ * MPV_EVENT_GET_PROPERTY_REPLY event per item, in the same order as the items
+ * appear in the names array. All of them use the given reply_userdata, and
+ * they are queued at once, so the values form a consistent snapshot just like
+ * with mpv_get_properties(). If num is 0, a single reply with an empty name and
+ * MPV_FORMAT_NONE is sent.
+ *
+ * @param reply_userdata see section about asynchronous calls
+ * @param num Number of entries in names.
+ * @param names Array of property names.
+ * @param format see enum mpv_format.
+ * @return error code if sending the request failed
+ */
+int mpv_get_properties_async(mpv_handle *ctx, uint64_t reply_userdata,
+                             int num, const char **names, mpv_format format);
+
 /**
  * Get a notification whenever the given property changes. You will receive
  * updates as MPV_EVENT_PROPERTY_CHANGE. Note that this is not very precise:
@@ -1091,6 +1172,30 @@ int mpv_get_property_async(mpv_handle *ctx, uint64_t reply_userdata,
 int mpv_observe_property(mpv_handle *mpv, uint64_t reply_userdata,
                          const char *name, mpv_format format);
 
+/**
+ * Like mpv_observe_property(), but limit how often change events are
+ * generated. This is useful for properties which change often (like
+ * "time-pos"), or which are expensive to retrieve (like "track-list"), if
+ * the client doesn't need every update.
+ *
+ * If the property changes again within min_interval seconds after a change
+ * was signaled, the player waits until the interval has passed, and then
+ * signals a single change. The property value is not retrieved in the
+ * meantime. The last change is never lost, only delayed.
+ *
+ * If min_delta is larger than 0, and the format is MPV_FORMAT_DOUBLE or
+ * MPV_FORMAT_INT64, a new value is only returned if it differs by at least
+ * min_delta from the last value returned with a change event. For other
+ * formats, min_delta is ignored.
+ *
+ * @param min_interval minimum time in seconds between change events, or 0
+ * @param min_delta minimum change of numeric values, or 0
+ * @return error code
+ */
+int mpv_observe_property_throttled(mpv_handle *mpv, uint64_t reply_userdata,
+                                   const char *name, mpv_format format,
+                                   double min_interval, double min_delta);
+
 /**
  * Undo mpv_observe_property(). This will remove all observed properties for
  * which the given number was passed as reply_userdata to mpv_observe_property.
@@ -1561,6 +1666,35 @@ int mpv_request_log_messages(mpv_handle *ctx, const char *min_level);
  */
 mpv_event *mpv_wait_event(mpv_handle *ctx, double timeout);
 
+/**
+ * Like mpv_wait_event(), but return all available events (up to max_events)
+ * at once. This waits until at least one event is available, or until the
+ * timeout expires, or if mpv_wakeup() is called. Then it takes all queued
+ * events, outstanding property change events and log messages in a single
+ * pass. The events are returned in the same order as repeated calls to
+ * mpv_wait_event() would return them.
+ *
+ * This is meant for clients which receive a large number of events (e.g.
+ * log messages or property changes), and want to avoid the per-call overhead
+ * of mpv_wait_event().
+ *
+ * The same restrictions as with mpv_wait_event() apply. In particular, calling
+ * either function invalidates the events returned by the previous call.
+ *
+ * @param timeout see mpv_wait_event()
+ * @param[out] events Array with max_events entries. The returned events are
+ *                    copied to the first entries of this array. All memory
+ *                    referenced by them stays valid until the next
+ *                    mpv_wait_events() or mpv_wait_event() call, or until the
+ *                    mpv_handle is destroyed. MPV_EVENT_NONE is never
+ *                    returned.
+ * @param max_events Maximum number of events to return. Must be at least 1.
+ * @return Number of events written to the events array (0 on timeout), or an
+ *         error code.
+ */
+int mpv_wait_events(mpv_handle *ctx, double timeout, mpv_event *events,
+                    int max_events);
+
 /**
  * Interrupt the current mpv_wait_event() call. This will wake up the thread
  * currently waiting in mpv_wait_event(). If no thread is waiting, the next
@@ -24,6 +24,10 @@
 
 #include <libavutil/common.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include "mpv_talloc.h"
 
 #include "common/common.h"
@@ -64,12 +68,16 @@ int bstrcasecmp(struct bstr str1, struct bstr str2)
     return ret;
 }
 
+// The scanning functions below defer to memchr() where possible, which is
+// vectorized (and dispatched by CPU features at runtime) in all libcs we care
+// about. Subtitle and playlist parsers call them on large files.
+
 int bstrchr(struct bstr str, int c)
 {
-    for (int i = 0; i < str.len; i++)
-        if (str.start[i] == c)
-            return i;
-    return -1;
+    if (c < 0 || c > 255 || !str.len)
+        return -1;
+    unsigned char *pos = memchr(str.start, c, str.len);
+    return pos ? pos - str.start : -1;
 }
 
 int bstrrchr(struct bstr str, int c)
@@ -80,29 +88,55 @@ int bstrrchr(struct bstr str, int c)
     return -1;
 }
 
+// Set bit c in set for each char c in chars. Like strchr(), the terminating
+// 0 byte is considered part of chars.
+static void make_charset(uint32_t set[8], const char *chars)
+{
+    memset(set, 0, sizeof(uint32_t[8]));
+    const unsigned char *p = (const unsigned char *)chars;
+    do {
+        set[*p >> 5] |= 1u << (*p & 31);
+    } while (*p++);
+}
+
+#define CHARSET_HAS(set, c) ((set)[(c) >> 5] & (1u << ((c) & 31)))
+
 int bstrcspn(struct bstr str, const char *reject)
 {
+    uint32_t set[8];
+    make_charset(set, reject);
     int i;
     for (i = 0; i < str.len; i++)
-        if (strchr(reject, str.start[i]))
+        if (CHARSET_HAS(set, str.start[i]))
             break;
     return i;
 }
 
 int bstrspn(struct bstr str, const char *accept)
 {
+    uint32_t set[8];
+    make_charset(set, accept);
     int i;
     for (i = 0; i < str.len; i++)
-        if (!strchr(accept, str.start[i]))
+        if (!CHARSET_HAS(set, str.start[i]))
             break;
     return i;
 }
 
 int bstr_find(struct bstr haystack, struct bstr needle)
 {
-    for (int i = 0; i < haystack.len; i++)
-        if (bstr_startswith(bstr_splice(haystack, i, haystack.len), needle))
-            return i;
+    if (!needle.len)
+        return haystack.len ? 0 : -1;
+    unsigned char *p = haystack.start;
+    unsigned char *end = haystack.start + haystack.len;
+    while (end - p >= needle.len) {
+        p = memchr(p, needle.start[0], end - p - needle.len + 1);
+        if (!p)
+            break;
+        if (memcmp(p + 1, needle.start + 1, needle.len - 1) == 0)
+            return p - haystack.start;
+        p++;
+    }
     return -1;
 }
 
@@ -197,17 +231,17 @@ struct bstr *bstr_splitlines(void *talloc_ctx, struct bstr str)
 {
     if (str.len == 0)
         return NULL;
+    unsigned char *end = str.start + str.len;
     int count = 0;
-    for (int i = 0; i < str.len; i++)
-        if (str.start[i] == '\n')
-            count++;
-    if (str.start[str.len - 1] != '\n')
+    for (unsigned char *p = str.start; (p = memchr(p, '\n', end - p)); p++)
+        count++;
+    if (end[-1] != '\n')
         count++;
     struct bstr *r = talloc_array_ptrtype(talloc_ctx, r, count);
     unsigned char *p = str.start;
     for (int i = 0; i < count - 1; i++) {
         r[i].start = p;
-        while (*p++ != '\n');
+        p = (unsigned char *)memchr(p, '\n', end - p) + 1;
         r[i].len = p - r[i].start;
     }
     r[count - 1].start = p;
@@ -319,9 +353,36 @@ struct bstr bstr_split_utf8(struct bstr str, struct bstr *out_next)
     return bstr_splice(str, 0, str.len - rest.len);
 }
 
+// Return the number of leading ASCII bytes in s.
+static size_t ascii_prefix_len(struct bstr s)
+{
+    size_t i = 0;
+#if defined(__SSE2__)
+    for (; i + 16 <= s.len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(s.start + i));
+        if (_mm_movemask_epi8(v))
+            break;
+    }
+#else
+    for (; i + 8 <= s.len; i += 8) {
+        uint64_t v;
+        memcpy(&v, s.start + i, 8);
+        if (v & 0x8080808080808080ULL)
+            break;
+    }
+#endif
+    while (i < s.len && s.start[i] < 128)
+        i++;
+    return i;
+}
+
 int bstr_validate_utf8(struct bstr s)
 {
     while (s.len) {
+        // Most text is mostly ASCII, which needs no decoding.
+        s = bstr_cut(s, ascii_prefix_len(s));
+        if (!s.len)
+            break;
         if (bstr_decode_utf8(s, &s) < 0) {
             // Try to guess whether the sequence was just cut-off.
             unsigned int codepoint = (unsigned char)s.start[0];
@@ -0,0 +1,189 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+
+#include "osdep/atomic.h"
+#include "osdep/io.h"
+
+#include "common/common.h"
+#include "common/msg.h"
+#include "misc/charset_conv.h"
+
+#include "dir_cache.h"
+
+// Number of directory listings kept around. Playing a playlist usually only
+// touches the media directory and a few --sub-paths/--audio-file-paths dirs.
+#define MAX_CACHED_DIRS 16
+
+struct listing_priv {
+    struct mp_dir_listing pub; // must be first member
+    atomic_int refcount;
+    // Used to detect changes. Directory mtimes are updated on file creation,
+    // deletion and renaming within the directory.
+    dev_t dev;
+    ino_t ino;
+    time_t mtime;
+};
+
+struct mp_dir_cache {
+    pthread_mutex_t lock;
+    // Most recently used entries first.
+    struct listing_priv *entries[MAX_CACHED_DIRS];
+    int num_entries;
+};
+
+static struct listing_priv *read_dir(struct mp_log *log, const char *path,
+                                     struct stat *st)
+{
+    DIR *d = opendir(path);
+    if (!d)
+        return NULL;
+
+    struct listing_priv *p = talloc_zero(NULL, struct listing_priv);
+    struct mp_dir_listing *l = &p->pub;
+    l->path = talloc_strdup(p, path);
+    atomic_store(&p->refcount, 1);
+    p->dev = st->st_dev;
+    p->ino = st->st_ino;
+    p->mtime = st->st_mtime;
+
+    struct dirent *de;
+    while ((de = readdir(d))) {
+        struct mp_dir_entry e = {
+            .name = talloc_strdup(p, de->d_name),
+        };
+        bstr den = bstr0(e.name);
+        e.uname = mp_iconv_to_utf8(log, den, "UTF-8-MAC", MP_NO_LATIN1_FALLBACK);
+        if (e.uname.start != den.start)
+            talloc_steal(p, e.uname.start);
+        e.ext = bstr_get_ext(e.uname);
+        e.lower_noext = bstrdup(p, bstr_strip_ext(e.uname));
+        bstr_lower(e.lower_noext);
+        e.lower_noext = bstr_strip(e.lower_noext);
+        MP_TARRAY_APPEND(p, l->entries, l->num_entries, e);
+    }
+    closedir(d);
+
+    return p;
+}
+
+static void unref_listing(struct listing_priv *p)
+{
+    if (atomic_fetch_add(&p->refcount, -1) == 1)
+        talloc_free(p);
+}
+
+// Remove entry n from the cache. Caller must hold the lock.
+static void drop_entry(struct mp_dir_cache *c, int n)
+{
+    unref_listing(c->entries[n]);
+    memmove(&c->entries[n], &c->entries[n + 1],
+            (c->num_entries - n - 1) * sizeof(c->entries[0]));
+    c->num_entries--;
+}
+
+// Insert p as most recently used entry. Caller must hold the lock, and must
+// have made room for it.
+static void insert_entry(struct mp_dir_cache *c, struct listing_priv *p)
+{
+    assert(c->num_entries < MAX_CACHED_DIRS);
+    memmove(&c->entries[1], &c->entries[0],
+            c->num_entries * sizeof(c->entries[0]));
+    c->entries[0] = p;
+    c->num_entries++;
+}
+
+static void dir_cache_destroy(void *ptr)
+{
+    struct mp_dir_cache *c = ptr;
+    while (c->num_entries)
+        drop_entry(c, c->num_entries - 1);
+    pthread_mutex_destroy(&c->lock);
+}
+
+struct mp_dir_cache *mp_dir_cache_create(void *ta_parent)
+{
+    struct mp_dir_cache *c = talloc_zero(ta_parent, struct mp_dir_cache);
+    talloc_set_destructor(c, dir_cache_destroy);
+    pthread_mutex_init(&c->lock, NULL);
+    return c;
+}
+
+// Return the contents of the given directory. Reuses a cached listing if the
+// directory was not modified since it was read. The caller must release the
+// returned listing with mp_dir_listing_unref(). Returns NULL on failure.
+// c can be NULL, in which case the directory is always read.
+// This function is thread-safe.
+struct mp_dir_listing *mp_dir_cache_get(struct mp_dir_cache *c,
+                                        struct mp_log *log, const char *path)
+{
+    struct stat st;
+    if (stat(path, &st) != 0 || !S_ISDIR(st.st_mode))
+        return NULL;
+
+    if (c) {
+        pthread_mutex_lock(&c->lock);
+        for (int n = 0; n < c->num_entries; n++) {
+            struct listing_priv *p = c->entries[n];
+            if (strcmp(p->pub.path, path) == 0 && p->dev == st.st_dev &&
+                p->ino == st.st_ino && p->mtime == st.st_mtime)
+            {
+                atomic_fetch_add(&p->refcount, 1); // keep it while moving
+                drop_entry(c, n);
+                insert_entry(c, p);
+                atomic_fetch_add(&p->refcount, 1);
+                pthread_mutex_unlock(&c->lock);
+                mp_dbg(log, "Using cached directory listing for %s\n", path);
+                return &p->pub;
+            }
+        }
+        pthread_mutex_unlock(&c->lock);
+    }
+
+    struct listing_priv *p = read_dir(log, path, &st);
+    if (!p)
+        return NULL;
+
+    // mtime has only 1 second resolution on some filesystems, so a directory
+    // changed within the same second would go unnoticed. Don't cache it yet.
+    if (!c || time(NULL) - st.st_mtime < 2)
+        return &p->pub;
+
+    pthread_mutex_lock(&c->lock);
+    for (int n = c->num_entries - 1; n >= 0; n--) {
+        if (strcmp(c->entries[n]->pub.path, path) == 0)
+            drop_entry(c, n);
+    }
+    if (c->num_entries == MAX_CACHED_DIRS)
+        drop_entry(c, c->num_entries - 1);
+    atomic_fetch_add(&p->refcount, 1);
+    insert_entry(c, p);
+    pthread_mutex_unlock(&c->lock);
+
+    return &p->pub;
+}
+
+void mp_dir_listing_unref(struct mp_dir_listing *listing)
+{
+    if (listing)
+        unref_listing((struct listing_priv *)listing);
+}
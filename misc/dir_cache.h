@@ -0,0 +1,29 @@
+#ifndef MP_DIR_CACHE_H_
+#define MP_DIR_CACHE_H_
+
+#include "misc/bstr.h"
+
+struct mp_log;
+
+struct mp_dir_entry {
+    char *name;         // as returned by readdir()
+    bstr uname;         // name converted to UTF-8 (from UTF-8-MAC if needed)
+    bstr ext;           // extension part of uname (case not changed)
+    bstr lower_noext;   // lower-cased uname, extension and whitespace stripped
+};
+
+// Immutable after creation; can be used from any thread while referenced.
+struct mp_dir_listing {
+    char *path;
+    struct mp_dir_entry *entries;
+    int num_entries;
+};
+
+struct mp_dir_cache;
+
+struct mp_dir_cache *mp_dir_cache_create(void *ta_parent);
+struct mp_dir_listing *mp_dir_cache_get(struct mp_dir_cache *c,
+                                        struct mp_log *log, const char *path);
+void mp_dir_listing_unref(struct mp_dir_listing *listing);
+
+#endif
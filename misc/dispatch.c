@@ -19,6 +19,8 @@
 #include <assert.h>
 
 #include "common/common.h"
+#include "common/msg.h"
+#include "osdep/atomic.h"
 #include "osdep/threads.h"
 #include "osdep/timer.h"
 
@@ -26,12 +28,20 @@
 
 struct mp_dispatch_queue {
     struct mp_dispatch_item *head, *tail;
+    // Items added without holding the lock (struct mp_dispatch_item*). This is
+    // a LIFO list, newest item first. It's moved to head/tail by whoever holds
+    // the lock next (see pull_incoming()), so it's a MPSC queue with any
+    // thread holding the lock being the consumer.
+    atomic_uintptr_t incoming;
     pthread_mutex_t lock;
     pthread_cond_t cond;
     void (*wakeup_fn)(void *wakeup_ctx);
     void *wakeup_ctx;
     // Make mp_dispatch_queue_process() exit if it's idle.
-    bool interrupted;
+    atomic_bool interrupted;
+    // The target thread is waiting on cond for new items, and must be woken
+    // up by threads adding items to incoming.
+    atomic_bool sleeping;
     // The target thread is blocked by mp_dispatch_queue_process(). Note that
     // mp_dispatch_lock() can set this from true to false to keep the thread
     // blocked (this stops if from processing other dispatch items, and from
@@ -46,6 +56,9 @@ struct mp_dispatch_queue {
     // also increment it when locking), but with this we can perform some
     // minimal debug checks.
     struct lock_frame *frame;
+    // Protected by lock.
+    int num_queued; // number of items in head/tail
+    struct mp_dispatch_stats stats;
 };
 
 struct lock_frame {
@@ -61,6 +74,7 @@ struct mp_dispatch_item {
     bool asynchronous;
     bool mergeable;
     bool completed;
+    int64_t queued_time;
     struct mp_dispatch_item *next;
 };
 
@@ -68,6 +82,7 @@ static void queue_dtor(void *p)
 {
     struct mp_dispatch_queue *queue = p;
     assert(!queue->head);
+    assert(!atomic_load(&queue->incoming));
     assert(!queue->idling);
     assert(!queue->lock_request);
     assert(!queue->frame);
@@ -110,10 +125,74 @@ void mp_dispatch_set_wakeup_fn(struct mp_dispatch_queue *queue,
     queue->wakeup_ctx = wakeup_ctx;
 }
 
+// Move items from the lock-free incoming list to the locked list.
+static void pull_incoming(struct mp_dispatch_queue *queue)
+{
+    struct mp_dispatch_item *cur =
+        (void *)atomic_exchange(&queue->incoming, (uintptr_t)0);
+    if (!cur)
+        return;
+    // Reverse the list to restore the order the items were added in.
+    struct mp_dispatch_item *first = NULL, *last = cur;
+    while (cur) {
+        struct mp_dispatch_item *next = cur->next;
+        cur->next = first;
+        first = cur;
+        cur = next;
+        queue->num_queued++;
+    }
+    if (queue->tail) {
+        queue->tail->next = first;
+    } else {
+        queue->head = first;
+    }
+    queue->tail = last;
+    queue->stats.max_depth = MPMAX(queue->stats.max_depth, queue->num_queued);
+}
+
+// Add an item without taking the lock (unless the target thread needs to be
+// woken up from waiting on the condition).
+static void mp_dispatch_push(struct mp_dispatch_queue *queue,
+                             struct mp_dispatch_item *item)
+{
+    assert(!item->mergeable);
+    item->queued_time = mp_time_us();
+
+    uintptr_t head = atomic_load(&queue->incoming);
+    do {
+        item->next = (void *)head;
+    } while (!atomic_compare_exchange_strong(&queue->incoming, &head,
+                                             (uintptr_t)item));
+
+    // No wakeup callback -> assume mp_dispatch_queue_process() needs to be
+    // interrupted instead. (Set after adding the item, so that the target
+    // thread can't reset the flag before it has seen the item.)
+    if (!queue->wakeup_fn)
+        atomic_store(&queue->interrupted, true);
+
+    // The target thread sets sleeping under the lock, and checks incoming
+    // after that, so either it sees the item, or we see sleeping==true and
+    // the broadcast happens while it waits. If incoming wasn't empty, the
+    // thread which added the previous item took care of this.
+    if (!head && atomic_load(&queue->sleeping)) {
+        pthread_mutex_lock(&queue->lock);
+        pthread_cond_broadcast(&queue->cond);
+        pthread_mutex_unlock(&queue->lock);
+    }
+
+    if (queue->wakeup_fn)
+        queue->wakeup_fn(queue->wakeup_ctx);
+}
+
+// Add an item under the lock. Needed for mergeable items, which must be
+// compared against the already queued items.
 static void mp_dispatch_append(struct mp_dispatch_queue *queue,
                                struct mp_dispatch_item *item)
 {
+    item->queued_time = mp_time_us();
+
     pthread_mutex_lock(&queue->lock);
+    pull_incoming(queue);
     if (item->mergeable) {
         for (struct mp_dispatch_item *cur = queue->head; cur; cur = cur->next) {
             if (cur->mergeable && cur->fn == item->fn &&
@@ -132,6 +211,8 @@ static void mp_dispatch_append(struct mp_dispatch_queue *queue,
         queue->head = item;
     }
     queue->tail = item;
+    queue->num_queued++;
+    queue->stats.max_depth = MPMAX(queue->stats.max_depth, queue->num_queued);
 
     // Wake up the main thread; note that other threads might wait on this
     // condition for reasons, so broadcast the condition.
@@ -139,7 +220,7 @@ static void mp_dispatch_append(struct mp_dispatch_queue *queue,
     // No wakeup callback -> assume mp_dispatch_queue_process() needs to be
     // interrupted instead.
     if (!queue->wakeup_fn)
-        queue->interrupted = true;
+        atomic_store(&queue->interrupted, true);
     pthread_mutex_unlock(&queue->lock);
 
     if (queue->wakeup_fn)
@@ -161,7 +242,7 @@ void mp_dispatch_enqueue(struct mp_dispatch_queue *queue,
         .fn_data = fn_data,
         .asynchronous = true,
     };
-    mp_dispatch_append(queue, item);
+    mp_dispatch_push(queue, item);
 }
 
 // Like mp_dispatch_enqueue(), but the queue code will call talloc_free(fn_data)
@@ -177,7 +258,7 @@ void mp_dispatch_enqueue_autofree(struct mp_dispatch_queue *queue,
         .fn_data = talloc_steal(item, fn_data),
         .asynchronous = true,
     };
-    mp_dispatch_append(queue, item);
+    mp_dispatch_push(queue, item);
 }
 
 // Like mp_dispatch_enqueue(), but
@@ -206,12 +287,14 @@ void mp_dispatch_cancel_fn(struct mp_dispatch_queue *queue,
                            mp_dispatch_fn fn, void *fn_data)
 {
     pthread_mutex_lock(&queue->lock);
+    pull_incoming(queue);
     struct mp_dispatch_item **pcur = &queue->head;
     queue->tail = NULL;
     while (*pcur) {
         struct mp_dispatch_item *cur = *pcur;
         if (cur->fn == fn && cur->fn_data == fn_data) {
             *pcur = cur->next;
+            queue->num_queued--;
             talloc_free(cur);
         } else {
             queue->tail = cur;
@@ -232,7 +315,7 @@ void mp_dispatch_run(struct mp_dispatch_queue *queue,
         .fn = fn,
         .fn_data = fn_data,
     };
-    mp_dispatch_append(queue, &item);
+    mp_dispatch_push(queue, &item);
 
     pthread_mutex_lock(&queue->lock);
     while (!item.completed)
@@ -271,6 +354,7 @@ void mp_dispatch_queue_process(struct mp_dispatch_queue *queue, double timeout)
     if (queue->lock_request)
         pthread_cond_broadcast(&queue->cond);
     while (1) {
+        pull_incoming(queue);
         if (queue->lock_request || queue->frame != &frame || frame.locked) {
             // Block due to something having called mp_dispatch_lock(). This
             // is either a lock "acquire" (lock_request=true), or a lock in
@@ -287,6 +371,12 @@ void mp_dispatch_queue_process(struct mp_dispatch_queue *queue, double timeout)
             if (!queue->head)
                 queue->tail = NULL;
             item->next = NULL;
+            queue->num_queued--;
+            int64_t latency = mp_time_us() - item->queued_time;
+            queue->stats.items++;
+            queue->stats.latency_us += latency;
+            queue->stats.max_latency_us =
+                MPMAX(queue->stats.max_latency_us, latency);
             // Unlock, because we want to allow other threads to queue items
             // while the dispatch item is processed.
             // At the same time, we must prevent other threads from returning
@@ -306,10 +396,17 @@ void mp_dispatch_queue_process(struct mp_dispatch_queue *queue, double timeout)
             } else {
                 item->completed = true;
             }
-        } else if (wait > 0 && !queue->interrupted) {
-            struct timespec ts = mp_time_us_to_timespec(wait);
-            if (pthread_cond_timedwait(&queue->cond, &queue->lock, &ts))
-                wait = 0;
+        } else if (wait > 0 && !atomic_load(&queue->interrupted)) {
+            atomic_store(&queue->sleeping, true);
+            // Recheck after setting sleeping, see mp_dispatch_push().
+            if (!atomic_load(&queue->incoming) &&
+                !atomic_load(&queue->interrupted))
+            {
+                struct timespec ts = mp_time_us_to_timespec(wait);
+                if (pthread_cond_timedwait(&queue->cond, &queue->lock, &ts))
+                    wait = 0;
+            }
+            atomic_store(&queue->sleeping, false);
         } else {
             break;
         }
@@ -318,7 +415,7 @@ void mp_dispatch_queue_process(struct mp_dispatch_queue *queue, double timeout)
     assert(!frame.locked);
     assert(queue->frame == &frame);
     queue->frame = frame.prev;
-    queue->interrupted = false;
+    atomic_store(&queue->interrupted, false);
     pthread_mutex_unlock(&queue->lock);
 }
 
@@ -331,7 +428,7 @@ void mp_dispatch_queue_process(struct mp_dispatch_queue *queue, double timeout)
 void mp_dispatch_interrupt(struct mp_dispatch_queue *queue)
 {
     pthread_mutex_lock(&queue->lock);
-    queue->interrupted = true;
+    atomic_store(&queue->interrupted, true);
     pthread_cond_broadcast(&queue->cond);
     pthread_mutex_unlock(&queue->lock);
 }
@@ -343,6 +440,7 @@ void mp_dispatch_interrupt(struct mp_dispatch_queue *queue)
 // and the mutex behavior applies to this function only.
 void mp_dispatch_lock(struct mp_dispatch_queue *queue)
 {
+    int64_t start = mp_time_us();
     pthread_mutex_lock(&queue->lock);
     // First grab the queue lock. Something else could be holding the lock.
     while (queue->lock_request)
@@ -369,6 +467,8 @@ void mp_dispatch_lock(struct mp_dispatch_queue *queue)
     // Reset state for recursive mp_dispatch_queue_process() calls.
     queue->lock_request = false;
     queue->idling = false;
+    queue->stats.locks++;
+    queue->stats.lock_wait_us += mp_time_us() - start;
     pthread_mutex_unlock(&queue->lock);
 }
 
@@ -390,3 +490,25 @@ void mp_dispatch_unlock(struct mp_dispatch_queue *queue)
     pthread_cond_broadcast(&queue->cond);
     pthread_mutex_unlock(&queue->lock);
 }
+
+// Return statistics about the queue since its creation.
+void mp_dispatch_get_stats(struct mp_dispatch_queue *queue,
+                           struct mp_dispatch_stats *stats)
+{
+    pthread_mutex_lock(&queue->lock);
+    *stats = queue->stats;
+    pthread_mutex_unlock(&queue->lock);
+}
+
+// Print the statistics with mp_verbose().
+void mp_dispatch_log_stats(struct mp_dispatch_queue *queue, struct mp_log *log,
+                           const char *name)
+{
+    struct mp_dispatch_stats st;
+    mp_dispatch_get_stats(queue, &st);
+    mp_verbose(log, "%s dispatch queue: %"PRIu64" items (latency avg/max "
+               "%"PRId64"/%"PRId64" us, max. depth %d), %"PRIu64" locks "
+               "(%"PRId64" us waited in total).\n", name, st.items,
+               st.items ? st.latency_us / (int64_t)st.items : 0,
+               st.max_latency_us, st.max_depth, st.locks, st.lock_wait_us);
+}
@@ -1,8 +1,11 @@
 #ifndef MP_DISPATCH_H_
 #define MP_DISPATCH_H_
 
+#include <stdint.h>
+
 typedef void (*mp_dispatch_fn)(void *data);
 struct mp_dispatch_queue;
+struct mp_log;
 
 struct mp_dispatch_queue *mp_dispatch_create(void *talloc_parent);
 void mp_dispatch_set_wakeup_fn(struct mp_dispatch_queue *queue,
@@ -23,4 +26,18 @@ void mp_dispatch_interrupt(struct mp_dispatch_queue *queue);
 void mp_dispatch_lock(struct mp_dispatch_queue *queue);
 void mp_dispatch_unlock(struct mp_dispatch_queue *queue);
 
+struct mp_dispatch_stats {
+    uint64_t items;             // number of dispatch items run
+    int64_t latency_us;         // sum of time between queuing and running
+    int64_t max_latency_us;
+    int max_depth;              // max. number of items queued at once
+    uint64_t locks;             // number of mp_dispatch_lock() calls
+    int64_t lock_wait_us;       // sum of time spent to acquire the lock
+};
+
+void mp_dispatch_get_stats(struct mp_dispatch_queue *queue,
+                           struct mp_dispatch_stats *stats);
+void mp_dispatch_log_stats(struct mp_dispatch_queue *queue, struct mp_log *log,
+                           const char *name);
+
 #endif
@@ -37,9 +37,20 @@
  *
  * Currently, will insert \u literals for characters 0-31, '"', '\', and write
  * everything else literally.
+ *
+ * Performance notes:
+ *
+ * Both directions are on the IPC hot path. Scanning for the end of string
+ * literals (and for characters that need escaping on output) is done 8 bytes
+ * at a time. Lists are collected on a scratch stack shared by the whole parse,
+ * so each list is allocated once with its final size, instead of being grown
+ * element by element. Integers and doubles in the common range are formatted
+ * without going through printf; the output is identical to "%"PRId64 and "%f".
  */
 
 #include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <string.h>
 #include <math.h>
 #include <errno.h>
@@ -51,6 +62,31 @@
 
 #include "json.h"
 
+// Word-at-a-time helpers. All of them return non-0 if the condition is true
+// for at least one byte in the word (the exact bits set are meaningless).
+#define WORD_REP(c) (UINT64_C(0x0101010101010101) * (uint8_t)(c))
+#define WORD_HAS_ZERO(w) (((w) - WORD_REP(1)) & ~(w) & WORD_REP(0x80))
+#define WORD_HAS_BYTE(w, c) WORD_HAS_ZERO((w) ^ WORD_REP(c))
+#define WORD_HAS_LESS(w, n) (((w) - WORD_REP(n)) & ~(w) & WORD_REP(0x80))
+
+static inline uint64_t load_word(const void *p)
+{
+    uint64_t w;
+    memcpy(&w, p, sizeof(w));
+    return w;
+}
+
+struct parse_ctx {
+    void *ta_parent;
+    char *end;              // end of the input string (the terminating \0)
+    // Scratch stack for list elements; read_sub() pushes elements while
+    // reading, and pops them when the list is complete.
+    void *tmp;              // heap allocation of the stack (if any)
+    struct mpv_node *values;
+    char **keys;
+    int num, alloc;
+};
+
 static bool eat_c(char **s, char c)
 {
     if (**s == c) {
@@ -70,25 +106,55 @@ static void eat_ws(char **src)
     }
 }
 
+// Like eat_ws(), but skip runs of spaces (e.g. indentation) quickly.
+static void eat_ws_fast(struct parse_ctx *ctx, char **src)
+{
+    char *cur = *src;
+    while (1) {
+        while (ctx->end - cur >= 8 && load_word(cur) == WORD_REP(' '))
+            cur += 8;
+        char c = *cur;
+        if (c != ' ' && c != '\t' && c != '\n' && c != '\r')
+            break;
+        cur++;
+    }
+    *src = cur;
+}
+
 void json_skip_whitespace(char **src)
 {
     eat_ws(src);
 }
 
-static int read_str(void *ta_parent, struct mpv_node *dst, char **src)
+// Return the first '"', '\' or '\0' at or after cur.
+static char *find_str_special(struct parse_ctx *ctx, char *cur)
+{
+    while (ctx->end - cur >= 8) {
+        uint64_t w = load_word(cur);
+        if (WORD_HAS_ZERO(w) | WORD_HAS_BYTE(w, '"') | WORD_HAS_BYTE(w, '\\'))
+            break;
+        cur += 8;
+    }
+    while (cur[0] && cur[0] != '"' && cur[0] != '\\')
+        cur++;
+    return cur;
+}
+
+static int read_str(struct parse_ctx *ctx, struct mpv_node *dst, char **src)
 {
     if (!eat_c(src, '"'))
         return -1; // not a string
     char *str = *src;
     char *cur = str;
     bool has_escapes = false;
-    while (cur[0] && cur[0] != '"') {
-        if (cur[0] == '\\') {
-            has_escapes = true;
-            // skip >\"< and >\\< (latter to handle >\\"< correctly)
-            if (cur[1] == '"' || cur[1] == '\\')
-                cur++;
-        }
+    while (1) {
+        cur = find_str_special(ctx, cur);
+        if (cur[0] != '\\')
+            break;
+        has_escapes = true;
+        // skip >\"< and >\\< (latter to handle >\\"< correctly)
+        if (cur[1] == '"' || cur[1] == '\\')
+            cur++;
         cur++;
     }
     if (cur[0] != '"')
@@ -99,8 +165,8 @@ static int read_str(void *ta_parent, struct mpv_node *dst, char **src)
     *src = cur + 1;
     if (has_escapes) {
         bstr unescaped = {0};
-        bstr r = bstr0(str);
-        if (!mp_append_escaped_string(ta_parent, &unescaped, &r))
+        bstr r = {str, cur - str};
+        if (!mp_append_escaped_string(ctx->ta_parent, &unescaped, &r))
             return -1; // broken escapes
         str = unescaped.start; // the function guarantees null-termination
     }
@@ -109,7 +175,29 @@ static int read_str(void *ta_parent, struct mpv_node *dst, char **src)
     return 0;
 }
 
-static int read_sub(void *ta_parent, struct mpv_node *dst, char **src,
+static int parse_value(struct parse_ctx *ctx, struct mpv_node *dst, char **src,
+                       int max_depth);
+
+// The initial scratch stack is on the C stack; move it to the heap when full.
+static void grow_stack(struct parse_ctx *ctx)
+{
+    int alloc = ctx->alloc * 2;
+    if (!ctx->tmp) {
+        ctx->tmp = talloc_new(NULL);
+        struct mpv_node *values = talloc_array(ctx->tmp, struct mpv_node, alloc);
+        char **keys = talloc_array(ctx->tmp, char *, alloc);
+        memcpy(values, ctx->values, ctx->num * sizeof(values[0]));
+        memcpy(keys, ctx->keys, ctx->num * sizeof(keys[0]));
+        ctx->values = values;
+        ctx->keys = keys;
+    } else {
+        ctx->values = talloc_realloc(ctx->tmp, ctx->values, struct mpv_node, alloc);
+        ctx->keys = talloc_realloc(ctx->tmp, ctx->keys, char *, alloc);
+    }
+    ctx->alloc = alloc;
+}
+
+static int read_sub(struct parse_ctx *ctx, struct mpv_node *dst, char **src,
                     int max_depth)
 {
     bool is_arr = eat_c(src, '[');
@@ -117,53 +205,110 @@ static int read_sub(void *ta_parent, struct mpv_node *dst, char **src,
     if (!is_arr && !is_obj)
         return -1; // not an array or object
     char term = is_obj ? '}' : ']';
-    struct mpv_node_list *list = talloc_zero(ta_parent, struct mpv_node_list);
+    int base = ctx->num;
     while (1) {
-        eat_ws(src);
+        eat_ws_fast(ctx, src);
         if (eat_c(src, term))
             break;
-        if (list->num > 0 && !eat_c(src, ','))
-            return -1; // missing ','
-        eat_ws(src);
+        if (ctx->num > base && !eat_c(src, ','))
+            goto error; // missing ','
+        eat_ws_fast(ctx, src);
+        char *key = NULL;
         if (is_obj) {
             struct mpv_node keynode;
-            if (read_str(list, &keynode, src) < 0)
-                return -1; // key is not a string
-            eat_ws(src);
+            if (read_str(ctx, &keynode, src) < 0)
+                goto error; // key is not a string
+            eat_ws_fast(ctx, src);
             if (!eat_c(src, ':'))
-                return -1; // ':' missing
-            eat_ws(src);
-            MP_TARRAY_GROW(list, list->keys, list->num);
-            list->keys[list->num] = keynode.u.string;
+                goto error; // ':' missing
+            eat_ws_fast(ctx, src);
+            key = keynode.u.string;
+        }
+        struct mpv_node value;
+        if (parse_value(ctx, &value, src, max_depth) < 0)
+            goto error;
+        if (ctx->num == ctx->alloc)
+            grow_stack(ctx);
+        ctx->values[ctx->num] = value;
+        ctx->keys[ctx->num] = key;
+        ctx->num++;
+    }
+    // Allocate the list with its final size, and pop the elements.
+    int num = ctx->num - base;
+    struct mpv_node_list *list = talloc_zero(ctx->ta_parent, struct mpv_node_list);
+    if (num) {
+        list->values = talloc_memdup(list, &ctx->values[base],
+                                     num * sizeof(list->values[0]));
+        if (is_obj) {
+            list->keys = talloc_memdup(list, &ctx->keys[base],
+                                       num * sizeof(list->keys[0]));
         }
-        MP_TARRAY_GROW(list, list->values, list->num);
-        if (json_parse(ta_parent, &list->values[list->num], src, max_depth) < 0)
-            return -1;
-        list->num++;
     }
+    list->num = num;
+    ctx->num = base;
     dst->format = is_obj ? MPV_FORMAT_NODE_MAP : MPV_FORMAT_NODE_ARRAY;
     dst->u.list = list;
     return 0;
+error:
+    ctx->num = base;
+    return -1;
 }
 
-/* Parse the string in *src as JSON, and write the result into *dst.
- * max_depth limits the recursion and JSON tree depth.
- * Warning: this overwrites the input string (what *src points to)!
- * Returns:
- *   0: success, *dst is valid, *src points to the end (the caller must check
- *      whether *src really terminates)
- *  -1: failure, *dst is invalid, there may be dead allocs under ta_parent
- *      (ta_free_children(ta_parent) is the only way to free them)
- * The input string can be mutated in both cases. *dst might contain string
- * elements, which point into the (mutated) input string.
- */
-int json_parse(void *ta_parent, struct mpv_node *dst, char **src, int max_depth)
+// Fast path for plain decimal numbers ("-123", "12.5"), which gives the same
+// results as the strtoll()/strtod() logic in parse_value(). Integers must fit
+// into int64_t without doubt; numbers with a fraction must have at most 15
+// significant digits, so they can be converted exactly as mantissa / 10^n.
+// Returns false if the slow path must be used.
+static bool read_simple_number(char **src, struct mpv_node *dst)
+{
+    static const double pow10[16] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12,
+        1e13, 1e14, 1e15,
+    };
+    char *cur = *src;
+    bool neg = eat_c(&cur, '-');
+    char *digits = cur;
+    uint64_t v = 0;
+    while (*cur >= '0' && *cur <= '9' && cur - digits < 18)
+        v = v * 10 + (*cur++ - '0');
+    int len = cur - digits;
+    // No digits; leading 0 (octal or hex for strtoll()); possibly too long.
+    if (len == 0 || (digits[0] == '0' && len > 1) || len >= 18)
+        return false;
+    int frac = 0;
+    if (*cur == '.') {
+        cur++;
+        while (*cur >= '0' && *cur <= '9' && len + frac < 16) {
+            v = v * 10 + (*cur++ - '0');
+            frac++;
+        }
+        if (!frac || len + frac > 15)
+            return false;
+    }
+    char c = *cur;
+    if ((c >= '0' && c <= '9') || c == '.' || c == 'e' || c == 'E' ||
+        c == 'x' || c == 'X')
+        return false;
+    if (frac) {
+        double d = v / pow10[frac];
+        dst->format = MPV_FORMAT_DOUBLE;
+        dst->u.double_ = neg ? -d : d;
+    } else {
+        dst->format = MPV_FORMAT_INT64;
+        dst->u.int64 = neg ? -(int64_t)v : (int64_t)v;
+    }
+    *src = cur;
+    return true;
+}
+
+static int parse_value(struct parse_ctx *ctx, struct mpv_node *dst, char **src,
+                       int max_depth)
 {
     max_depth -= 1;
     if (max_depth < 0)
         return -1;
 
-    eat_ws(src);
+    eat_ws_fast(ctx, src);
 
     char c = **src;
     if (!c)
@@ -183,10 +328,12 @@ int json_parse(void *ta_parent, struct mpv_node *dst, char **src, int max_depth)
         dst->u.flag = 0;
         return 0;
     } else if (c == '"') {
-        return read_str(ta_parent, dst, src);
+        return read_str(ctx, dst, src);
     } else if (c == '[' || c == '{') {
-        return read_sub(ta_parent, dst, src, max_depth);
+        return read_sub(ctx, dst, src, max_depth);
     } else if (c == '-' || (c >= '0' && c <= '9')) {
+        if (read_simple_number(src, dst))
+            return 0;
         // The number could be either a float or an int. JSON doesn't make a
         // difference, but the client API does.
         char *nsrci = *src, *nsrcf = *src;
@@ -215,71 +362,191 @@ int json_parse(void *ta_parent, struct mpv_node *dst, char **src, int max_depth)
     return -1; // character doesn't start a valid token
 }
 
+/* Parse the string in *src as JSON, and write the result into *dst.
+ * max_depth limits the recursion and JSON tree depth.
+ * Warning: this overwrites the input string (what *src points to)!
+ * Returns:
+ *   0: success, *dst is valid, *src points to the end (the caller must check
+ *      whether *src really terminates)
+ *  -1: failure, *dst is invalid, there may be dead allocs under ta_parent
+ *      (ta_free_children(ta_parent) is the only way to free them)
+ * The input string can be mutated in both cases. *dst might contain string
+ * elements, which point into the (mutated) input string.
+ */
+int json_parse(void *ta_parent, struct mpv_node *dst, char **src, int max_depth)
+{
+    struct mpv_node values[32];
+    char *keys[32];
+    struct parse_ctx ctx = {
+        .ta_parent = ta_parent,
+        .end = *src + strlen(*src),
+        .values = values,
+        .keys = keys,
+        .alloc = MP_ARRAY_SIZE(values),
+    };
+    int r = parse_value(&ctx, dst, src, max_depth);
+    talloc_free(ctx.tmp);
+    return r;
+}
+
+
+// Output buffer. Unlike bstr_xappend(), this keeps track of the allocated size
+// itself, and doesn't write a terminating \0 on every append.
+struct json_out {
+    char *buf;
+    size_t len, alloc;
+};
+
+static void out_grow(struct json_out *out, size_t len)
+{
+    size_t min = out->len + len + 1;
+    out->alloc = MPMAX(min, MPMAX(out->alloc * 2, 64));
+    out->buf = talloc_realloc_size(NULL, out->buf, out->alloc);
+}
+
+static inline void out_append(struct json_out *out, const void *data, size_t len)
+{
+    if (out->alloc - out->len <= len)
+        out_grow(out, len);
+    memcpy(out->buf + out->len, data, len);
+    out->len += len;
+}
 
-#define APPEND(b, s) bstr_xappend(NULL, (b), bstr0(s))
+#define APPEND_LIT(out, s) out_append(out, s, sizeof(s) - 1)
 
-static void write_json_str(bstr *b, unsigned char *str)
+static void write_json_str(struct json_out *out, const unsigned char *str)
 {
-    APPEND(b, "\"");
+    static const char hex[] = "0123456789abcdef";
+    const unsigned char *end = str + strlen(str);
+    APPEND_LIT(out, "\"");
     while (1) {
-        unsigned char *cur = str;
+        const unsigned char *cur = str;
+        while (end - cur >= 8) {
+            uint64_t w = load_word(cur);
+            if (WORD_HAS_LESS(w, 32) | WORD_HAS_BYTE(w, '"') |
+                WORD_HAS_BYTE(w, '\\'))
+                break;
+            cur += 8;
+        }
         while (cur[0] >= 32 && cur[0] != '"' && cur[0] != '\\')
             cur++;
         if (!cur[0])
             break;
-        bstr_xappend(NULL, b, (bstr){str, cur - str});
-        bstr_xappend_asprintf(NULL, b, "\\u%04x", (unsigned char)cur[0]);
+        out_append(out, str, cur - str);
+        char esc[6] = {'\\', 'u', '0', '0', hex[cur[0] >> 4], hex[cur[0] & 15]};
+        out_append(out, esc, sizeof(esc));
         str = cur + 1;
     }
-    APPEND(b, str);
-    APPEND(b, "\"");
+    out_append(out, str, end - str);
+    APPEND_LIT(out, "\"");
+}
+
+// Write the decimal digits of v backwards, ending at *end. Returns the start.
+static char *format_u64(char *end, uint64_t v)
+{
+    do {
+        *--end = '0' + v % 10;
+        v /= 10;
+    } while (v);
+    return end;
 }
 
-static void add_indent(bstr *b, int indent)
+static void write_int64(struct json_out *out, int64_t v)
+{
+    char buf[24];
+    char *end = buf + sizeof(buf);
+    uint64_t u = v < 0 ? -(uint64_t)v : v;
+    char *start = format_u64(end, u);
+    if (v < 0)
+        *--start = '-';
+    out_append(out, start, end - start);
+}
+
+// Same output as printf("%f", v).
+static void write_double(struct json_out *out, double v)
+{
+    double a = fabs(v);
+    // a * 1e6 is computed with an absolute error of at most 1/16 in this
+    // range, so rounding to the nearest integer gives the same result as
+    // printf, unless the value is close to a tie.
+    if (a < 1e9) {
+        double scaled = a * 1e6;
+        double ip = floor(scaled);
+        double frac = scaled - ip;
+        if (fabs(frac - 0.5) > 0.125) {
+            uint64_t r = (uint64_t)ip + (frac > 0.5);
+            char buf[32];
+            char *end = buf + sizeof(buf);
+            char *start = format_u64(end, r % 1000000);
+            while (end - start < 6)
+                *--start = '0';
+            *--start = '.';
+            start = format_u64(start, r / 1000000);
+            if (signbit(v))
+                *--start = '-';
+            out_append(out, start, end - start);
+            return;
+        }
+    }
+    char buf[400]; // enough for DBL_MAX
+    int len = snprintf(buf, sizeof(buf), "%f", v);
+    out_append(out, buf, MPCLAMP(len, 0, (int)sizeof(buf) - 1));
+}
+
+static void add_indent(struct json_out *out, int indent)
 {
     if (indent < 0)
         return;
-    bstr_xappend(NULL, b, bstr0("\n"));
-    for (int n = 0; n < indent; n++)
-        bstr_xappend(NULL, b, bstr0(" "));
+    APPEND_LIT(out, "\n");
+    static const char spaces[] = "                                ";
+    while (indent > 0) {
+        int n = MPMIN(indent, sizeof(spaces) - 1);
+        out_append(out, spaces, n);
+        indent -= n;
+    }
 }
 
-static int json_append(bstr *b, const struct mpv_node *src, int indent)
+static int json_append(struct json_out *out, const struct mpv_node *src,
+                       int indent)
 {
     switch (src->format) {
     case MPV_FORMAT_NONE:
-        APPEND(b, "null");
+        APPEND_LIT(out, "null");
         return 0;
     case MPV_FORMAT_FLAG:
-        APPEND(b, src->u.flag ? "true" : "false");
+        if (src->u.flag) {
+            APPEND_LIT(out, "true");
+        } else {
+            APPEND_LIT(out, "false");
+        }
         return 0;
     case MPV_FORMAT_INT64:
-        bstr_xappend_asprintf(NULL, b, "%"PRId64, src->u.int64);
+        write_int64(out, src->u.int64);
         return 0;
     case MPV_FORMAT_DOUBLE:
-        bstr_xappend_asprintf(NULL, b, "%f", src->u.double_);
+        write_double(out, src->u.double_);
         return 0;
     case MPV_FORMAT_STRING:
-        write_json_str(b, src->u.string);
+        write_json_str(out, src->u.string);
         return 0;
     case MPV_FORMAT_NODE_ARRAY:
     case MPV_FORMAT_NODE_MAP: {
         struct mpv_node_list *list = src->u.list;
         bool is_obj = src->format == MPV_FORMAT_NODE_MAP;
-        APPEND(b, is_obj ? "{" : "[");
+        out_append(out, is_obj ? "{" : "[", 1);
         int next_indent = indent >= 0 ? indent + 1 : -1;
         for (int n = 0; n < list->num; n++) {
             if (n)
-                APPEND(b, ",");
-            add_indent(b, next_indent);
+                APPEND_LIT(out, ",");
+            add_indent(out, next_indent);
             if (is_obj) {
-                write_json_str(b, list->keys[n]);
-                APPEND(b, ":");
+                write_json_str(out, list->keys[n]);
+                APPEND_LIT(out, ":");
             }
-            json_append(b, &list->values[n], next_indent);
+            json_append(out, &list->values[n], next_indent);
         }
-        add_indent(b, indent);
-        APPEND(b, is_obj ? "}" : "]");
+        add_indent(out, indent);
+        out_append(out, is_obj ? "}" : "]", 1);
         return 0;
     }
     }
@@ -288,9 +555,16 @@ static int json_append(bstr *b, const struct mpv_node *src, int indent)
 
 static int json_append_str(char **dst, struct mpv_node *src, int indent)
 {
-    bstr buffer = bstr0(*dst);
-    int r = json_append(&buffer, src, indent);
-    *dst = buffer.start;
+    struct json_out out = {
+        .buf = *dst,
+        .len = *dst ? strlen(*dst) : 0,
+        .alloc = *dst ? talloc_get_size(*dst) : 0,
+    };
+    int r = json_append(&out, src, indent);
+    if (out.alloc - out.len < 1)
+        out_grow(&out, 0);
+    out.buf[out.len] = '\0';
+    *dst = out.buf;
     return r;
 }
 
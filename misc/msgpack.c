@@ -0,0 +1,393 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* MessagePack parser and writer for mpv_node.
+ *
+ * Mapping between MessagePack and mpv_node types:
+ *
+ *  nil                 MPV_FORMAT_NONE
+ *  bool                MPV_FORMAT_FLAG
+ *  int, uint           MPV_FORMAT_INT64 (uint values > INT64_MAX become
+ *                      MPV_FORMAT_DOUBLE)
+ *  float32, float64    MPV_FORMAT_DOUBLE (always written as float64)
+ *  str                 MPV_FORMAT_STRING (cut at the first \0 byte)
+ *  bin                 MPV_FORMAT_BYTE_ARRAY
+ *  array               MPV_FORMAT_NODE_ARRAY
+ *  map                 MPV_FORMAT_NODE_MAP (keys must be str)
+ *
+ * The ext types are not supported, and are rejected by the parser. The writer
+ * always uses the shortest encoding.
+ *
+ * Also see: https://github.com/msgpack/msgpack/blob/master/spec.md
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "common/common.h"
+#include "misc/bstr.h"
+
+#include "msgpack.h"
+
+struct parse_ctx {
+    void *ta_parent;
+    // String data is copied to a single buffer allocated at the first string.
+    // A string of n bytes takes at least n + 1 bytes of input, which makes the
+    // remaining input size an upper bound for the size needed by all strings
+    // (including \0 termination).
+    char *strings;
+};
+
+static void skip(bstr *src, size_t len)
+{
+    src->start += len;
+    src->len -= len;
+}
+
+static bool read_uint(bstr *src, int size, uint64_t *out)
+{
+    if (src->len < size)
+        return false;
+    uint64_t v = 0;
+    for (int n = 0; n < size; n++)
+        v = (v << 8) | src->start[n];
+    skip(src, size);
+    *out = v;
+    return true;
+}
+
+static int parse_str(struct parse_ctx *ctx, struct mpv_node *dst, bstr *src,
+                     uint64_t len)
+{
+    if (len > src->len)
+        return -1;
+    if (!ctx->strings)
+        ctx->strings = talloc_size(ctx->ta_parent, src->len + 1);
+    char *str = ctx->strings;
+    memcpy(str, src->start, len);
+    str[len] = '\0';
+    ctx->strings += len + 1;
+    skip(src, len);
+    dst->format = MPV_FORMAT_STRING;
+    dst->u.string = str;
+    return 0;
+}
+
+static int parse_value(struct parse_ctx *ctx, struct mpv_node *dst, bstr *src,
+                       int max_depth);
+
+static int parse_list(struct parse_ctx *ctx, struct mpv_node *dst, bstr *src,
+                      uint64_t num, bool is_map, int max_depth)
+{
+    // Each element takes at least 1 byte (a map entry 2); reject bogus sizes
+    // early.
+    if (num > src->len / (is_map ? 2 : 1))
+        return -1;
+
+    struct mpv_node_list *list = talloc_zero(ctx->ta_parent,
+                                             struct mpv_node_list);
+    dst->format = is_map ? MPV_FORMAT_NODE_MAP : MPV_FORMAT_NODE_ARRAY;
+    dst->u.list = list;
+
+    // Grow the arrays while parsing, instead of trusting the size in the
+    // header: that would allow a small frame to make us allocate memory
+    // proportional to the remaining frame size for each nested list.
+    for (uint64_t n = 0; n < num; n++) {
+        MP_TARRAY_GROW(list, list->values, list->num);
+        if (is_map) {
+            MP_TARRAY_GROW(list, list->keys, list->num);
+            struct mpv_node key;
+            if (parse_value(ctx, &key, src, max_depth - 1) < 0)
+                return -1;
+            if (key.format != MPV_FORMAT_STRING)
+                return -1;
+            list->keys[list->num] = key.u.string;
+        }
+        if (parse_value(ctx, &list->values[list->num], src, max_depth - 1) < 0)
+            return -1;
+        list->num++;
+    }
+    return 0;
+}
+
+static int parse_value(struct parse_ctx *ctx, struct mpv_node *dst, bstr *src,
+                       int max_depth)
+{
+    if (max_depth < 0 || !src->len)
+        return -1;
+
+    unsigned char c = src->start[0];
+    skip(src, 1);
+
+    // Types with the value or size embedded into the type byte.
+    if (c <= 0x7f || c >= 0xe0) {
+        dst->format = MPV_FORMAT_INT64;
+        dst->u.int64 = (int8_t)c;
+        return 0;
+    }
+    if ((c & 0xf0) == 0x80)
+        return parse_list(ctx, dst, src, c & 0x0f, true, max_depth);
+    if ((c & 0xf0) == 0x90)
+        return parse_list(ctx, dst, src, c & 0x0f, false, max_depth);
+    if ((c & 0xe0) == 0xa0)
+        return parse_str(ctx, dst, src, c & 0x1f);
+
+    uint64_t v;
+    switch (c) {
+    case 0xc0:
+        dst->format = MPV_FORMAT_NONE;
+        return 0;
+    case 0xc2:
+    case 0xc3:
+        dst->format = MPV_FORMAT_FLAG;
+        dst->u.flag = c == 0xc3;
+        return 0;
+    case 0xc4: case 0xc5: case 0xc6: {
+        if (!read_uint(src, 1 << (c - 0xc4), &v) || v > src->len)
+            return -1;
+        struct mpv_byte_array *ba = talloc_zero(ctx->ta_parent,
+                                                struct mpv_byte_array);
+        ba->data = talloc_memdup(ba, src->start, v);
+        ba->size = v;
+        skip(src, v);
+        dst->format = MPV_FORMAT_BYTE_ARRAY;
+        dst->u.ba = ba;
+        return 0;
+    }
+    case 0xca: {
+        float f;
+        if (!read_uint(src, 4, &v))
+            return -1;
+        memcpy(&f, &(uint32_t){v}, sizeof(f));
+        dst->format = MPV_FORMAT_DOUBLE;
+        dst->u.double_ = f;
+        return 0;
+    }
+    case 0xcb:
+        if (!read_uint(src, 8, &v))
+            return -1;
+        dst->format = MPV_FORMAT_DOUBLE;
+        memcpy(&dst->u.double_, &v, sizeof(v));
+        return 0;
+    case 0xcc: case 0xcd: case 0xce: case 0xcf:
+        if (!read_uint(src, 1 << (c - 0xcc), &v))
+            return -1;
+        if (v > INT64_MAX) {
+            dst->format = MPV_FORMAT_DOUBLE;
+            dst->u.double_ = v;
+        } else {
+            dst->format = MPV_FORMAT_INT64;
+            dst->u.int64 = v;
+        }
+        return 0;
+    case 0xd0: case 0xd1: case 0xd2: case 0xd3: {
+        int size = 1 << (c - 0xd0);
+        if (!read_uint(src, size, &v))
+            return -1;
+        dst->format = MPV_FORMAT_INT64;
+        switch (size) {
+        case 1: dst->u.int64 = (int8_t)v; break;
+        case 2: dst->u.int64 = (int16_t)v; break;
+        case 4: dst->u.int64 = (int32_t)v; break;
+        default: dst->u.int64 = (int64_t)v; break;
+        }
+        return 0;
+    }
+    case 0xd9: case 0xda: case 0xdb:
+        if (!read_uint(src, 1 << (c - 0xd9), &v))
+            return -1;
+        return parse_str(ctx, dst, src, v);
+    case 0xdc: case 0xdd:
+        if (!read_uint(src, 2 << (c - 0xdc), &v))
+            return -1;
+        return parse_list(ctx, dst, src, v, false, max_depth);
+    case 0xde: case 0xdf:
+        if (!read_uint(src, 2 << (c - 0xde), &v))
+            return -1;
+        return parse_list(ctx, dst, src, v, true, max_depth);
+    }
+
+    return -1; // ext types, 0xc1
+}
+
+// Parse one MessagePack object from the start of *src, and advance *src past
+// it. Data allocated in dst is a talloc child of ta_parent. Returns <0 on
+// errors (*src is then in an undefined position).
+int msgpack_parse(void *ta_parent, struct mpv_node *dst, bstr *src,
+                  int max_depth)
+{
+    struct parse_ctx ctx = { .ta_parent = ta_parent };
+    return parse_value(&ctx, dst, src, max_depth);
+}
+
+// Output buffer; like bstr_xappend(), but without the overhead of looking up
+// the allocation size and writing a \0 on each append.
+struct write_ctx {
+    void *ta_parent;
+    bstr *dst;
+    size_t alloc;
+};
+
+static unsigned char *reserve(struct write_ctx *ctx, size_t len)
+{
+    bstr *dst = ctx->dst;
+    if (len > ctx->alloc - dst->len) {
+        size_t alloc = MPMAX(ctx->alloc * 2, dst->len + len + 64);
+        dst->start = talloc_realloc_size(ctx->ta_parent, dst->start, alloc);
+        ctx->alloc = alloc;
+    }
+    return dst->start + dst->len;
+}
+
+static void append(struct write_ctx *ctx, const void *data, size_t len)
+{
+    memcpy(reserve(ctx, len), data, len);
+    ctx->dst->len += len;
+}
+
+// Append the type byte c, followed by the lowest size bytes of v in big
+// endian byte order.
+static void write_head(struct write_ctx *ctx, int c, int size, uint64_t v)
+{
+    unsigned char *buf = reserve(ctx, 1 + size);
+    buf[0] = c;
+    for (int n = 0; n < size; n++)
+        buf[1 + n] = v >> (8 * (size - 1 - n));
+    ctx->dst->len += 1 + size;
+}
+
+// Write the type byte for a sized type. fix is the type with the size embedded
+// (if fix_max >= 0), t8 the type with an 8 bit size (if not 0), and t16 the
+// type with a 16 bit size. The 32 bit variant is always t16 + 1.
+static int write_size(struct write_ctx *ctx, uint64_t len, int fix, int fix_max,
+                      int t8, int t16)
+{
+    if (fix_max >= 0 && len <= fix_max) {
+        write_head(ctx, fix | len, 0, 0);
+    } else if (t8 && len <= UINT8_MAX) {
+        write_head(ctx, t8, 1, len);
+    } else if (len <= UINT16_MAX) {
+        write_head(ctx, t16, 2, len);
+    } else if (len <= UINT32_MAX) {
+        write_head(ctx, t16 + 1, 4, len);
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+static void write_int(struct write_ctx *ctx, int64_t v)
+{
+    if (v >= 0) {
+        if (v <= INT8_MAX) {
+            write_head(ctx, v, 0, 0);
+        } else if (v <= UINT8_MAX) {
+            write_head(ctx, 0xcc, 1, v);
+        } else if (v <= UINT16_MAX) {
+            write_head(ctx, 0xcd, 2, v);
+        } else if (v <= UINT32_MAX) {
+            write_head(ctx, 0xce, 4, v);
+        } else {
+            write_head(ctx, 0xcf, 8, v);
+        }
+    } else {
+        if (v >= -32) {
+            write_head(ctx, (uint8_t)v, 0, 0);
+        } else if (v >= INT8_MIN) {
+            write_head(ctx, 0xd0, 1, v);
+        } else if (v >= INT16_MIN) {
+            write_head(ctx, 0xd1, 2, v);
+        } else if (v >= INT32_MIN) {
+            write_head(ctx, 0xd2, 4, v);
+        } else {
+            write_head(ctx, 0xd3, 8, v);
+        }
+    }
+}
+
+static int write_str(struct write_ctx *ctx, const char *s)
+{
+    size_t len = strlen(s);
+    if (write_size(ctx, len, 0xa0, 31, 0xd9, 0xda) < 0)
+        return -1;
+    append(ctx, s, len);
+    return 0;
+}
+
+static int write_value(struct write_ctx *ctx, struct mpv_node *src)
+{
+    switch (src->format) {
+    case MPV_FORMAT_NONE:
+        write_head(ctx, 0xc0, 0, 0);
+        return 0;
+    case MPV_FORMAT_FLAG:
+        write_head(ctx, src->u.flag ? 0xc3 : 0xc2, 0, 0);
+        return 0;
+    case MPV_FORMAT_INT64:
+        write_int(ctx, src->u.int64);
+        return 0;
+    case MPV_FORMAT_DOUBLE: {
+        uint64_t v;
+        memcpy(&v, &src->u.double_, sizeof(v));
+        write_head(ctx, 0xcb, 8, v);
+        return 0;
+    }
+    case MPV_FORMAT_STRING:
+        return write_str(ctx, src->u.string);
+    case MPV_FORMAT_BYTE_ARRAY: {
+        struct mpv_byte_array *ba = src->u.ba;
+        if (write_size(ctx, ba->size, 0, -1, 0xc4, 0xc5) < 0)
+            return -1;
+        append(ctx, ba->data, ba->size);
+        return 0;
+    }
+    case MPV_FORMAT_NODE_ARRAY:
+    case MPV_FORMAT_NODE_MAP: {
+        struct mpv_node_list *list = src->u.list;
+        bool is_map = src->format == MPV_FORMAT_NODE_MAP;
+        int num = list ? list->num : 0;
+        int r = is_map ? write_size(ctx, num, 0x80, 15, 0, 0xde)
+                       : write_size(ctx, num, 0x90, 15, 0, 0xdc);
+        if (r < 0)
+            return -1;
+        for (int n = 0; n < num; n++) {
+            if (is_map && write_str(ctx, list->keys[n]) < 0)
+                return -1;
+            if (write_value(ctx, &list->values[n]) < 0)
+                return -1;
+        }
+        return 0;
+    }
+    }
+    return -1; // unknown format
+}
+
+// Append the MessagePack encoding of src to *dst. dst->start must be NULL or a
+// talloc allocation; if it's NULL, the new buffer is allocated under
+// ta_parent. Returns <0 on errors (*dst can contain partial output then).
+int msgpack_write(void *ta_parent, bstr *dst, struct mpv_node *src)
+{
+    struct write_ctx ctx = {
+        .ta_parent = ta_parent,
+        .dst = dst,
+        .alloc = dst->start ? talloc_get_size(dst->start) : 0,
+    };
+    int r = write_value(&ctx, src);
+    // Like bstr_xappend(), keep the data \0-terminated.
+    reserve(&ctx, 1)[0] = '\0';
+    return r;
+}
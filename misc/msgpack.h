@@ -0,0 +1,28 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MP_MSGPACK_H
+#define MP_MSGPACK_H
+
+#include "libmpv/client.h"
+#include "misc/bstr.h"
+
+int msgpack_parse(void *ta_parent, struct mpv_node *dst, bstr *src,
+                  int max_depth);
+int msgpack_write(void *ta_parent, bstr *dst, struct mpv_node *src);
+
+#endif
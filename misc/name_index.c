@@ -0,0 +1,105 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include <string.h>
+
+#include "mpv_talloc.h"
+#include "misc/name_index.h"
+
+struct entry {
+    bstr name;          // name.start==NULL for free entries
+    uint32_t hash;
+    int value;
+};
+
+struct mp_name_index {
+    struct entry *entries;
+    uint32_t size;      // always a power of 2
+    int count;
+};
+
+// FNV-1a
+uint32_t mp_name_index_hash(bstr name)
+{
+    uint32_t h = 2166136261u;
+    for (size_t n = 0; n < name.len; n++) {
+        h ^= (unsigned char)name.start[n];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+struct mp_name_index *mp_name_index_create(void *ta_parent)
+{
+    return talloc_zero(ta_parent, struct mp_name_index);
+}
+
+static struct entry *find_entry(struct mp_name_index *ni, bstr name,
+                                uint32_t hash)
+{
+    uint32_t mask = ni->size - 1;
+    for (uint32_t i = hash & mask; ; i = (i + 1) & mask) {
+        struct entry *e = &ni->entries[i];
+        if (!e->name.start)
+            return e;
+        if (e->hash == hash && bstr_equals(e->name, name))
+            return e;
+    }
+}
+
+static void resize(struct mp_name_index *ni, uint32_t new_size)
+{
+    struct entry *old = ni->entries;
+    uint32_t old_size = ni->size;
+
+    ni->entries = talloc_zero_array(ni, struct entry, new_size);
+    ni->size = new_size;
+    for (uint32_t n = 0; n < old_size; n++) {
+        if (old[n].name.start)
+            *find_entry(ni, old[n].name, old[n].hash) = old[n];
+    }
+    talloc_free(old);
+}
+
+bool mp_name_index_add(struct mp_name_index *ni, bstr name, int value)
+{
+    assert(name.start && value >= 0);
+    // Keep the load factor at or below 1/2.
+    if ((ni->count + 1) * 2 > ni->size)
+        resize(ni, ni->size ? ni->size * 2 : 16);
+    uint32_t hash = mp_name_index_hash(name);
+    struct entry *e = find_entry(ni, name, hash);
+    if (e->name.start)
+        return false;
+    *e = (struct entry){ .name = name, .hash = hash, .value = value };
+    ni->count++;
+    return true;
+}
+
+int mp_name_index_get(struct mp_name_index *ni, bstr name)
+{
+    if (!ni->count)
+        return -1;
+    struct entry *e = find_entry(ni, name, mp_name_index_hash(name));
+    return e->name.start ? e->value : -1;
+}
+
+int mp_name_index_count(struct mp_name_index *ni)
+{
+    return ni->count;
+}
@@ -0,0 +1,23 @@
+#ifndef MP_NAME_INDEX_H_
+#define MP_NAME_INDEX_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "misc/bstr.h"
+
+// Hash table mapping names to non-negative integers (usually indexes into
+// an array owned by the caller). Names are not copied, and must stay valid
+// as long as the index is used. Not thread-safe, but concurrent lookups are
+// fine if there are no concurrent additions.
+struct mp_name_index;
+
+struct mp_name_index *mp_name_index_create(void *ta_parent);
+// Returns false (and does nothing) if the name was already added.
+bool mp_name_index_add(struct mp_name_index *ni, bstr name, int value);
+// Returns -1 if not found.
+int mp_name_index_get(struct mp_name_index *ni, bstr name);
+int mp_name_index_count(struct mp_name_index *ni);
+uint32_t mp_name_index_hash(bstr name);
+
+#endif
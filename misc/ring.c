@@ -55,19 +55,34 @@ struct mp_ring *mp_ring_new(void *talloc_ctx, int size)
     return ringbuffer;
 }
 
-int mp_ring_read(struct mp_ring *buffer, unsigned char *dest, int len)
+static void get_span(struct mp_ring *buffer, unsigned long long pos, int len,
+                     struct mp_ring_span *span)
 {
-    int size     = mp_ring_size(buffer);
-    int buffered = mp_ring_buffered(buffer);
-    int read_len = FFMIN(len, buffered);
-    int read_ptr = mp_ring_get_rpos(buffer) % size;
+    int size = mp_ring_size(buffer);
+    int ptr  = pos % size;
+    int len1 = FFMIN(size - ptr, len);
 
-    int len1 = FFMIN(size - read_ptr, read_len);
-    int len2 = read_len - len1;
+    *span = (struct mp_ring_span) {
+        .data = { buffer->buffer + ptr, buffer->buffer },
+        .len  = { len1, len - len1 },
+    };
+}
+
+int mp_ring_peek(struct mp_ring *buffer, int len, struct mp_ring_span *span)
+{
+    int read_len = FFMIN(len, mp_ring_buffered(buffer));
+    get_span(buffer, mp_ring_get_rpos(buffer), read_len, span);
+    return read_len;
+}
+
+int mp_ring_read(struct mp_ring *buffer, unsigned char *dest, int len)
+{
+    struct mp_ring_span span;
+    int read_len = mp_ring_peek(buffer, len, &span);
 
     if (dest) {
-        memcpy(dest, buffer->buffer + read_ptr, len1);
-        memcpy(dest + len1, buffer->buffer, len2);
+        memcpy(dest, span.data[0], span.len[0]);
+        memcpy(dest + span.len[0], span.data[1], span.len[1]);
     }
 
     atomic_fetch_add(&buffer->rpos, read_len);
@@ -80,20 +95,28 @@ int mp_ring_drain(struct mp_ring *buffer, int len)
     return mp_ring_read(buffer, NULL, len);
 }
 
-int mp_ring_write(struct mp_ring *buffer, unsigned char *src, int len)
+int mp_ring_reserve(struct mp_ring *buffer, int len, struct mp_ring_span *span)
 {
-    int size      = mp_ring_size(buffer);
-    int free      = mp_ring_available(buffer);
-    int write_len = FFMIN(len, free);
-    int write_ptr = mp_ring_get_wpos(buffer) % size;
+    int write_len = FFMIN(len, mp_ring_available(buffer));
+    get_span(buffer, mp_ring_get_wpos(buffer), write_len, span);
+    return write_len;
+}
 
-    int len1 = FFMIN(size - write_ptr, write_len);
-    int len2 = write_len - len1;
+void mp_ring_commit(struct mp_ring *buffer, int len)
+{
+    assert(len <= mp_ring_available(buffer));
+    atomic_fetch_add(&buffer->wpos, len);
+}
+
+int mp_ring_write(struct mp_ring *buffer, unsigned char *src, int len)
+{
+    struct mp_ring_span span;
+    int write_len = mp_ring_reserve(buffer, len, &span);
 
-    memcpy(buffer->buffer + write_ptr, src, len1);
-    memcpy(buffer->buffer, src + len1, len2);
+    memcpy(span.data[0], src, span.len[0]);
+    memcpy(span.data[1], src + span.len[0], span.len[1]);
 
-    atomic_fetch_add(&buffer->wpos, write_len);
+    mp_ring_commit(buffer, write_len);
 
     return write_len;
 }
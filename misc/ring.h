@@ -27,6 +27,15 @@
 
 struct mp_ring;
 
+/**
+ * A region of the ringbuffer memory, split into up to 2 contiguous parts
+ * (the second part is used if the region wraps around the end of the buffer).
+ */
+struct mp_ring_span {
+    unsigned char *data[2];
+    int len[2];
+};
+
 /**
  * Instantiate a new ringbuffer
  *
@@ -65,6 +74,40 @@ int mp_ring_write(struct mp_ring *buffer, unsigned char *src, int len);
  */
 int mp_ring_drain(struct mp_ring *buffer, int len);
 
+/**
+ * Get direct access to the data that would be read by mp_ring_read(). The
+ * data is not removed from the ringbuffer; call mp_ring_drain() with the
+ * number of bytes actually consumed. Until then, the reader can also modify
+ * the returned memory in place. Must be called from the reader side only.
+ *
+ * buffer: target ringbuffer instance
+ * len:    maximum number of bytes to peek
+ * span:   set to the memory regions to read from
+ * return: number of bytes available in span (span->len[0] + span->len[1])
+ */
+int mp_ring_peek(struct mp_ring *buffer, int len, struct mp_ring_span *span);
+
+/**
+ * Get direct access to free space for writing. The data becomes visible to
+ * the reader only after mp_ring_commit(). Must be called from the writer side
+ * only.
+ *
+ * buffer: target ringbuffer instance
+ * len:    maximum number of bytes to reserve
+ * span:   set to the memory regions to write to
+ * return: number of bytes available in span (span->len[0] + span->len[1])
+ */
+int mp_ring_reserve(struct mp_ring *buffer, int len, struct mp_ring_span *span);
+
+/**
+ * Make data written to memory returned by mp_ring_reserve() readable.
+ *
+ * buffer: target ringbuffer instance
+ * len:    number of bytes written, at most the size returned by the
+ *         preceding mp_ring_reserve() call
+ */
+void mp_ring_commit(struct mp_ring *buffer, int len);
+
 /**
  * Reset the ringbuffer discarding any content
  *
@@ -14,53 +14,185 @@
  * You should have received a copy of the GNU Lesser General Public
  * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
  */
-
 #include <pthread.h>
 
+#include <libavutil/cpu.h>
+
 #include "common/common.h"
+#include "osdep/atomic.h"
+#include "osdep/threads.h"
 
 #include "thread_pool.h"
 
-struct work {
+/* Each worker thread has its own job queues, one per priority class. Jobs
+ * queued from outside of the pool are distributed over the workers round-robin,
+ * while jobs queued by a job running on a worker go to that worker's queues.
+ * A worker runs the oldest job of its own queues, and if there is none, steals
+ * the oldest job of another worker. Interactive jobs always come before
+ * background jobs, even if that means stealing.
+ *
+ * This keeps the workers mostly off a shared lock. The pool lock is only used
+ * for putting idle workers to sleep, waking them up, and job completion.
+ */
+
+enum {
+    PRIO_INTERACTIVE,
+    PRIO_BACKGROUND,
+    NUM_PRIOS
+};
+
+enum job_state {
+    JOB_QUEUED,     // in a worker queue
+    JOB_RUNNING,    // removed from the queue; running or about to run
+    JOB_DONE,       // finished (only set for jobs with handles)
+};
+
+struct mp_thread_pool_job {
+    struct mp_thread_pool *pool;
     void (*fn)(void *ctx);
     void *fn_ctx;
+    int prio;
+    bool detached;          // no handle; freed after running
+    struct worker *worker;  // whose queue the job was added to
+
+    // --- protected by worker->lock while JOB_QUEUED, by pool->lock after
+    enum job_state state;
+    struct mp_thread_pool_job *prev, *next;
+};
+
+struct job_list {
+    struct mp_thread_pool_job *head, *tail;
+};
+
+struct worker {
+    struct mp_thread_pool *pool;
+    int index;
+    pthread_t thread;
+
+    pthread_mutex_t lock;
+    // --- protected by lock
+    struct job_list queues[NUM_PRIOS];
 };
 
 struct mp_thread_pool {
-    pthread_t *threads;
-    int num_threads;
+    struct worker *workers;
+    int num_workers;
+    int num_threads;        // number of successfully started workers
+
+    // Number of jobs in all queues. Can briefly be off by the number of
+    // concurrent queue operations, but not in a way that loses wakeups.
+    atomic_int num_queued;
+    atomic_uint next_worker;
 
     pthread_mutex_t lock;
-    pthread_cond_t wakeup;
+    pthread_cond_t wakeup;  // for idle workers
+    pthread_cond_t done;    // for waiting on jobs
 
-    // --- the following fields are protected by lock
+    // --- protected by lock
     bool terminate;
-    struct work *work;
-    int num_work;
 };
 
-static void *worker_thread(void *arg)
+static void list_append(struct job_list *list, struct mp_thread_pool_job *job)
 {
-    struct mp_thread_pool *pool = arg;
+    job->prev = list->tail;
+    job->next = NULL;
+    if (list->tail) {
+        list->tail->next = job;
+    } else {
+        list->head = job;
+    }
+    list->tail = job;
+}
 
-    pthread_mutex_lock(&pool->lock);
-    while (1) {
-        while (!pool->num_work && !pool->terminate)
-            pthread_cond_wait(&pool->wakeup, &pool->lock);
+static void list_remove(struct job_list *list, struct mp_thread_pool_job *job)
+{
+    if (job->prev) {
+        job->prev->next = job->next;
+    } else {
+        list->head = job->next;
+    }
+    if (job->next) {
+        job->next->prev = job->prev;
+    } else {
+        list->tail = job->prev;
+    }
+    job->prev = job->next = NULL;
+}
 
-        if (!pool->num_work && pool->terminate)
-            break;
+// Remove the oldest job of the given priority from the worker's queue.
+static struct mp_thread_pool_job *take_from(struct worker *w, int prio)
+{
+    pthread_mutex_lock(&w->lock);
+    struct mp_thread_pool_job *job = w->queues[prio].head;
+    if (job) {
+        list_remove(&w->queues[prio], job);
+        job->state = JOB_RUNNING;
+    }
+    pthread_mutex_unlock(&w->lock);
+    if (job)
+        atomic_fetch_add(&w->pool->num_queued, -1);
+    return job;
+}
+
+static struct mp_thread_pool_job *find_job(struct worker *self)
+{
+    struct mp_thread_pool *pool = self->pool;
+    for (int prio = 0; prio < NUM_PRIOS; prio++) {
+        // Own queue first, then try to steal from the others.
+        for (int n = 0; n < pool->num_workers; n++) {
+            struct worker *w =
+                &pool->workers[(self->index + n) % pool->num_workers];
+            struct mp_thread_pool_job *job = take_from(w, prio);
+            if (job)
+                return job;
+        }
+    }
+    return NULL;
+}
+
+static void run_job(struct mp_thread_pool_job *job)
+{
+    struct mp_thread_pool *pool = job->pool;
 
-        assert(pool->num_work > 0);
-        struct work work = pool->work[pool->num_work - 1];
-        pool->num_work -= 1;
+    job->fn(job->fn_ctx);
 
+    if (job->detached) {
+        talloc_free(job);
+    } else {
+        pthread_mutex_lock(&pool->lock);
+        job->state = JOB_DONE;
+        pthread_cond_broadcast(&pool->done);
         pthread_mutex_unlock(&pool->lock);
-        work.fn(work.fn_ctx);
+    }
+}
+
+static void *worker_thread(void *arg)
+{
+    struct worker *w = arg;
+    struct mp_thread_pool *pool = w->pool;
+
+    mpthread_set_name("worker");
+
+    while (1) {
+        struct mp_thread_pool_job *job = find_job(w);
+        if (job) {
+            run_job(job);
+            continue;
+        }
+
         pthread_mutex_lock(&pool->lock);
+        bool exit = false;
+        if (atomic_load(&pool->num_queued) <= 0) {
+            if (pool->terminate) {
+                exit = true;
+            } else {
+                pthread_cond_wait(&pool->wakeup, &pool->lock);
+            }
+        }
+        pthread_mutex_unlock(&pool->lock);
+        if (exit)
+            break;
     }
-    assert(pool->num_work == 0);
-    pthread_mutex_unlock(&pool->lock);
 
     return NULL;
 }
@@ -75,9 +207,13 @@ static void thread_pool_dtor(void *ctx)
     pthread_mutex_unlock(&pool->lock);
 
     for (int n = 0; n < pool->num_threads; n++)
-        pthread_join(pool->threads[n], NULL);
+        pthread_join(pool->workers[n].thread, NULL);
+
+    assert(atomic_load(&pool->num_queued) == 0);
 
-    assert(pool->num_work == 0);
+    for (int n = 0; n < pool->num_workers; n++)
+        pthread_mutex_destroy(&pool->workers[n].lock);
+    pthread_cond_destroy(&pool->done);
     pthread_cond_destroy(&pool->wakeup);
     pthread_mutex_destroy(&pool->lock);
 }
@@ -96,19 +232,77 @@ struct mp_thread_pool *mp_thread_pool_create(void *ta_parent, int threads)
 
     pthread_mutex_init(&pool->lock, NULL);
     pthread_cond_init(&pool->wakeup, NULL);
+    pthread_cond_init(&pool->done, NULL);
+    atomic_store(&pool->num_queued, 0);
+    atomic_store(&pool->next_worker, 0);
+
+    // All workers must exist before the first thread starts stealing.
+    pool->workers = talloc_zero_array(pool, struct worker, threads);
+    pool->num_workers = threads;
+    for (int n = 0; n < threads; n++) {
+        struct worker *w = &pool->workers[n];
+        w->pool = pool;
+        w->index = n;
+        pthread_mutex_init(&w->lock, NULL);
+    }
 
     for (int n = 0; n < threads; n++) {
-        pthread_t thread;
-        if (pthread_create(&thread, NULL, worker_thread, pool)) {
+        struct worker *w = &pool->workers[n];
+        if (pthread_create(&w->thread, NULL, worker_thread, w)) {
             talloc_free(pool);
             return NULL;
         }
-        MP_TARRAY_APPEND(pool, pool->threads, pool->num_threads, thread);
+        pool->num_threads += 1;
     }
 
     return pool;
 }
 
+// Return the worker of this pool the calling thread is, or NULL.
+static struct worker *current_worker(struct mp_thread_pool *pool)
+{
+    for (int n = 0; n < pool->num_threads; n++) {
+        if (pthread_equal(pool->workers[n].thread, pthread_self()))
+            return &pool->workers[n];
+    }
+    return NULL;
+}
+
+static struct mp_thread_pool_job *queue_job(struct mp_thread_pool *pool,
+                                            int flags, void (*fn)(void *ctx),
+                                            void *fn_ctx, bool detached)
+{
+    struct worker *w = current_worker(pool);
+    if (!w) {
+        unsigned int n = atomic_fetch_add(&pool->next_worker, 1);
+        w = &pool->workers[n % pool->num_workers];
+    }
+
+    struct mp_thread_pool_job *job = talloc_ptrtype(NULL, job);
+    *job = (struct mp_thread_pool_job){
+        .pool = pool,
+        .fn = fn,
+        .fn_ctx = fn_ctx,
+        .prio = (flags & MP_THREAD_POOL_BACKGROUND) ? PRIO_BACKGROUND
+                                                    : PRIO_INTERACTIVE,
+        .detached = detached,
+        .worker = w,
+        .state = JOB_QUEUED,
+    };
+
+    pthread_mutex_lock(&w->lock);
+    list_append(&w->queues[job->prio], job);
+    pthread_mutex_unlock(&w->lock);
+
+    atomic_fetch_add(&pool->num_queued, 1);
+
+    pthread_mutex_lock(&pool->lock);
+    pthread_cond_signal(&pool->wakeup);
+    pthread_mutex_unlock(&pool->lock);
+
+    return job;
+}
+
 // Queue a function to be run on a worker thread: fn(fn_ctx)
 // If no worker thread is currently available, it's appended to a list in memory
 // with unbounded size. This function always returns immediately.
@@ -117,9 +311,105 @@ struct mp_thread_pool *mp_thread_pool_create(void *ta_parent, int threads)
 void mp_thread_pool_queue(struct mp_thread_pool *pool, void (*fn)(void *ctx),
                           void *fn_ctx)
 {
+    queue_job(pool, 0, fn, fn_ctx, true);
+}
+
+// Like mp_thread_pool_queue(), but return a handle to the job. flags is a set
+// of MP_THREAD_POOL_* flags. The caller must call exactly one of
+// mp_thread_pool_wait() or mp_thread_pool_cancel() on the handle (which frees
+// it), and must do so before the pool is destroyed.
+struct mp_thread_pool_job *mp_thread_pool_submit(struct mp_thread_pool *pool,
+                                                 int flags,
+                                                 void (*fn)(void *ctx),
+                                                 void *fn_ctx)
+{
+    return queue_job(pool, flags, fn, fn_ctx, false);
+}
+
+// If the job hasn't started yet, remove it from its queue and return true.
+static bool unqueue_job(struct mp_thread_pool_job *job)
+{
+    struct worker *w = job->worker;
+    pthread_mutex_lock(&w->lock);
+    bool queued = job->state == JOB_QUEUED;
+    if (queued) {
+        list_remove(&w->queues[job->prio], job);
+        job->state = JOB_RUNNING;
+    }
+    pthread_mutex_unlock(&w->lock);
+    if (queued)
+        atomic_fetch_add(&job->pool->num_queued, -1);
+    return queued;
+}
+
+static void wait_done(struct mp_thread_pool_job *job)
+{
+    struct mp_thread_pool *pool = job->pool;
     pthread_mutex_lock(&pool->lock);
-    struct work work = {fn, fn_ctx};
-    MP_TARRAY_INSERT_AT(pool, pool->work, pool->num_work, 0, work);
-    pthread_cond_signal(&pool->wakeup);
+    while (job->state != JOB_DONE)
+        pthread_cond_wait(&pool->done, &pool->lock);
     pthread_mutex_unlock(&pool->lock);
 }
+
+// Wait until the job has finished, and free the handle. If the job hasn't been
+// started yet, it's run on the calling thread instead. (This also means waiting
+// on a job from within another job of the same pool can't deadlock.)
+void mp_thread_pool_wait(struct mp_thread_pool_job *job)
+{
+    if (unqueue_job(job)) {
+        job->fn(job->fn_ctx);
+    } else {
+        wait_done(job);
+    }
+    talloc_free(job);
+}
+
+// Remove the job from the pool if it hasn't been started yet, and return true.
+// Otherwise wait until it has finished, and return false. Frees the handle.
+bool mp_thread_pool_cancel(struct mp_thread_pool_job *job)
+{
+    bool cancelled = unqueue_job(job);
+    if (!cancelled)
+        wait_done(job);
+    talloc_free(job);
+    return cancelled;
+}
+
+static pthread_mutex_t shared_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct mp_thread_pool *shared_pool;
+static int shared_refs;
+
+// Return the process-wide thread pool, which has a worker per CPU core. It's
+// created on first use. Every reference must be released with
+// mp_thread_pool_shared_unref(). Returns NULL if the pool could not be created.
+// Note that a long-blocking job (e.g. network I/O) occupies a worker all the
+// time, so don't flood the pool with them.
+struct mp_thread_pool *mp_thread_pool_shared_ref(void)
+{
+    pthread_mutex_lock(&shared_lock);
+    if (!shared_pool)
+        shared_pool = mp_thread_pool_create(NULL, MPCLAMP(av_cpu_count(), 2, 16));
+    if (shared_pool)
+        shared_refs += 1;
+    struct mp_thread_pool *pool = shared_pool;
+    pthread_mutex_unlock(&shared_lock);
+    return pool;
+}
+
+// Release a reference returned by mp_thread_pool_shared_ref(). Destroying the
+// pool on the last reference blocks until all of its jobs are done. pool can
+// be NULL.
+void mp_thread_pool_shared_unref(struct mp_thread_pool *pool)
+{
+    if (!pool)
+        return;
+    pthread_mutex_lock(&shared_lock);
+    assert(pool == shared_pool && shared_refs > 0);
+    shared_refs -= 1;
+    if (shared_refs)
+        pool = NULL;
+    if (pool)
+        shared_pool = NULL;
+    pthread_mutex_unlock(&shared_lock);
+    talloc_free(pool);
+}
@@ -1,10 +1,29 @@
 #ifndef MPV_MP_THREAD_POOL_H
 #define MPV_MP_THREAD_POOL_H
 
+#include <stdbool.h>
+
 struct mp_thread_pool;
+struct mp_thread_pool_job;
+
+// Flags for mp_thread_pool_submit().
+enum {
+    // Run the job only when no interactive (i.e. normal) jobs are queued.
+    MP_THREAD_POOL_BACKGROUND = 1 << 0,
+};
 
 struct mp_thread_pool *mp_thread_pool_create(void *ta_parent, int threads);
 void mp_thread_pool_queue(struct mp_thread_pool *pool, void (*fn)(void *ctx),
                           void *fn_ctx);
 
+struct mp_thread_pool_job *mp_thread_pool_submit(struct mp_thread_pool *pool,
+                                                 int flags,
+                                                 void (*fn)(void *ctx),
+                                                 void *fn_ctx);
+void mp_thread_pool_wait(struct mp_thread_pool_job *job);
+bool mp_thread_pool_cancel(struct mp_thread_pool_job *job);
+
+struct mp_thread_pool *mp_thread_pool_shared_ref(void);
+void mp_thread_pool_shared_unref(struct mp_thread_pool *pool);
+
 #endif
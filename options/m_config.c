@@ -40,6 +40,7 @@
 #include "common/msg.h"
 #include "common/msg_control.h"
 #include "misc/dispatch.h"
+#include "misc/name_index.h"
 #include "misc/node.h"
 #include "osdep/atomic.h"
 
@@ -58,6 +59,10 @@ struct m_config_shadow {
     pthread_mutex_t lock;
     struct m_config *root;
     char *data;
+    // Incremented on every write access. opts_ts[n] is the value of ts when
+    // root->opts[n] was last written.
+    long long ts;
+    long long *opts_ts;
     struct m_config_cache **listeners;
     int num_listeners;
 };
@@ -66,10 +71,18 @@ struct m_config_shadow {
 struct m_config_group {
     const struct m_sub_options *group; // or NULL for top-level options
     int parent_group;   // index of parent group in m_config.groups
+    int parent_ptr;     // offset of the pointer to opts in the parent's opts
+                        // (or -1 if there is none)
     void *opts;         // pointer to group user option struct
     atomic_llong ts;    // incremented on every write access
 };
 
+// An option mirrored by m_config_cache.
+struct m_config_cache_opt {
+    int index;          // into m_config_shadow.root->opts
+    void *data;         // into m_config_cache.opts
+};
+
 struct m_profile {
     struct m_profile *next;
     char *name;
@@ -174,6 +187,7 @@ struct m_config *m_config_new(void *talloc_ctx, struct mp_log *log,
     talloc_set_destructor(config, config_destroy);
     *config = (struct m_config)
         {.log = log, .size = size, .defaults = defaults, .options = options};
+    config->opt_index = mp_name_index_create(config);
 
     // size==0 means a dummy object is created
     if (size) {
@@ -186,6 +200,7 @@ struct m_config *m_config_new(void *talloc_ctx, struct mp_log *log,
     MP_TARRAY_GROW(config, config->groups, 1);
     config->groups[0] = (struct m_config_group){
         .parent_group = -1,
+        .parent_ptr = -1,
         .opts = config->optstruct,
     };
 
@@ -375,6 +390,7 @@ static void add_sub_options(struct m_config *config,
     config->groups[group] = (struct m_config_group){
         .group = subopts,
         .parent_group = parent ? parent->group : 0,
+        .parent_ptr = parent && parent->opt ? parent->opt->offset : -1,
         .opts = new_optstruct,
     };
 
@@ -527,6 +543,10 @@ static void m_config_add_option(struct m_config *config,
             init_opt_inplace(arg, co.data, co.default_data);
 
         MP_TARRAY_APPEND(config, config->opts, config->num_opts, co);
+        // Duplicate names are possible; keep the first option, like a linear
+        // search would.
+        mp_name_index_add(config->opt_index, bstr0(co.name),
+                          config->num_opts - 1);
 
         if (arg->type == &m_option_type_obj_settings_list)
             init_obj_settings_list(config, (const struct m_obj_list *)arg->priv);
@@ -539,14 +559,8 @@ struct m_config_option *m_config_get_co_raw(const struct m_config *config,
     if (!name.len)
         return NULL;
 
-    for (int n = 0; n < config->num_opts; n++) {
-        struct m_config_option *co = &config->opts[n];
-        struct bstr coname = bstr0(co->name);
-        if (bstrcmp(coname, name) == 0)
-            return co;
-    }
-
-    return NULL;
+    int index = mp_name_index_get(config->opt_index, name);
+    return index >= 0 ? &config->opts[index] : NULL;
 }
 
 // Like m_config_get_co_raw(), but resolve aliases.
@@ -831,13 +845,15 @@ static struct m_config_option *m_config_mogrify_cli_opt(struct m_config *config,
     if (co && co->opt->type == &m_option_type_cli_alias)
         *name = bstr0((char *)co->opt->priv);
 
-    // Might be a suffix "action", like "--vf-add". Expensively check for
-    // matches. (We don't allow you to combine them with "--no-".)
-    for (int n = 0; n < config->num_opts; n++) {
-        co = &config->opts[n];
-        struct bstr basename = bstr0(co->name);
-
-        if (!bstr_startswith(*name, basename))
+    // Might be a suffix "action", like "--vf-add". Try all prefixes ending
+    // before a "-" as option name. (We don't allow you to combine them with
+    // "--no-".)
+    for (int len = name->len - 1; len > 0; len--) {
+        if (name->start[len] != '-')
+            continue;
+        struct bstr basename = bstr_splice(*name, 0, len);
+        co = m_config_get_co_raw(config, basename);
+        if (!co)
             continue;
 
         // Aliased option + a suffix action, e.g. --opengl-shaders-append
@@ -1184,6 +1200,8 @@ void m_config_create_shadow(struct m_config *config)
 
     config->shadow = talloc_zero(config, struct m_config_shadow);
     config->shadow->data = talloc_zero_size(config->shadow, config->shadow_size);
+    config->shadow->opts_ts =
+        talloc_zero_array(config->shadow, long long, config->num_opts);
 
     config->shadow->root = config;
     pthread_mutex_init(&config->shadow->lock, NULL);
@@ -1219,6 +1237,28 @@ static void cache_destroy(void *p)
     // breaking is a feature provided by these functions)
     m_config_cache_set_wakeup_cb(cache, NULL, NULL);
     m_config_cache_set_dispatch_change_cb(cache, NULL, NULL, NULL);
+
+    struct m_config *root = cache->shadow->root;
+    for (int n = 0; n < cache->num_cache_opts; n++) {
+        struct m_config_cache_opt *c = &cache->cache_opts[n];
+        m_option_free(root->opts[c->index].opt, c->data);
+    }
+}
+
+// Copy all options that were changed since the last copy from the shadow.
+// Must be called with shadow->lock held.
+static void cache_copy_changed(struct m_config_cache *cache)
+{
+    struct m_config_shadow *shadow = cache->shadow;
+    struct m_config *root = shadow->root;
+
+    for (int n = 0; n < cache->num_cache_opts; n++) {
+        struct m_config_cache_opt *c = &cache->cache_opts[n];
+        struct m_config_option *co = &root->opts[c->index];
+        if (shadow->opts_ts[c->index] > cache->opts_ts)
+            m_option_copy(co->opt, c->data, shadow->data + co->shadow_offset);
+    }
+    cache->opts_ts = shadow->ts;
 }
 
 struct m_config_cache *m_config_cache_alloc(void *ta_parent,
@@ -1231,52 +1271,61 @@ struct m_config_cache *m_config_cache_alloc(void *ta_parent,
     struct m_config_cache *cache = talloc_zero(ta_parent, struct m_config_cache);
     talloc_set_destructor(cache, cache_destroy);
     cache->shadow = shadow;
-    cache->shadow_config = m_config_new(cache, mp_null_log, root->size,
-                                        root->defaults, root->options);
-
-    struct m_config *config = cache->shadow_config;
-
-    assert(config->num_opts == root->num_opts);
-    for (int n = 0; n < root->num_opts; n++) {
-        assert(config->opts[n].opt->type == root->opts[n].opt->type);
-        assert(config->opts[n].shadow_offset == root->opts[n].shadow_offset);
-    }
-
-    cache->ts = -1;
     cache->group = -1;
 
-    for (int n = 0; n < config->num_groups; n++) {
-        if (config->groups[n].group == group) {
-            cache->opts = config->groups[n].opts;
+    for (int n = 0; n < root->num_groups; n++) {
+        if (root->groups[n].group == group) {
             cache->group = n;
             break;
         }
     }
 
     assert(cache->group >= 0);
-    assert(cache->opts);
 
-    // If we're not on the top-level, restrict set of options to the sub-group
-    // to reduce update costs. (It would be better not to add them in the first
-    // place.)
-    if (cache->group > 0) {
-        int num_opts = config->num_opts;
-        config->num_opts = 0;
-        for (int n = 0; n < num_opts; n++) {
-            struct m_config_option *co = &config->opts[n];
-            if (is_group_included(config, co->group, cache->group)) {
-                config->opts[config->num_opts++] = *co;
-            } else {
-                m_option_free(co->opt, co->data);
-            }
-        }
-        for (int n = 0; n < config->num_groups; n++) {
-            if (!is_group_included(config, n, cache->group))
-                TA_FREEP(&config->groups[n].opts);
+    // Allocate the option structs of the group and its sub-groups. Parents
+    // always come before their sub-groups in root->groups.
+    void **group_opts = talloc_zero_array(NULL, void *, root->num_groups);
+    for (int n = cache->group; n < root->num_groups; n++) {
+        struct m_config_group *g = &root->groups[n];
+        if (!is_group_included(root, n, cache->group))
+            continue;
+
+        size_t size = g->group ? g->group->size : root->size;
+        const void *defaults = g->group ? g->group->defaults : root->defaults;
+        group_opts[n] = talloc_zero_size(cache, size);
+        if (defaults)
+            memcpy(group_opts[n], defaults, size);
+
+        if (n != cache->group && g->parent_ptr >= 0) {
+            char *parent = group_opts[g->parent_group];
+            substruct_write_ptr(parent + g->parent_ptr, group_opts[n]);
         }
     }
+    cache->opts = group_opts[cache->group];
+    assert(cache->opts);
 
-    m_config_cache_update(cache);
+    for (int n = 0; n < root->num_opts; n++) {
+        struct m_config_option *co = &root->opts[n];
+        if (co->shadow_offset < 0 || co->opt->offset < 0 ||
+            !is_group_included(root, co->group, cache->group))
+            continue;
+
+        void *data = (char *)group_opts[co->group] + co->opt->offset;
+        // Overwrite whatever the defaults memcpy() above put there, so that
+        // m_option_copy() doesn't try to free it.
+        memset(data, 0, co->opt->type->size);
+
+        struct m_config_cache_opt c = { .index = n, .data = data };
+        MP_TARRAY_APPEND(cache, cache->cache_opts, cache->num_cache_opts, c);
+    }
+
+    talloc_free(group_opts);
+
+    pthread_mutex_lock(&shadow->lock);
+    cache->ts = atomic_load(&root->groups[cache->group].ts);
+    cache->opts_ts = -1;
+    cache_copy_changed(cache);
+    pthread_mutex_unlock(&shadow->lock);
 
     return cache;
 }
@@ -1292,11 +1341,7 @@ bool m_config_cache_update(struct m_config_cache *cache)
 
     pthread_mutex_lock(&shadow->lock);
     cache->ts = atomic_load(&shadow->root->groups[cache->group].ts);
-    for (int n = 0; n < cache->shadow_config->num_opts; n++) {
-        struct m_config_option *co = &cache->shadow_config->opts[n];
-        if (co->shadow_offset >= 0)
-            m_option_copy(co->opt, co->data, shadow->data + co->shadow_offset);
-    }
+    cache_copy_changed(cache);
     pthread_mutex_unlock(&shadow->lock);
     return true;
 }
@@ -1308,8 +1353,10 @@ void m_config_notify_change_co(struct m_config *config,
 
     if (shadow) {
         pthread_mutex_lock(&shadow->lock);
-        if (co->shadow_offset >= 0)
+        if (co->shadow_offset >= 0) {
             m_option_copy(co->opt, shadow->data + co->shadow_offset, co->data);
+            shadow->opts_ts[co - config->opts] = ++shadow->ts;
+        }
         pthread_mutex_unlock(&shadow->lock);
     }
 
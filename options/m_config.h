@@ -60,6 +60,8 @@ typedef struct m_config {
     // Registered options.
     struct m_config_option *opts; // all options, even suboptions
     int num_opts;
+    // Maps option names to indexes into opts[].
+    struct mp_name_index *opt_index;
 
     // Creation parameters
     size_t size;
@@ -272,8 +274,10 @@ struct m_config_cache {
 
     // Internal.
     struct m_config_shadow *shadow;
-    struct m_config *shadow_config;
-    long long ts;
+    struct m_config_cache_opt *cache_opts;
+    int num_cache_opts;
+    long long ts;       // m_config_group.ts of the group
+    long long opts_ts;  // m_config_shadow.ts at the time of the last copy
     int group;
     bool in_list;
     // --- Implicitly synchronized by setting/unsetting wakeup_cb.
@@ -35,60 +35,88 @@
 #include "m_property.h"
 #include "common/msg.h"
 #include "common/common.h"
+#include "misc/name_index.h"
 
-struct m_property *m_property_list_find(const struct m_property *list,
-                                        const char *name)
+struct m_property_table {
+    struct m_property *props;   // terminated with a {0} item
+    int num_props;
+    struct mp_name_index *index;
+};
+
+struct m_property_table *m_property_table_create(void *ta_parent)
 {
-    for (int n = 0; list && list[n].name; n++) {
-        if (strcmp(list[n].name, name) == 0)
-            return (struct m_property *)&list[n];
-    }
-    return NULL;
+    struct m_property_table *t = talloc_zero(ta_parent, struct m_property_table);
+    t->index = mp_name_index_create(t);
+    t->props = talloc_zero_array(t, struct m_property, 1);
+    return t;
+}
+
+bool m_property_table_add(struct m_property_table *t, struct m_property prop)
+{
+    assert(prop.name && prop.call);
+    if (!mp_name_index_add(t->index, bstr0(prop.name), t->num_props))
+        return false;
+    MP_TARRAY_GROW(t, t->props, t->num_props + 1);
+    t->props[t->num_props++] = prop;
+    t->props[t->num_props] = (struct m_property){0};
+    return true;
+}
+
+const struct m_property *m_property_table_list(struct m_property_table *t)
+{
+    return t->props;
 }
 
-static int do_action(const struct m_property *prop_list, const char *name,
+int m_property_table_find_id(struct m_property_table *t, bstr name)
+{
+    return mp_name_index_get(t->index, name);
+}
+
+struct m_property *m_property_table_get(struct m_property_table *t, int id)
+{
+    return id >= 0 && id < t->num_props ? &t->props[id] : NULL;
+}
+
+struct m_property *m_property_table_find(struct m_property_table *t,
+                                         const char *name)
+{
+    return m_property_table_get(t, m_property_table_find_id(t, bstr0(name)));
+}
+
+// Invoke the property, using a sub-property key if key!=NULL.
+static int do_action(struct m_property *prop, const char *key,
                      int action, void *arg, void *ctx)
 {
-    struct m_property *prop;
-    struct m_property_action_arg ka;
-    const char *sep = strchr(name, '/');
-    if (sep && sep[1]) {
-        char base[128];
-        snprintf(base, sizeof(base), "%.*s", (int)(sep - name), name);
-        prop = m_property_list_find(prop_list, base);
-        ka = (struct m_property_action_arg) {
-            .key = sep + 1,
+    if (key) {
+        struct m_property_action_arg ka = {
+            .key = key,
             .action = action,
             .arg = arg,
         };
-        action = M_PROPERTY_KEY_ACTION;
-        arg = &ka;
-    } else
-        prop = m_property_list_find(prop_list, name);
-    if (!prop)
-        return M_PROPERTY_UNKNOWN;
+        return prop->call(ctx, prop, M_PROPERTY_KEY_ACTION, &ka);
+    }
     return prop->call(ctx, prop, action, arg);
 }
 
-// (as a hack, log can be NULL on read-only paths)
-int m_property_do(struct mp_log *log, const struct m_property *prop_list,
-                  const char *name, int action, void *arg, void *ctx)
+static int property_do(struct mp_log *log, struct m_property *prop,
+                       const char *key, const char *name, int action,
+                       void *arg, void *ctx)
 {
     union m_option_value val = {0};
     int r;
 
     struct m_option opt = {0};
-    r = do_action(prop_list, name, M_PROPERTY_GET_TYPE, &opt, ctx);
+    r = do_action(prop, key, M_PROPERTY_GET_TYPE, &opt, ctx);
     if (r <= 0)
         return r;
     assert(opt.type);
 
     switch (action) {
     case M_PROPERTY_PRINT: {
-        if ((r = do_action(prop_list, name, M_PROPERTY_PRINT, arg, ctx)) >= 0)
+        if ((r = do_action(prop, key, M_PROPERTY_PRINT, arg, ctx)) >= 0)
             return r;
         // Fallback to m_option
-        if ((r = do_action(prop_list, name, M_PROPERTY_GET, &val, ctx)) <= 0)
+        if ((r = do_action(prop, key, M_PROPERTY_GET, &val, ctx)) <= 0)
             return r;
         char *str = m_option_pretty_print(&opt, &val);
         m_option_free(&opt, &val);
@@ -96,7 +124,7 @@ int m_property_do(struct mp_log *log, const struct m_property *prop_list,
         return str != NULL;
     }
     case M_PROPERTY_GET_STRING: {
-        if ((r = do_action(prop_list, name, M_PROPERTY_GET, &val, ctx)) <= 0)
+        if ((r = do_action(prop, key, M_PROPERTY_GET, &val, ctx)) <= 0)
             return r;
         char *str = m_option_print(&opt, &val);
         m_option_free(&opt, &val);
@@ -105,45 +133,45 @@ int m_property_do(struct mp_log *log, const struct m_property *prop_list,
     }
     case M_PROPERTY_SET_STRING: {
         struct mpv_node node = { .format = MPV_FORMAT_STRING, .u.string = arg };
-        return m_property_do(log, prop_list, name, M_PROPERTY_SET_NODE, &node, ctx);
+        return property_do(log, prop, key, name, M_PROPERTY_SET_NODE, &node, ctx);
     }
     case M_PROPERTY_SWITCH: {
         if (!log)
             return M_PROPERTY_ERROR;
         struct m_property_switch_arg *sarg = arg;
-        if ((r = do_action(prop_list, name, M_PROPERTY_SWITCH, arg, ctx)) !=
+        if ((r = do_action(prop, key, M_PROPERTY_SWITCH, arg, ctx)) !=
             M_PROPERTY_NOT_IMPLEMENTED)
             return r;
         // Fallback to m_option
-        r = m_property_do(log, prop_list, name, M_PROPERTY_GET_CONSTRICTED_TYPE,
+        r = property_do(log, prop, key, name, M_PROPERTY_GET_CONSTRICTED_TYPE,
                           &opt, ctx);
         if (r <= 0)
             return r;
         assert(opt.type);
         if (!opt.type->add)
             return M_PROPERTY_NOT_IMPLEMENTED;
-        if ((r = do_action(prop_list, name, M_PROPERTY_GET, &val, ctx)) <= 0)
+        if ((r = do_action(prop, key, M_PROPERTY_GET, &val, ctx)) <= 0)
             return r;
         opt.type->add(&opt, &val, sarg->inc, sarg->wrap);
-        r = do_action(prop_list, name, M_PROPERTY_SET, &val, ctx);
+        r = do_action(prop, key, M_PROPERTY_SET, &val, ctx);
         m_option_free(&opt, &val);
         return r;
     }
     case M_PROPERTY_GET_CONSTRICTED_TYPE: {
-        if ((r = do_action(prop_list, name, action, arg, ctx)) >= 0)
+        if ((r = do_action(prop, key, action, arg, ctx)) >= 0)
             return r;
-        if ((r = do_action(prop_list, name, M_PROPERTY_GET_TYPE, arg, ctx)) >= 0)
+        if ((r = do_action(prop, key, M_PROPERTY_GET_TYPE, arg, ctx)) >= 0)
             return r;
         return M_PROPERTY_NOT_IMPLEMENTED;
     }
     case M_PROPERTY_SET: {
-        return do_action(prop_list, name, M_PROPERTY_SET, arg, ctx);
+        return do_action(prop, key, M_PROPERTY_SET, arg, ctx);
     }
     case M_PROPERTY_GET_NODE: {
-        if ((r = do_action(prop_list, name, M_PROPERTY_GET_NODE, arg, ctx)) !=
+        if ((r = do_action(prop, key, M_PROPERTY_GET_NODE, arg, ctx)) !=
             M_PROPERTY_NOT_IMPLEMENTED)
             return r;
-        if ((r = do_action(prop_list, name, M_PROPERTY_GET, &val, ctx)) <= 0)
+        if ((r = do_action(prop, key, M_PROPERTY_GET, &val, ctx)) <= 0)
             return r;
         struct mpv_node *node = arg;
         int err = m_option_get_node(&opt, NULL, node, &val);
@@ -160,7 +188,7 @@ int m_property_do(struct mp_log *log, const struct m_property *prop_list,
     case M_PROPERTY_SET_NODE: {
         if (!log)
             return M_PROPERTY_ERROR;
-        if ((r = do_action(prop_list, name, M_PROPERTY_SET_NODE, arg, ctx)) !=
+        if ((r = do_action(prop, key, M_PROPERTY_SET_NODE, arg, ctx)) !=
             M_PROPERTY_NOT_IMPLEMENTED)
             return r;
         int err = m_option_set_node_or_string(log, &opt, name, &val, arg);
@@ -169,14 +197,31 @@ int m_property_do(struct mp_log *log, const struct m_property *prop_list,
         } else if (err < 0) {
             r = M_PROPERTY_INVALID_FORMAT;
         } else {
-            r = do_action(prop_list, name, M_PROPERTY_SET, &val, ctx);
+            r = do_action(prop, key, M_PROPERTY_SET, &val, ctx);
         }
         m_option_free(&opt, &val);
         return r;
     }
     default:
-        return do_action(prop_list, name, action, arg, ctx);
+        return do_action(prop, key, action, arg, ctx);
+    }
+}
+
+// (as a hack, log can be NULL on read-only paths)
+int m_property_do(struct mp_log *log, struct m_property_table *props,
+                  const char *name, int action, void *arg, void *ctx)
+{
+    bstr base = bstr0(name);
+    const char *key = NULL;
+    const char *sep = strchr(name, '/');
+    if (sep && sep[1]) {
+        base = bstr_splice(base, 0, sep - name);
+        key = sep + 1;
     }
+    int id = m_property_table_find_id(props, base);
+    if (id < 0)
+        return M_PROPERTY_UNKNOWN;
+    return property_do(log, &props->props[id], key, name, action, arg, ctx);
 }
 
 bool m_property_split_path(const char *path, bstr *prefix, char **rem)
@@ -206,14 +251,14 @@ static void m_property_unkey(int *action, void **arg)
     }
 }
 
-static int m_property_do_bstr(const struct m_property *prop_list, bstr name,
+static int m_property_do_bstr(struct m_property_table *props, bstr name,
                               int action, void *arg, void *ctx)
 {
     char name0[64];
     if (name.len >= sizeof(name0))
         return M_PROPERTY_UNKNOWN;
     snprintf(name0, sizeof(name0), "%.*s", BSTR_P(name));
-    return m_property_do(NULL, prop_list, name0, action, arg, ctx);
+    return m_property_do(NULL, props, name0, action, arg, ctx);
 }
 
 static void append_str(char **s, int *len, bstr append)
@@ -224,7 +269,7 @@ static void append_str(char **s, int *len, bstr append)
     *len = *len + append.len;
 }
 
-static int expand_property(const struct m_property *prop_list, char **ret,
+static int expand_property(struct m_property_table *props, char **ret,
                            int *ret_len, bstr prop, bool silent_error, void *ctx)
 {
     bool cond_yes = bstr_eatstart0(&prop, "?");
@@ -238,7 +283,7 @@ static int expand_property(const struct m_property *prop_list, char **ret,
     int method = raw ? M_PROPERTY_GET_STRING : M_PROPERTY_PRINT;
 
     char *s = NULL;
-    int r = m_property_do_bstr(prop_list, prop, method, &s, ctx);
+    int r = m_property_do_bstr(props, prop, method, &s, ctx);
     bool skip;
     if (comp) {
         skip = ((s && bstr_equals0(comp_with, s)) != cond_yes);
@@ -255,7 +300,7 @@ static int expand_property(const struct m_property *prop_list, char **ret,
     return skip;
 }
 
-char *m_properties_expand_string(const struct m_property *prop_list,
+char *m_properties_expand_string(struct m_property_table *props,
                                  const char *str0, void *ctx)
 {
     char *ret = NULL;
@@ -281,7 +326,7 @@ char *m_properties_expand_string(const struct m_property *prop_list,
             bool have_fallback = bstr_eatstart0(&str, ":");
 
             if (!skip) {
-                skip = expand_property(prop_list, &ret, &ret_len, name,
+                skip = expand_property(props, &ret, &ret_len, name,
                                        have_fallback, ctx);
                 if (skip)
                     skip_level = level;
@@ -434,7 +479,8 @@ int m_property_read_sub(const struct m_sub_property *props, int action, void *ar
                 val->format = MPV_FORMAT_STRING;
                 val->u.string = talloc_steal(list, s);
             }
-            list->keys[list->num] = (char *)prop->name;
+            // (Copied, because some callers build names dynamically.)
+            list->keys[list->num] = talloc_strdup(list, prop->name);
             list->num++;
         }
         *(struct mpv_node *)arg = node;
@@ -131,14 +131,28 @@ struct m_property {
     bool is_option;
 };
 
-struct m_property *m_property_list_find(const struct m_property *list,
-                                        const char *name);
+// List of properties with a hash index for fast lookup by name. The position
+// of a property in the table is its ID, which never changes.
+struct m_property_table;
+
+struct m_property_table *m_property_table_create(void *ta_parent);
+// Append a property. Returns false (and does nothing) if a property with the
+// same name exists already. prop.name must stay valid.
+bool m_property_table_add(struct m_property_table *t, struct m_property prop);
+// Return all properties, terminated with a {0} item. Invalidated by adding.
+const struct m_property *m_property_table_list(struct m_property_table *t);
+// Return the ID of the property with the given name, or -1 if not found.
+int m_property_table_find_id(struct m_property_table *t, bstr name);
+// Return the property with the given ID, or NULL if the ID is invalid.
+struct m_property *m_property_table_get(struct m_property_table *t, int id);
+struct m_property *m_property_table_find(struct m_property_table *t,
+                                         const char *name);
 
 // Access a property.
 // action: one of m_property_action
 // ctx: opaque value passed through to property implementation
 // returns: one of mp_property_return
-int m_property_do(struct mp_log *log, const struct m_property* prop_list,
+int m_property_do(struct mp_log *log, struct m_property_table *props,
                   const char* property_name, int action, void* arg, void *ctx);
 
 // Given a path of the form "a/b/c", this function will set *prefix to "a",
@@ -163,7 +177,7 @@ void m_properties_print_help_list(struct mp_log *log,
 // STR is recursively expanded using the same rules.
 // "$$" can be used to escape "$", and "$}" to escape "}".
 // "$>" disables parsing of "$" for the rest of the string.
-char* m_properties_expand_string(const struct m_property *prop_list,
+char* m_properties_expand_string(struct m_property_table *props,
                                  const char *str, void *ctx);
 
 // Trivial helpers for implementing properties.
@@ -71,6 +71,7 @@ extern const struct m_sub_options demux_rawaudio_conf;
 extern const struct m_sub_options demux_rawvideo_conf;
 extern const struct m_sub_options demux_lavf_conf;
 extern const struct m_sub_options demux_mkv_conf;
+extern const struct m_sub_options demux_playlist_conf;
 extern const struct m_sub_options vd_lavc_conf;
 extern const struct m_sub_options ad_lavc_conf;
 extern const struct m_sub_options input_config;
@@ -245,6 +246,7 @@ const m_option_t mp_opts[] = {
     OPT_STRING("dump-stats", dump_stats, UPDATE_TERM | CONF_PRE_PARSE),
     OPT_FLAG("msg-color", msg_color, CONF_PRE_PARSE | UPDATE_TERM),
     OPT_STRING("log-file", log_file, CONF_PRE_PARSE | M_OPT_FILE | UPDATE_TERM),
+    OPT_STRING("trace-file", trace_file, M_OPT_FILE | UPDATE_TERM),
     OPT_FLAG("msg-module", msg_module, UPDATE_TERM),
     OPT_FLAG("msg-time", msg_time, UPDATE_TERM),
 #if HAVE_WIN32_DESKTOP
@@ -357,7 +359,9 @@ const m_option_t mp_opts[] = {
     OPT_STRING("sub-demuxer", sub_demuxer_name, 0),
     OPT_FLAG("demuxer-thread", demuxer_thread, 0),
     OPT_FLAG("prefetch-playlist", prefetch_open, 0),
+    OPT_FLAG("fast-start", fast_start, 0),
     OPT_FLAG("cache-pause", cache_pausing, 0),
+    OPT_INTRANGE("memory-soft-limit", memory_soft_limit, 0, 0, INT_MAX),
 
     OPT_DOUBLE("mf-fps", mf_fps, 0),
     OPT_STRING("mf-type", mf_type, 0),
@@ -428,6 +432,7 @@ const m_option_t mp_opts[] = {
     OPT_SUBSTRUCT("demuxer-rawaudio", demux_rawaudio, demux_rawaudio_conf, 0),
     OPT_SUBSTRUCT("demuxer-rawvideo", demux_rawvideo, demux_rawvideo_conf, 0),
     OPT_SUBSTRUCT("demuxer-mkv", demux_mkv, demux_mkv_conf, 0),
+    OPT_SUBSTRUCT("", demux_playlist, demux_playlist_conf, 0),
 
 // ------------------------- subtitles options --------------------
 
@@ -616,6 +621,8 @@ const m_option_t mp_opts[] = {
                ({"no", -1}, {"absolute", 0}, {"yes", 1}, {"always", 1})),
     OPT_FLOAT("hr-seek-demuxer-offset", hr_seek_demuxer_offset, 0),
     OPT_FLAG("hr-seek-framedrop", hr_seek_framedrop, 0),
+    OPT_FLAG("seek-scrubbing", seek_scrubbing, UPDATE_SCRUBBING),
+    OPT_INTRANGE("video-backstep-cache", video_backstep_cache, 0, 0, 1000),
     OPT_CHOICE_OR_INT("autosync", autosync, 0, 0, 10000,
                       ({"no", -1})),
 
@@ -646,6 +653,10 @@ const m_option_t mp_opts[] = {
 
     OPT_STRING("input-file", input_file, M_OPT_FILE | UPDATE_INPUT),
     OPT_STRING("input-ipc-server", ipc_path, M_OPT_FILE | UPDATE_INPUT),
+    OPT_INTRANGE("input-ipc-max-queue", ipc_max_queue, 0, 1024, INT_MAX),
+    OPT_CHOICE("input-ipc-slow-client", ipc_slow_client, 0,
+               ({"throttle", 0},
+                {"disconnect", 1})),
 
     OPT_SUBSTRUCT("screenshot", screenshot_image_opts, screenshot_conf, 0),
     OPT_STRING("screenshot-template", screenshot_template, 0),
@@ -876,6 +887,7 @@ const struct MPOpts mp_default_opts = {
     .term_osd = 2,
     .term_osd_bar_chars = "[-+-]",
     .consolecontrols = 1,
+    .ipc_max_queue = 4 * 1024 * 1024,
     .playlist_pos = -1,
     .play_frames = -1,
     .rebase_start_time = 1,
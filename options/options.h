@@ -77,6 +77,7 @@ typedef struct MPOpts {
     int msg_module;
     int msg_time;
     char *log_file;
+    char *trace_file;
 
     int operation_mode;
 
@@ -165,6 +166,8 @@ typedef struct MPOpts {
     int hr_seek;
     float hr_seek_demuxer_offset;
     int hr_seek_framedrop;
+    int seek_scrubbing;
+    int video_backstep_cache;
     float audio_delay;
     float default_max_pts_correction;
     int autosync;
@@ -220,10 +223,12 @@ typedef struct MPOpts {
     char *demuxer_name;
     int demuxer_thread;
     int prefetch_open;
+    int fast_start;
     char *audio_demuxer_name;
     char *sub_demuxer_name;
 
     int cache_pausing;
+    int memory_soft_limit;
 
     struct image_writer_opts *screenshot_image_opts;
     char *screenshot_template;
@@ -308,6 +313,7 @@ typedef struct MPOpts {
     struct demux_rawvideo_opts *demux_rawvideo;
     struct demux_lavf_opts *demux_lavf;
     struct demux_mkv_opts *demux_mkv;
+    struct demux_playlist_opts *demux_playlist;
 
     struct demux_opts *demux_opts;
 
@@ -320,6 +326,8 @@ typedef struct MPOpts {
     struct encode_opts *encode_opts;
 
     char *ipc_path;
+    int ipc_max_queue;
+    int ipc_slow_client;
     char *input_file;
 
     int wingl_dwm_flush;
@@ -36,6 +36,7 @@ typedef struct { _Bool v;              } atomic_bool;
 typedef struct { long long v;          } atomic_llong;
 typedef struct { uint_least32_t v;     } atomic_uint_least32_t;
 typedef struct { unsigned long long v; } atomic_ullong;
+typedef struct { uintptr_t v;          } atomic_uintptr_t;
 
 typedef struct { float v;              } mp_atomic_float;
 
@@ -46,6 +47,7 @@ typedef struct { float v;              } mp_atomic_float;
 #define memory_order_seq_cst 2
 
 #define atomic_load_explicit(p, e) atomic_load(p)
+#define atomic_store_explicit(p, v, e) atomic_store(p, v)
 
 #include <pthread.h>
 
@@ -71,6 +73,14 @@ extern pthread_mutex_t mp_atomic_mutex;
        a_->v = v op b_;                                 \
        pthread_mutex_unlock(&mp_atomic_mutex);          \
        v; })
+#define atomic_exchange(p, new)                         \
+    ({ __typeof__(p) p_ = (p);                          \
+       __typeof__(new) new_ = (new);                    \
+       pthread_mutex_lock(&mp_atomic_mutex);            \
+       __typeof__(p_->v) old_ = p_->v;                  \
+       p_->v = new_;                                    \
+       pthread_mutex_unlock(&mp_atomic_mutex);          \
+       old_; })
 #define atomic_fetch_add(a, b) atomic_fetch_op(a, b, +)
 #define atomic_fetch_and(a, b) atomic_fetch_op(a, b, &)
 #define atomic_fetch_or(a, b)  atomic_fetch_op(a, b, |)
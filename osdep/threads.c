@@ -21,6 +21,7 @@
 
 #include "config.h"
 
+#include "common/tracing.h"
 #include "threads.h"
 #include "timer.h"
 
@@ -48,4 +49,5 @@ void mpthread_set_name(const char *name)
 #elif HAVE_OSX_THREAD_NAME
     pthread_setname_np(tname);
 #endif
+    mp_tracing_set_thread_name(name);
 }
@@ -21,6 +21,7 @@
 #include <errno.h>
 #include <locale.h>
 #include <assert.h>
+#include <math.h>
 
 #include "common/common.h"
 #include "common/global.h"
@@ -37,6 +38,7 @@
 #include "options/m_property.h"
 #include "options/path.h"
 #include "options/parse_configfile.h"
+#include "osdep/atomic.h"
 #include "osdep/threads.h"
 #include "osdep/timer.h"
 #include "osdep/io.h"
@@ -74,14 +76,37 @@ struct mp_client_api {
 
     struct mp_custom_protocol *custom_protocols;
     int num_custom_protocols;
+
+    // Observed properties, indexed by property ID + 1 (unknown properties
+    // have the ID -1).
+    struct prop_observers *observers;
+    int num_observers;
+
+    // Earliest mp_time_us() at which a throttled property has to be marked
+    // as changed, or 0. (Written with lock held.)
+    atomic_llong throttle_deadline;
+
+    // Lock statistics (see lock_clients()).
+    int64_t lock_count;
+    int64_t lock_contended;
+};
+
+struct prop_observers {
+    struct observe_property **props;
+    int num_props;
 };
 
 struct observe_property {
     char *name;
+    int index;              // in client->properties
     int id;                 // ==mp_get_property_id(name)
     uint64_t event_mask;    // ==mp_get_property_event_mask(name)
     int64_t reply_id;
     mpv_format format;
+    int64_t min_interval;   // in microseconds (0 if not throttled)
+    double min_delta;
+    int64_t next_change;    // earliest time the next change can be signaled
+    bool throttled;         // change is pending until next_change
     bool changed;           // property change should be signaled to user
     bool need_new_value;    // a new value should be retrieved
     bool updating;          // a new value is being retrieved
@@ -91,6 +116,12 @@ struct observe_property {
     struct mpv_handle *client;
 };
 
+// Data referenced by a single event returned by mpv_wait_events().
+struct event_storage {
+    struct mpv_event_property prop;
+    struct mpv_event_log_message msg;
+};
+
 struct mpv_handle {
     // -- immmutable
     char name[MAX_CLIENT_NAME];
@@ -100,8 +131,14 @@ struct mpv_handle {
     struct mp_client_api *clients;
 
     // -- not thread-safe
+    // cur_event is also the talloc parent of all memory referenced by the
+    // events returned by the last mpv_wait_event(s)() call.
     struct mpv_event *cur_event;
     struct mpv_event_property cur_property_event;
+    struct mpv_event_log_message cur_log_event;
+    // Per-event storage for mpv_wait_events(); reused across calls.
+    struct event_storage *batch_storage;
+    int batch_storage_size;
 
     pthread_mutex_t lock;
 
@@ -132,14 +169,21 @@ struct mpv_handle {
     int lowest_changed;     // attempt at making change processing incremental
     int properties_updating;
     uint64_t property_event_masks; // or-ed together event masks of all properties
+    // For each event ID, the properties which have it in their event_mask.
+    struct prop_observers event_observers[64];
 
     bool fuzzy_initialized; // see scripting.c wait_loaded()
     struct mp_log_buffer *messages;
 };
 
-static bool gen_log_message_event(struct mpv_handle *ctx);
-static bool gen_property_change_event(struct mpv_handle *ctx);
+static bool gen_log_message_event(struct mpv_handle *ctx, struct mpv_event *ev,
+                                  struct mpv_event_log_message *msg_ev);
+static bool gen_property_change_event(struct mpv_handle *ctx,
+                                      struct mpv_event *ev,
+                                      struct mpv_event_property *prop_ev);
 static void notify_property_events(struct mpv_handle *ctx, uint64_t event_mask);
+static void remove_observer(struct observe_property *prop);
+static void add_observer(struct observe_property *prop);
 
 void mp_clients_init(struct MPContext *mpctx)
 {
@@ -151,11 +195,26 @@ void mp_clients_init(struct MPContext *mpctx)
     pthread_mutex_init(&mpctx->clients->lock, NULL);
 }
 
+// Lock clients->lock, and count how often this had to wait for another thread.
+static void lock_clients(struct mp_client_api *clients)
+{
+    if (pthread_mutex_trylock(&clients->lock)) {
+        pthread_mutex_lock(&clients->lock);
+        clients->lock_contended++;
+        MP_STATS(clients->mpctx, "value %"PRId64" clients-lock-contended",
+                 clients->lock_contended);
+    }
+    clients->lock_count++;
+}
+
 void mp_clients_destroy(struct MPContext *mpctx)
 {
     if (!mpctx->clients)
         return;
     assert(mpctx->clients->num_clients == 0);
+    MP_VERBOSE(mpctx, "Client API lock: %"PRId64" times locked, "
+               "%"PRId64" times contended.\n", mpctx->clients->lock_count,
+               mpctx->clients->lock_contended);
     pthread_mutex_destroy(&mpctx->clients->lock);
     talloc_free(mpctx->clients);
     mpctx->clients = NULL;
@@ -163,7 +222,7 @@ void mp_clients_destroy(struct MPContext *mpctx)
 
 int mp_clients_num(struct MPContext *mpctx)
 {
-    pthread_mutex_lock(&mpctx->clients->lock);
+    lock_clients(mpctx->clients);
     int num_clients = mpctx->clients->num_clients;
     pthread_mutex_unlock(&mpctx->clients->lock);
     return num_clients;
@@ -174,7 +233,7 @@ int mp_clients_num(struct MPContext *mpctx)
 bool mp_clients_all_initialized(struct MPContext *mpctx)
 {
     bool all_ok = true;
-    pthread_mutex_lock(&mpctx->clients->lock);
+    lock_clients(mpctx->clients);
     for (int n = 0; n < mpctx->clients->num_clients; n++) {
         struct mpv_handle *ctx = mpctx->clients->clients[n];
         pthread_mutex_lock(&ctx->lock);
@@ -187,7 +246,7 @@ bool mp_clients_all_initialized(struct MPContext *mpctx)
 
 static void invalidate_global_event_mask(struct mpv_handle *ctx)
 {
-    pthread_mutex_lock(&ctx->clients->lock);
+    lock_clients(ctx->clients);
     ctx->clients->event_masks = 0;
     pthread_mutex_unlock(&ctx->clients->lock);
 }
@@ -204,7 +263,7 @@ static struct mpv_handle *find_client(struct mp_client_api *clients,
 
 bool mp_client_exists(struct MPContext *mpctx, const char *client_name)
 {
-    pthread_mutex_lock(&mpctx->clients->lock);
+    lock_clients(mpctx->clients);
     bool r = find_client(mpctx->clients, client_name);
     pthread_mutex_unlock(&mpctx->clients->lock);
     return r;
@@ -212,14 +271,14 @@ bool mp_client_exists(struct MPContext *mpctx, const char *client_name)
 
 void mp_client_enter_shutdown(struct MPContext *mpctx)
 {
-    pthread_mutex_lock(&mpctx->clients->lock);
+    lock_clients(mpctx->clients);
     mpctx->clients->shutting_down = true;
     pthread_mutex_unlock(&mpctx->clients->lock);
 }
 
 struct mpv_handle *mp_new_client(struct mp_client_api *clients, const char *name)
 {
-    pthread_mutex_lock(&clients->lock);
+    lock_clients(clients);
 
     char nname[MAX_CLIENT_NAME];
     for (int n = 1; n < 1000; n++) {
@@ -374,10 +433,12 @@ void mpv_detach_destroy(mpv_handle *ctx)
 
     struct mp_client_api *clients = ctx->clients;
 
-    pthread_mutex_lock(&clients->lock);
+    lock_clients(clients);
     for (int n = 0; n < clients->num_clients; n++) {
         if (clients->clients[n] == ctx) {
             MP_TARRAY_REMOVE_AT(clients->clients, clients->num_clients, n);
+            for (int i = 0; i < ctx->num_properties; i++)
+                remove_observer(ctx->properties[i]);
             while (ctx->num_events) {
                 talloc_free(ctx->events[ctx->first_event].data);
                 ctx->first_event = (ctx->first_event + 1) % ctx->max_events;
@@ -559,19 +620,25 @@ static void dup_event_data(struct mpv_event *ev)
 // reply can be made, even if the buffer becomes congested _after_ sending
 // the request.
 // Returns an error code if the buffer is full.
-static int reserve_reply(struct mpv_handle *ctx)
+static int reserve_replies(struct mpv_handle *ctx, int num)
 {
     int res = MPV_ERROR_EVENT_QUEUE_FULL;
     pthread_mutex_lock(&ctx->lock);
-    if (ctx->reserved_events + ctx->num_events < ctx->max_events && !ctx->choked)
+    if (ctx->reserved_events + ctx->num_events + num <= ctx->max_events &&
+        !ctx->choked)
     {
-        ctx->reserved_events++;
+        ctx->reserved_events += num;
         res = 0;
     }
     pthread_mutex_unlock(&ctx->lock);
     return res;
 }
 
+static int reserve_reply(struct mpv_handle *ctx)
+{
+    return reserve_replies(ctx, 1);
+}
+
 static int append_event(struct mpv_handle *ctx, struct mpv_event event, bool copy)
 {
     if (ctx->num_events + ctx->reserved_events >= ctx->max_events)
@@ -637,7 +704,7 @@ bool mp_client_event_is_registered(struct MPContext *mpctx, int event)
 {
     struct mp_client_api *clients = mpctx->clients;
 
-    pthread_mutex_lock(&clients->lock);
+    lock_clients(clients);
 
     if (!clients->event_masks) { // lazy update
         for (int n = 0; n < clients->num_clients; n++) {
@@ -658,7 +725,7 @@ void mp_client_broadcast_event(struct MPContext *mpctx, int event, void *data)
 {
     struct mp_client_api *clients = mpctx->clients;
 
-    pthread_mutex_lock(&clients->lock);
+    lock_clients(clients);
 
     for (int n = 0; n < clients->num_clients; n++) {
         struct mpv_event event_data = {
@@ -689,7 +756,7 @@ int mp_client_send_event(struct MPContext *mpctx, const char *client_name,
         .data = data,
     };
 
-    pthread_mutex_lock(&clients->lock);
+    lock_clients(clients);
 
     struct mpv_handle *ctx = find_client(clients, client_name);
     if (ctx) {
@@ -736,12 +803,9 @@ int mpv_request_event(mpv_handle *ctx, mpv_event_id event, int enable)
     return 0;
 }
 
-mpv_event *mpv_wait_event(mpv_handle *ctx, double timeout)
+// Called with ctx->lock held.
+static int64_t begin_wait(mpv_handle *ctx, double timeout)
 {
-    mpv_event *event = ctx->cur_event;
-
-    pthread_mutex_lock(&ctx->lock);
-
     if (!ctx->fuzzy_initialized)
         mp_wakeup_core(ctx->clients->mpctx);
     ctx->fuzzy_initialized = true;
@@ -749,10 +813,29 @@ mpv_event *mpv_wait_event(mpv_handle *ctx, double timeout)
     if (timeout < 0)
         timeout = 1e20;
 
-    int64_t deadline = mp_add_timeout(mp_time_us(), timeout);
+    // Release everything the previously returned events referenced at once.
+    *ctx->cur_event = (mpv_event){0};
+    talloc_free_children(ctx->cur_event);
 
-    *event = (mpv_event){0};
-    talloc_free_children(event);
+    return mp_add_timeout(mp_time_us(), timeout);
+}
+
+// Remove the first event from the queue. Called with ctx->lock held.
+static void pop_event(mpv_handle *ctx, mpv_event *event)
+{
+    *event = ctx->events[ctx->first_event];
+    ctx->first_event = (ctx->first_event + 1) % ctx->max_events;
+    ctx->num_events--;
+    talloc_steal(ctx->cur_event, event->data);
+}
+
+mpv_event *mpv_wait_event(mpv_handle *ctx, double timeout)
+{
+    mpv_event *event = ctx->cur_event;
+
+    pthread_mutex_lock(&ctx->lock);
+
+    int64_t deadline = begin_wait(ctx, timeout);
 
     while (1) {
         if (ctx->queued_wakeup)
@@ -769,17 +852,14 @@ mpv_event *mpv_wait_event(mpv_handle *ctx, double timeout)
             break;
         }
         if (ctx->num_events) {
-            *event = ctx->events[ctx->first_event];
-            ctx->first_event = (ctx->first_event + 1) % ctx->max_events;
-            ctx->num_events--;
-            talloc_steal(event, event->data);
+            pop_event(ctx, event);
             break;
         }
         // If there's a changed property, generate change event (never queued).
-        if (gen_property_change_event(ctx))
+        if (gen_property_change_event(ctx, event, &ctx->cur_property_event))
             break;
         // Pop item from message queue, and return as event.
-        if (gen_log_message_event(ctx))
+        if (gen_log_message_event(ctx, event, &ctx->cur_log_event))
             break;
         int r = wait_wakeup(ctx, deadline);
         if (r == ETIMEDOUT)
@@ -792,6 +872,58 @@ mpv_event *mpv_wait_event(mpv_handle *ctx, double timeout)
     return event;
 }
 
+int mpv_wait_events(mpv_handle *ctx, double timeout, mpv_event *events,
+                    int max_events)
+{
+    if (!events || max_events < 1)
+        return MPV_ERROR_INVALID_PARAMETER;
+
+    if (ctx->batch_storage_size < max_events) {
+        ctx->batch_storage = talloc_realloc(ctx, ctx->batch_storage,
+                                            struct event_storage, max_events);
+        ctx->batch_storage_size = max_events;
+    }
+    struct event_storage *storage = ctx->batch_storage;
+
+    pthread_mutex_lock(&ctx->lock);
+
+    int64_t deadline = begin_wait(ctx, timeout);
+
+    int num = 0;
+    while (1) {
+        if (ctx->queued_wakeup)
+            deadline = 0;
+        if (ctx->choked && !ctx->num_events) {
+            ctx->choked = false;
+            events[num++] = (mpv_event){.event_id = MPV_EVENT_QUEUE_OVERFLOW};
+        }
+        if (ctx->suspend_count && timeout > 0) {
+            MP_ERR(ctx, "attempting to wait while core is suspended");
+            break;
+        }
+        // Same order as with mpv_wait_event(): property changes and log
+        // messages are generated only once the queue is empty.
+        while (num < max_events && ctx->num_events)
+            pop_event(ctx, &events[num++]);
+        while (num < max_events && !ctx->num_events &&
+               gen_property_change_event(ctx, &events[num], &storage[num].prop))
+            num++;
+        while (num < max_events && !ctx->num_events &&
+               gen_log_message_event(ctx, &events[num], &storage[num].msg))
+            num++;
+        if (num)
+            break;
+        int r = wait_wakeup(ctx, deadline);
+        if (r == ETIMEDOUT)
+            break;
+    }
+    ctx->queued_wakeup = false;
+
+    pthread_mutex_unlock(&ctx->lock);
+
+    return num;
+}
+
 void mpv_wakeup(mpv_handle *ctx)
 {
     pthread_mutex_lock(&ctx->lock);
@@ -953,9 +1085,11 @@ static void run_locked(mpv_handle *ctx, void (*fn)(void *fn_data), void *fn_data
 //  fn: callback to execute the request
 //  fn_data: opaque caller-defined argument for fn. This will be automatically
 //           freed with talloc_free(fn_data).
-static int run_async(mpv_handle *ctx, void (*fn)(void *fn_data), void *fn_data)
+//  num_replies: number of replies fn will send (run_async() uses 1)
+static int run_async_n(mpv_handle *ctx, int num_replies,
+                       void (*fn)(void *fn_data), void *fn_data)
 {
-    int err = reserve_reply(ctx);
+    int err = reserve_replies(ctx, num_replies);
     if (err < 0) {
         talloc_free(fn_data);
         return err;
@@ -964,6 +1098,11 @@ static int run_async(mpv_handle *ctx, void (*fn)(void *fn_data), void *fn_data)
     return 0;
 }
 
+static int run_async(mpv_handle *ctx, void (*fn)(void *fn_data), void *fn_data)
+{
+    return run_async_n(ctx, 1, fn, fn_data);
+}
+
 struct cmd_request {
     struct MPContext *mpctx;
     struct mp_cmd *cmd;
@@ -1169,6 +1308,119 @@ int mpv_set_property_async(mpv_handle *ctx, uint64_t ud, const char *name,
     return run_async(ctx, setproperty_fn, req);
 }
 
+struct setproperties_request {
+    int num;
+    struct setproperty_request *items;
+    // Only for async requests with num==0.
+    struct mpv_handle *reply_ctx;
+    uint64_t userdata;
+};
+
+static void setproperties_fn(void *arg)
+{
+    struct setproperties_request *req = arg;
+    for (int n = 0; n < req->num; n++)
+        setproperty_fn(&req->items[n]);
+    // An empty request still gets a single reply.
+    if (req->reply_ctx) {
+        status_reply(req->reply_ctx, MPV_EVENT_SET_PROPERTY_REPLY,
+                     req->userdata, 0);
+    }
+}
+
+int mpv_set_properties(mpv_handle *ctx, int num, const char **names,
+                       mpv_format format, void *data, int *errors)
+{
+    const struct m_option *type = get_mp_type(format);
+    if (num < 0 || (num > 0 && (!names || !data)))
+        return MPV_ERROR_INVALID_PARAMETER;
+    if (!type)
+        return MPV_ERROR_PROPERTY_FORMAT;
+    size_t size = type->type->size;
+
+    int res = 0;
+    if (!ctx->mpctx->initialized) {
+        // Goes through mpv_set_option(); no need to batch anything.
+        for (int n = 0; n < num; n++) {
+            int r = mpv_set_property(ctx, names[n], format,
+                                     (char *)data + n * size);
+            if (errors)
+                errors[n] = r;
+            if (r < 0 && res >= 0)
+                res = r;
+        }
+        return res;
+    }
+
+    struct setproperties_request req = {
+        .num = num,
+        .items = talloc_array(NULL, struct setproperty_request, num),
+    };
+    for (int n = 0; n < num; n++) {
+        req.items[n] = (struct setproperty_request){
+            .mpctx = ctx->mpctx,
+            .name = names[n],
+            .format = format,
+            .data = (char *)data + n * size,
+        };
+    }
+    run_locked(ctx, setproperties_fn, &req);
+    for (int n = 0; n < num; n++) {
+        int r = req.items[n].status;
+        if (errors)
+            errors[n] = r;
+        if (r < 0 && res >= 0)
+            res = r;
+    }
+    talloc_free(req.items);
+    return res;
+}
+
+static void free_prop_set_reqs(void *ptr)
+{
+    struct setproperties_request *req = ptr;
+    for (int n = 0; n < req->num; n++)
+        free_prop_set_req(&req->items[n]);
+}
+
+int mpv_set_properties_async(mpv_handle *ctx, uint64_t ud, int num,
+                             const char **names, mpv_format format, void *data)
+{
+    const struct m_option *type = get_mp_type(format);
+    if (!ctx->mpctx->initialized)
+        return MPV_ERROR_UNINITIALIZED;
+    if (num < 0 || (num > 0 && (!names || !data)))
+        return MPV_ERROR_INVALID_PARAMETER;
+    if (!type)
+        return MPV_ERROR_PROPERTY_FORMAT;
+    size_t size = type->type->size;
+
+    struct setproperties_request *req = talloc_ptrtype(NULL, req);
+    *req = (struct setproperties_request){
+        .items = talloc_array(req, struct setproperty_request, num),
+    };
+    for (int n = 0; n < num; n++) {
+        struct setproperty_request *item = &req->items[n];
+        *item = (struct setproperty_request){
+            .mpctx = ctx->mpctx,
+            .name = talloc_strdup(req, names[n]),
+            .format = format,
+            .data = talloc_zero_size(req, size),
+            .reply_ctx = ctx,
+            .userdata = ud,
+        };
+        m_option_copy(type, item->data, (char *)data + n * size);
+        req->num++;
+    }
+    talloc_set_destructor(req, free_prop_set_reqs);
+    if (!num) {
+        req->reply_ctx = ctx;
+        req->userdata = ud;
+    }
+
+    return run_async_n(ctx, MPMAX(num, 1), setproperties_fn, req);
+}
+
 struct getproperty_request {
     struct MPContext *mpctx;
     const char *name;
@@ -1312,6 +1564,104 @@ int mpv_get_property_async(mpv_handle *ctx, uint64_t ud, const char *name,
     return run_async(ctx, getproperty_fn, req);
 }
 
+struct getproperties_request {
+    int num;
+    struct getproperty_request *items;
+    // Only for async requests with num==0.
+    struct mpv_handle *reply_ctx;
+    uint64_t userdata;
+};
+
+static void getproperties_fn(void *arg)
+{
+    struct getproperties_request *req = arg;
+    for (int n = 0; n < req->num; n++)
+        getproperty_fn(&req->items[n]);
+    // An empty request still gets a single reply, with no property.
+    if (req->reply_ctx) {
+        struct mpv_event_property *prop = talloc_ptrtype(NULL, prop);
+        *prop = (struct mpv_event_property){
+            .name = talloc_strdup(prop, ""),
+            .format = MPV_FORMAT_NONE,
+        };
+        struct mpv_event reply = {
+            .event_id = MPV_EVENT_GET_PROPERTY_REPLY,
+            .data = prop,
+        };
+        send_reply(req->reply_ctx, req->userdata, &reply);
+    }
+}
+
+int mpv_get_properties(mpv_handle *ctx, int num, const char **names,
+                       mpv_format format, void *data, int *errors)
+{
+    const struct m_option *type = get_mp_type_get(format);
+    if (!ctx->mpctx->initialized)
+        return MPV_ERROR_UNINITIALIZED;
+    if (num < 0 || (num > 0 && (!names || !data)))
+        return MPV_ERROR_INVALID_PARAMETER;
+    if (!type)
+        return MPV_ERROR_PROPERTY_FORMAT;
+    size_t size = type->type->size;
+
+    struct getproperties_request req = {
+        .num = num,
+        .items = talloc_array(NULL, struct getproperty_request, num),
+    };
+    for (int n = 0; n < num; n++) {
+        req.items[n] = (struct getproperty_request){
+            .mpctx = ctx->mpctx,
+            .name = names[n],
+            .format = format,
+            .data = (char *)data + n * size,
+        };
+    }
+    // A single dispatch for all items: the playloop can't run in between, so
+    // the values are consistent with each other.
+    run_locked(ctx, getproperties_fn, &req);
+    int res = 0;
+    for (int n = 0; n < num; n++) {
+        int r = req.items[n].status;
+        if (errors)
+            errors[n] = r;
+        if (r < 0 && res >= 0)
+            res = r;
+    }
+    talloc_free(req.items);
+    return res;
+}
+
+int mpv_get_properties_async(mpv_handle *ctx, uint64_t ud, int num,
+                             const char **names, mpv_format format)
+{
+    if (!ctx->mpctx->initialized)
+        return MPV_ERROR_UNINITIALIZED;
+    if (num < 0 || (num > 0 && !names))
+        return MPV_ERROR_INVALID_PARAMETER;
+    if (!get_mp_type_get(format))
+        return MPV_ERROR_PROPERTY_FORMAT;
+
+    struct getproperties_request *req = talloc_ptrtype(NULL, req);
+    *req = (struct getproperties_request){
+        .num = num,
+        .items = talloc_array(req, struct getproperty_request, num),
+    };
+    for (int n = 0; n < num; n++) {
+        req->items[n] = (struct getproperty_request){
+            .mpctx = ctx->mpctx,
+            .name = talloc_strdup(req, names[n]),
+            .format = format,
+            .reply_ctx = ctx,
+            .userdata = ud,
+        };
+    }
+    if (!num) {
+        req->reply_ctx = ctx;
+        req->userdata = ud;
+    }
+    return run_async_n(ctx, MPMAX(num, 1), getproperties_fn, req);
+}
+
 static void property_free(void *p)
 {
     struct observe_property *prop = p;
@@ -1325,35 +1675,51 @@ static void property_free(void *p)
 int mpv_observe_property(mpv_handle *ctx, uint64_t userdata,
                          const char *name, mpv_format format)
 {
+    return mpv_observe_property_throttled(ctx, userdata, name, format, 0, 0);
+}
+
+int mpv_observe_property_throttled(mpv_handle *ctx, uint64_t userdata,
+                                   const char *name, mpv_format format,
+                                   double min_interval, double min_delta)
+{
+    if (!(min_interval >= 0 && min_interval < 1e6) || !(min_delta >= 0))
+        return MPV_ERROR_INVALID_PARAMETER;
     if (format != MPV_FORMAT_NONE && !get_mp_type_get(format))
         return MPV_ERROR_PROPERTY_FORMAT;
     // Explicitly disallow this, because it would require a special code path.
     if (format == MPV_FORMAT_OSD_STRING)
         return MPV_ERROR_PROPERTY_FORMAT;
 
+    lock_clients(ctx->clients);
     pthread_mutex_lock(&ctx->lock);
     struct observe_property *prop = talloc_ptrtype(ctx, prop);
     talloc_set_destructor(prop, property_free);
     *prop = (struct observe_property){
         .client = ctx,
         .name = talloc_strdup(prop, name),
+        .index = ctx->num_properties,
         .id = mp_get_property_id(ctx->mpctx, name),
         .event_mask = mp_get_property_event_mask(name),
         .reply_id = userdata,
         .format = format,
+        .min_interval = min_interval * 1e6,
+        .min_delta = min_delta,
         .changed = true,
         .need_new_value = true,
     };
     MP_TARRAY_APPEND(ctx, ctx->properties, ctx->num_properties, prop);
+    add_observer(prop);
     ctx->property_event_masks |= prop->event_mask;
     ctx->lowest_changed = 0;
     pthread_mutex_unlock(&ctx->lock);
+    pthread_mutex_unlock(&ctx->clients->lock);
     invalidate_global_event_mask(ctx);
     return 0;
 }
 
 int mpv_unobserve_property(mpv_handle *ctx, uint64_t userdata)
 {
+    lock_clients(ctx->clients);
     pthread_mutex_lock(&ctx->lock);
     ctx->property_event_masks = 0;
     int count = 0;
@@ -1369,61 +1735,204 @@ int mpv_unobserve_property(mpv_handle *ctx, uint64_t userdata)
                 // with the value update mechanism.
                 talloc_steal(ctx->cur_event, prop);
             }
+            remove_observer(prop);
             MP_TARRAY_REMOVE_AT(ctx->properties, ctx->num_properties, n);
             count++;
         }
         if (!prop->dead)
             ctx->property_event_masks |= prop->event_mask;
     }
+    for (int n = 0; n < ctx->num_properties; n++)
+        ctx->properties[n]->index = n;
     ctx->lowest_changed = 0;
     pthread_mutex_unlock(&ctx->lock);
+    pthread_mutex_unlock(&ctx->clients->lock);
     invalidate_global_event_mask(ctx);
     return count;
 }
 
-static void mark_property_changed(struct mpv_handle *client, int index)
+static void add_to_observers(void *ta_parent, struct prop_observers *obs,
+                             struct observe_property *prop)
 {
-    struct observe_property *prop = client->properties[index];
+    MP_TARRAY_APPEND(ta_parent, obs->props, obs->num_props, prop);
+}
+
+static void remove_from_observers(struct prop_observers *obs,
+                                  struct observe_property *prop)
+{
+    for (int n = 0; n < obs->num_props; n++) {
+        if (obs->props[n] == prop) {
+            MP_TARRAY_REMOVE_AT(obs->props, obs->num_props, n);
+            break;
+        }
+    }
+}
+
+// Add prop to the property ID and event indexes.
+// Called with clients->lock and ctx->lock held.
+static void add_observer(struct observe_property *prop)
+{
+    struct mpv_handle *ctx = prop->client;
+    struct mp_client_api *clients = ctx->clients;
+
+    while (clients->num_observers <= prop->id + 1) {
+        MP_TARRAY_APPEND(clients, clients->observers, clients->num_observers,
+                         (struct prop_observers){0});
+    }
+    add_to_observers(clients, &clients->observers[prop->id + 1], prop);
+
+    for (int n = 0; n < 64; n++) {
+        if (prop->event_mask & (1ULL << n))
+            add_to_observers(ctx, &ctx->event_observers[n], prop);
+    }
+}
+
+// Called with clients->lock and ctx->lock held.
+static void remove_observer(struct observe_property *prop)
+{
+    struct mpv_handle *ctx = prop->client;
+
+    remove_from_observers(&ctx->clients->observers[prop->id + 1], prop);
+
+    for (int n = 0; n < 64; n++) {
+        if (prop->event_mask & (1ULL << n))
+            remove_from_observers(&ctx->event_observers[n], prop);
+    }
+}
+
+// Called with client->lock held. (clients->lock is not needed: the throttle
+// deadline is atomic.)
+static void mark_property_changed(struct observe_property *prop)
+{
+    struct mpv_handle *client = prop->client;
+
+    if (prop->min_interval) {
+        int64_t now = mp_time_us();
+        if (now < prop->next_change) {
+            // Coalesce all changes until the interval has passed; see
+            // mp_client_update_throttled().
+            if (!prop->throttled) {
+                prop->throttled = true;
+                struct mp_client_api *clients = client->clients;
+                long long deadline = atomic_load(&clients->throttle_deadline);
+                if (!deadline || prop->next_change < deadline) {
+                    atomic_store(&clients->throttle_deadline, prop->next_change);
+                    mp_wakeup_core(clients->mpctx);
+                }
+            }
+            return;
+        }
+        prop->next_change = now + prop->min_interval;
+        prop->throttled = false;
+    }
+
     prop->changed = true;
     prop->need_new_value = prop->format != 0;
-    client->lowest_changed = MPMIN(client->lowest_changed, index);
+    client->lowest_changed = MPMIN(client->lowest_changed, prop->index);
 }
 
 // Broadcast that a property has changed.
 void mp_client_property_change(struct MPContext *mpctx, const char *name)
+{
+    mp_client_property_change_id(mpctx, mp_get_property_id(mpctx, name));
+}
+
+// Like mp_client_property_change(), but with id=mp_get_property_id(name).
+void mp_client_property_change_id(struct MPContext *mpctx, int id)
 {
     struct mp_client_api *clients = mpctx->clients;
-    int id = mp_get_property_id(mpctx, name);
 
-    pthread_mutex_lock(&clients->lock);
+    lock_clients(clients);
+
+    if (id + 1 >= 0 && id + 1 < clients->num_observers) {
+        struct prop_observers *obs = &clients->observers[id + 1];
+        for (int n = 0; n < obs->num_props; n++) {
+            struct mpv_handle *client = obs->props[n]->client;
+            pthread_mutex_lock(&client->lock);
+            mark_property_changed(obs->props[n]);
+            if (client->lowest_changed < client->num_properties)
+                wakeup_client(client);
+            pthread_mutex_unlock(&client->lock);
+        }
+    }
 
-    for (int n = 0; n < clients->num_clients; n++) {
-        struct mpv_handle *client = clients->clients[n];
-        pthread_mutex_lock(&client->lock);
-        for (int i = 0; i < client->num_properties; i++) {
-            if (client->properties[i]->id == id)
-                mark_property_changed(client, i);
+    pthread_mutex_unlock(&clients->lock);
+}
+
+// Mark throttled properties as changed if their interval has passed, and
+// make sure the core wakes up again when the next one has to be marked.
+void mp_client_update_throttled(struct MPContext *mpctx)
+{
+    struct mp_client_api *clients = mpctx->clients;
+
+    if (!atomic_load(&clients->throttle_deadline))
+        return;
+
+    lock_clients(clients);
+
+    int64_t now = mp_time_us();
+    long long deadline = atomic_load(&clients->throttle_deadline);
+    if (deadline && deadline <= now) {
+        deadline = 0;
+        for (int n = 0; n < clients->num_clients; n++) {
+            struct mpv_handle *client = clients->clients[n];
+            pthread_mutex_lock(&client->lock);
+            for (int i = 0; i < client->num_properties; i++) {
+                struct observe_property *prop = client->properties[i];
+                if (!prop->throttled)
+                    continue;
+                if (prop->next_change <= now) {
+                    prop->next_change = 0;
+                    mark_property_changed(prop);
+                } else if (!deadline || prop->next_change < deadline) {
+                    deadline = prop->next_change;
+                }
+            }
+            if (client->lowest_changed < client->num_properties)
+                wakeup_client(client);
+            pthread_mutex_unlock(&client->lock);
         }
-        if (client->lowest_changed < client->num_properties)
-            wakeup_client(client);
-        pthread_mutex_unlock(&client->lock);
+        atomic_store(&clients->throttle_deadline, deadline);
     }
 
     pthread_mutex_unlock(&clients->lock);
+
+    if (deadline)
+        mp_set_timeout(mpctx, (deadline - now) / 1e6);
 }
 
 // Mark properties as changed in reaction to specific events.
 // Called with ctx->lock held.
 static void notify_property_events(struct mpv_handle *ctx, uint64_t event_mask)
 {
-    for (int i = 0; i < ctx->num_properties; i++) {
-        if (ctx->properties[i]->event_mask & event_mask)
-            mark_property_changed(ctx, i);
+    for (int n = 0; n < 64; n++) {
+        if (!(event_mask & (1ULL << n)))
+            continue;
+        struct prop_observers *obs = &ctx->event_observers[n];
+        for (int i = 0; i < obs->num_props; i++)
+            mark_property_changed(obs->props[i]);
     }
     if (ctx->lowest_changed < ctx->num_properties)
         wakeup_client(ctx);
 }
 
+// Whether the new value is too close to the last returned one to be signaled.
+static bool within_delta(struct observe_property *prop)
+{
+    if (prop->min_delta <= 0)
+        return false;
+    switch (prop->format) {
+    case MPV_FORMAT_DOUBLE:
+        return fabs(prop->new_value.double_ - prop->user_value.double_) <
+               prop->min_delta;
+    case MPV_FORMAT_INT64:
+        return fabs((double)prop->new_value.int64 -
+                    (double)prop->user_value.int64) < prop->min_delta;
+    default:
+        return false;
+    }
+}
+
 static void update_prop(void *p)
 {
     struct observe_property *prop = p;
@@ -1451,7 +1960,8 @@ static void update_prop(void *p)
     if (prop->user_value_valid != prop->new_value_valid) {
         prop->changed = true;
     } else if (prop->user_value_valid && prop->new_value_valid) {
-        if (!compare_value(&prop->user_value, &prop->new_value, prop->format))
+        if (!compare_value(&prop->user_value, &prop->new_value, prop->format) &&
+            !within_delta(prop))
             prop->changed = true;
     }
     if (prop->dead)
@@ -1460,9 +1970,11 @@ static void update_prop(void *p)
     pthread_mutex_unlock(&ctx->lock);
 }
 
-// Set ctx->cur_event to a generated property change event, if there is any
-// outstanding property.
-static bool gen_property_change_event(struct mpv_handle *ctx)
+// Set *ev to a generated property change event, if there is any outstanding
+// property. *prop_ev is used as storage for the event data.
+static bool gen_property_change_event(struct mpv_handle *ctx,
+                                      struct mpv_event *ev,
+                                      struct mpv_event_property *prop_ev)
 {
     if (!ctx->mpctx->initialized)
         return false;
@@ -1485,16 +1997,16 @@ static bool gen_property_change_event(struct mpv_handle *ctx)
                 prop->user_value_valid = prop->new_value_valid;
                 if (prop->new_value_valid)
                     m_option_copy(type, &prop->user_value, &prop->new_value);
-                ctx->cur_property_event = (struct mpv_event_property){
+                *prop_ev = (struct mpv_event_property){
                     .name = prop->name,
                     .format = prop->user_value_valid ? prop->format : 0,
                 };
                 if (prop->user_value_valid)
-                    ctx->cur_property_event.data = &prop->user_value;
-                *ctx->cur_event = (struct mpv_event){
+                    prop_ev->data = &prop->user_value;
+                *ev = (struct mpv_event){
                     .event_id = MPV_EVENT_PROPERTY_CHANGE,
                     .reply_userdata = prop->reply_id,
-                    .data = &ctx->cur_property_event,
+                    .data = prop_ev,
                 };
                 return true;
             }
@@ -1549,25 +2061,25 @@ int mpv_request_log_messages(mpv_handle *ctx, const char *min_level)
     return 0;
 }
 
-// Set ctx->cur_event to a generated log message event, if any available.
-static bool gen_log_message_event(struct mpv_handle *ctx)
+// Set *ev to a generated log message event, if any available. *msg_ev is used
+// as storage for the event data.
+static bool gen_log_message_event(struct mpv_handle *ctx, struct mpv_event *ev,
+                                  struct mpv_event_log_message *msg_ev)
 {
     if (ctx->messages) {
         struct mp_log_buffer_entry *msg =
             mp_msg_log_buffer_read(ctx->messages);
         if (msg) {
-            struct mpv_event_log_message *cmsg =
-                talloc_ptrtype(ctx->cur_event, cmsg);
-            talloc_steal(cmsg, msg);
-            *cmsg = (struct mpv_event_log_message){
+            talloc_steal(ctx->cur_event, msg);
+            *msg_ev = (struct mpv_event_log_message){
                 .prefix = msg->prefix,
                 .level = mp_log_levels[msg->level],
                 .log_level = mp_mpv_log_levels[msg->level],
                 .text = msg->text,
             };
-            *ctx->cur_event = (struct mpv_event){
+            *ev = (struct mpv_event){
                 .event_id = MPV_EVENT_LOG_MESSAGE,
-                .data = cmsg,
+                .data = msg_ev,
             };
             return true;
         }
@@ -1763,7 +2275,7 @@ int mpv_stream_cb_add_ro(mpv_handle *ctx, const char *protocol, void *user_data,
 
     struct mp_client_api *clients = ctx->clients;
     int r = 0;
-    pthread_mutex_lock(&clients->lock);
+    lock_clients(clients);
     for (int n = 0; n < clients->num_custom_protocols; n++) {
         struct mp_custom_protocol *proto = &clients->custom_protocols[n];
         if (strcmp(proto->protocol, protocol) == 0) {
@@ -1791,7 +2303,7 @@ bool mp_streamcb_lookup(struct mpv_global *g, const char *protocol,
 {
     struct mp_client_api *clients = g->client_api;
     bool found = false;
-    pthread_mutex_lock(&clients->lock);
+    lock_clients(clients);
     for (int n = 0; n < clients->num_custom_protocols; n++) {
         struct mp_custom_protocol *proto = &clients->custom_protocols[n];
         if (strcmp(proto->protocol, protocol) == 0) {
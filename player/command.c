@@ -44,7 +44,10 @@
 #include "stream/stream.h"
 #include "demux/demux.h"
 #include "demux/stheader.h"
+#include "common/mem_account.h"
+#include "common/perf_counters.h"
 #include "common/playlist.h"
+#include "common/tracing.h"
 #include "sub/osd.h"
 #include "sub/dec_sub.h"
 #include "options/m_option.h"
@@ -78,8 +81,10 @@
 #endif
 
 struct command_ctx {
-    // All properties, terminated with a {0} item.
-    struct m_property *properties;
+    // All properties. The table index is used as property ID.
+    struct m_property_table *properties;
+    // Property IDs for mp_notify_property_id().
+    int notify_ids[MP_NOTIFY_PROP_COUNT];
 
     bool is_idle;
 
@@ -360,7 +365,8 @@ int mp_on_set_option(void *ctx, struct m_config_option *co, void *data, int flag
     // property implementation is trivial, and can break some obscure features
     // like --profile and --include if non-trivial flags are involved (which
     // the bridge would drop).
-    struct m_property *prop = m_property_list_find(cmd->properties, name);
+    int id = m_property_table_find_id(cmd->properties, bstr0(name));
+    struct m_property *prop = m_property_table_get(cmd->properties, id);
     if (prop && prop->is_option)
         goto direct_option;
 
@@ -386,7 +392,7 @@ int mp_on_set_option(void *ctx, struct m_config_option *co, void *data, int flag
     return 0;
 
 direct_option:
-    mp_notify_property(mpctx, name);
+    mp_client_property_change_id(mpctx, id);
     return m_config_set_option_raw_direct(mpctx->mconfig, co, data, flags);
 }
 
@@ -1531,6 +1537,30 @@ static int mp_property_seeking(void *ctx, struct m_property *prop,
     return m_property_flag_ro(action, arg, !mpctx->restart_complete);
 }
 
+static int mp_property_seek_latency(void *ctx, struct m_property *prop,
+                                    int action, void *arg)
+{
+    MPContext *mpctx = ctx;
+    if (!mpctx->playback_initialized || mpctx->last_seek_latency < 0)
+        return M_PROPERTY_UNAVAILABLE;
+    return m_property_double_ro(action, arg, mpctx->last_seek_latency);
+}
+
+static int mp_property_ipc_clients(void *ctx, struct m_property *prop,
+                                   int action, void *arg)
+{
+    MPContext *mpctx = ctx;
+    switch (action) {
+    case M_PROPERTY_GET_TYPE:
+        *(struct m_option *)arg = (struct m_option){.type = CONF_TYPE_NODE};
+        return M_PROPERTY_OK;
+    case M_PROPERTY_GET:
+        mp_ipc_get_client_stats(mpctx->ipc_ctx, arg);
+        return M_PROPERTY_OK;
+    }
+    return M_PROPERTY_NOT_IMPLEMENTED;
+}
+
 static int mp_property_playback_abort(void *ctx, struct m_property *prop,
                                       int action, void *arg)
 {
@@ -1759,6 +1789,77 @@ static int mp_property_demuxer_cache_state(void *ctx, struct m_property *prop,
     return M_PROPERTY_OK;
 }
 
+static int mp_property_memory_usage(void *ctx, struct m_property *prop,
+                                    int action, void *arg)
+{
+    MPContext *mpctx = ctx;
+    struct m_sub_property props[MP_MEM_DOMAIN_COUNT + 3] = {0};
+    for (int n = 0; n < MP_MEM_DOMAIN_COUNT; n++) {
+        props[n] = (struct m_sub_property){
+            .name = mp_mem_domain_name(n),
+            SUB_PROP_INT64(mp_mem_get_usage(n)),
+        };
+    }
+    props[MP_MEM_DOMAIN_COUNT] = (struct m_sub_property){
+        "total", SUB_PROP_INT64(mp_mem_get_total_usage()),
+    };
+    props[MP_MEM_DOMAIN_COUNT + 1] = (struct m_sub_property){
+        "over-soft-limit", SUB_PROP_FLAG(mpctx->low_memory),
+    };
+    return m_property_read_sub(props, action, arg);
+}
+
+static void add_startup_phases(void *ta_ctx, struct m_sub_property **props,
+                               int *num_props, const char *prefix,
+                               struct startup_profile *p)
+{
+    if (!p->start)
+        return;
+    for (int n = 0; n <= p->num_phases; n++) {
+        bool total = n == p->num_phases;
+        const char *name = total ? "total" : p->phases[n].name;
+        double duration = total ? p->last - p->start : p->phases[n].duration;
+        struct m_sub_property sub = {
+            .name = talloc_asprintf(ta_ctx, "%s-%s", prefix, name),
+            SUB_PROP_DOUBLE(duration),
+        };
+        MP_TARRAY_APPEND(ta_ctx, *props, *num_props, sub);
+    }
+}
+
+static int mp_property_startup_times(void *ctx, struct m_property *prop,
+                                     int action, void *arg)
+{
+    MPContext *mpctx = ctx;
+    void *tmp = talloc_new(NULL);
+    struct m_sub_property *props = NULL;
+    int num_props = 0;
+    add_startup_phases(tmp, &props, &num_props, "init", &mpctx->init_profile);
+    add_startup_phases(tmp, &props, &num_props, "load", &mpctx->load_profile);
+    MP_TARRAY_APPEND(tmp, props, num_props, (struct m_sub_property){0});
+    int r = m_property_read_sub(props, action, arg);
+    talloc_free(tmp);
+    return r;
+}
+
+static int mp_property_perf_counters(void *ctx, struct m_property *prop,
+                                     int action, void *arg)
+{
+    uint64_t values[MP_PERF_MAX_COUNTERS];
+    int num = mp_perf_counters_get(values);
+    struct m_sub_property *props =
+        talloc_zero_array(NULL, struct m_sub_property, num + 1);
+    for (int n = 0; n < num; n++) {
+        props[n] = (struct m_sub_property){
+            .name = mp_perf_counter_name(n),
+            SUB_PROP_INT64(values[n]),
+        };
+    }
+    int r = m_property_read_sub(props, action, arg);
+    talloc_free(props);
+    return r;
+}
+
 static int mp_property_demuxer_start_time(void *ctx, struct m_property *prop,
                                           int action, void *arg)
 {
@@ -3842,10 +3943,9 @@ static int mp_property_list(void *ctx, struct m_property *prop,
     case M_PROPERTY_GET: {
         char **list = NULL;
         int num = 0;
-        for (int n = 0; cmd->properties[n].name; n++) {
-            MP_TARRAY_APPEND(NULL, list, num,
-                                talloc_strdup(NULL, cmd->properties[n].name));
-        }
+        const struct m_property *props = m_property_table_list(cmd->properties);
+        for (int n = 0; props[n].name; n++)
+            MP_TARRAY_APPEND(NULL, list, num, talloc_strdup(NULL, props[n].name));
         MP_TARRAY_APPEND(NULL, list, num, NULL);
         *(char ***)arg = list;
         return M_PROPERTY_OK;
@@ -3925,6 +4025,8 @@ static const struct m_property mp_properties_base[] = {
     {"core-idle", mp_property_core_idle},
     {"eof-reached", mp_property_eof_reached},
     {"seeking", mp_property_seeking},
+    {"seek-latency", mp_property_seek_latency},
+    {"ipc-clients", mp_property_ipc_clients},
     {"playback-abort", mp_property_playback_abort},
     {"cache-percent", mp_property_cache},
     {"cache-free", mp_property_cache_free},
@@ -3940,6 +4042,9 @@ static const struct m_property mp_properties_base[] = {
     {"cache-buffering-state", mp_property_cache_buffering},
     {"paused-for-cache", mp_property_paused_for_cache},
     {"demuxer-via-network", mp_property_demuxer_is_network},
+    {"memory-usage", mp_property_memory_usage},
+    {"perf-counters", mp_property_perf_counters},
+    {"startup-times", mp_property_startup_times},
     {"clock", mp_property_clock},
     {"seekable", mp_property_seekable},
     {"partially-seekable", mp_property_partially_seekable},
@@ -4126,7 +4231,8 @@ static const char *const *const mp_event_property_change[] = {
       "current-ao", "audio-codec-name", "audio-params",
       "audio-out-params", "volume-max", "mixer-active"),
     E(MPV_EVENT_SEEK, "seeking", "core-idle", "eof-reached"),
-    E(MPV_EVENT_PLAYBACK_RESTART, "seeking", "core-idle", "eof-reached"),
+    E(MPV_EVENT_PLAYBACK_RESTART, "seeking", "core-idle", "eof-reached",
+      "seek-latency"),
     E(MPV_EVENT_METADATA_UPDATE, "metadata", "filtered-metadata", "media-title"),
     E(MPV_EVENT_CHAPTER_CHANGE, "chapter", "chapter-metadata"),
     E(MP_EVENT_CACHE_UPDATE, "cache", "cache-free", "cache-used", "cache-idle",
@@ -4183,11 +4289,14 @@ uint64_t mp_get_property_event_mask(const char *name)
 int mp_get_property_id(struct MPContext *mpctx, const char *name)
 {
     struct command_ctx *ctx = mpctx->command_ctx;
-    for (int n = 0; ctx->properties[n].name; n++) {
-        if (match_property(ctx->properties[n].name, name))
-            return n;
-    }
-    return -1;
+    // Give options and properties the same ID each, so change notifications
+    // work both way. Sub-properties get the ID of the top-level property.
+    bstr prop = bstr0(name);
+    bstr_eatstart0(&prop, "options/");
+    int slash = bstrchr(prop, '/');
+    if (slash >= 0)
+        prop = bstr_splice(prop, 0, slash);
+    return m_property_table_find_id(ctx->properties, prop);
 }
 
 static bool is_property_set(int action, void *val)
@@ -4273,7 +4382,8 @@ char *mp_property_expand_escaped_string(struct MPContext *mpctx, const char *str
 void property_print_help(struct MPContext *mpctx)
 {
     struct command_ctx *ctx = mpctx->command_ctx;
-    m_properties_print_help_list(mpctx->log, ctx->properties);
+    m_properties_print_help_list(mpctx->log,
+                                 m_property_table_list(ctx->properties));
 }
 
 /* List of default ways to show a property on OSD.
@@ -4455,6 +4565,11 @@ static const char *const filter_opt[STREAM_TYPE_COUNT] = {
     [STREAM_AUDIO] = "af",
 };
 
+static const enum mp_notify_prop filter_notify[STREAM_TYPE_COUNT] = {
+    [STREAM_VIDEO] = MP_NOTIFY_VF,
+    [STREAM_AUDIO] = MP_NOTIFY_AF,
+};
+
 static int set_filters(struct MPContext *mpctx, enum stream_type mediatype,
                        struct m_obj_settings *new_chain)
 {
@@ -4472,7 +4587,7 @@ static int set_filters(struct MPContext *mpctx, enum stream_type mediatype,
 
     if (success) {
         m_option_free(co->opt, &old_settings);
-        mp_notify_property(mpctx, filter_opt[mediatype]);
+        mp_notify_property_id(mpctx, filter_notify[mediatype]);
     } else {
         m_option_free(co->opt, list);
         *list = old_settings;
@@ -5456,6 +5571,22 @@ int run_command(struct MPContext *mpctx, struct mp_cmd *cmd, struct mpv_node *re
         break;
     }
 
+    case MP_CMD_DUMP_TRACE: {
+        char *file = cmd->args[0].v.s;
+        if (!file[0])
+            file = opts->trace_file;
+        if (!mpctx->tracing || !file || !file[0]) {
+            MP_ERR(mpctx, "Tracing is not enabled (see --trace-file).\n");
+            return -1;
+        }
+        char *path = mp_get_user_path(NULL, mpctx->global, file);
+        bool ok = mp_tracing_dump(mpctx->log, path);
+        talloc_free(path);
+        if (!ok)
+            return -1;
+        break;
+    }
+
     case MP_CMD_AO_RELOAD:
         reload_audio_output(mpctx);
         break;
@@ -5659,6 +5790,14 @@ void command_uninit(struct MPContext *mpctx)
     mpctx->command_ctx = NULL;
 }
 
+static const char *const notify_prop_names[MP_NOTIFY_PROP_COUNT] = {
+    [MP_NOTIFY_PLAYLIST]          = "playlist",
+    [MP_NOTIFY_RECORD_FILE]       = "record-file",
+    [MP_NOTIFY_AUDIO_DEVICE_LIST] = "audio-device-list",
+    [MP_NOTIFY_VF]                = "vf",
+    [MP_NOTIFY_AF]                = "af",
+};
+
 void command_init(struct MPContext *mpctx)
 {
     struct command_ctx *ctx = talloc(NULL, struct command_ctx);
@@ -5667,13 +5806,11 @@ void command_init(struct MPContext *mpctx)
     };
     mpctx->command_ctx = ctx;
 
-    int num_base = MP_ARRAY_SIZE(mp_properties_base);
-    int num_opts = m_config_get_co_count(mpctx->mconfig);
-    ctx->properties =
-        talloc_zero_array(ctx, struct m_property, num_base + num_opts + 1);
-    memcpy(ctx->properties, mp_properties_base, sizeof(mp_properties_base));
+    ctx->properties = m_property_table_create(ctx);
+    for (int n = 0; n < MP_ARRAY_SIZE(mp_properties_base); n++)
+        m_property_table_add(ctx->properties, mp_properties_base[n]);
 
-    int count = num_base;
+    int num_opts = m_config_get_co_count(mpctx->mconfig);
     for (int n = 0; n < num_opts; n++) {
         struct m_config_option *co = m_config_get_co_index(mpctx->mconfig, n);
         assert(co->name[0]);
@@ -5716,14 +5853,14 @@ void command_init(struct MPContext *mpctx)
             };
         }
 
-        if (prop.name) {
-            // The option might be covered by a manual property already.
-            if (m_property_list_find(ctx->properties, prop.name))
-                continue;
-
-            ctx->properties[count++] = prop;
-        }
+        // The option might be covered by a manual property already, in
+        // which case this does nothing.
+        if (prop.name)
+            m_property_table_add(ctx->properties, prop);
     }
+
+    for (int n = 0; n < MP_NOTIFY_PROP_COUNT; n++)
+        ctx->notify_ids[n] = mp_get_property_id(mpctx, notify_prop_names[n]);
 }
 
 static void command_event(struct MPContext *mpctx, int event, void *arg)
@@ -5752,7 +5889,9 @@ void handle_command_updates(struct MPContext *mpctx)
     // This is a bit messy: ao_hotplug wakes up the player, and then we have
     // to recheck the state. Then the client(s) will read the property.
     if (ctx->hotplug && ao_hotplug_check_update(ctx->hotplug))
-        mp_notify_property(mpctx, "audio-device-list");
+        mp_notify_property_id(mpctx, MP_NOTIFY_AUDIO_DEVICE_LIST);
+
+    mp_client_update_throttled(mpctx);
 }
 
 void mp_notify(struct MPContext *mpctx, int event, void *arg)
@@ -5838,9 +5977,18 @@ void mp_option_change_callback(void *ctx, struct m_config_option *co, int flags)
 
     if (flags & UPDATE_LAVFI_COMPLEX)
         update_lavfi_complex(mpctx);
+
+    if (flags & UPDATE_SCRUBBING)
+        update_seek_scrubbing(mpctx);
 }
 
 void mp_notify_property(struct MPContext *mpctx, const char *property)
 {
     mp_client_property_change(mpctx, property);
 }
+
+// Like mp_notify_property(), without looking up the property by name.
+void mp_notify_property_id(struct MPContext *mpctx, enum mp_notify_prop prop)
+{
+    mp_client_property_change_id(mpctx, mpctx->command_ctx->notify_ids[prop]);
+}
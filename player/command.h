@@ -42,6 +42,19 @@ void mp_option_change_callback(void *ctx, struct m_config_option *co, int flags)
 void mp_notify(struct MPContext *mpctx, int event, void *arg);
 void mp_notify_property(struct MPContext *mpctx, const char *property);
 
+// Properties the player core notifies changes of without going through the
+// property layer. Their IDs are looked up once on init.
+enum mp_notify_prop {
+    MP_NOTIFY_PLAYLIST,
+    MP_NOTIFY_RECORD_FILE,
+    MP_NOTIFY_AUDIO_DEVICE_LIST,
+    MP_NOTIFY_VF,
+    MP_NOTIFY_AF,
+    MP_NOTIFY_PROP_COUNT
+};
+
+void mp_notify_property_id(struct MPContext *mpctx, enum mp_notify_prop prop);
+
 void handle_command_updates(struct MPContext *mpctx);
 
 int mp_get_property_id(struct MPContext *mpctx, const char *name);
@@ -90,6 +90,7 @@ struct seek_params {
     enum seek_precision exact;
     double amount;
     unsigned flags; // MPSEEK_FLAG_*
+    double start_time; // mp_time_sec() when the seek was first queued
 };
 
 enum video_sync {
@@ -237,11 +238,26 @@ enum playback_status {
     STATUS_EOF,         // playback has ended, or is disabled
 };
 
+#define MAX_STARTUP_PHASES 16
+
+// Durations of the phases of player initialization or file loading, for the
+// startup-times property.
+struct startup_profile {
+    struct {
+        const char *name;   // static string
+        double duration;    // seconds
+    } phases[MAX_STARTUP_PHASES];
+    int num_phases;
+    double start, last;     // mp_time_sec() at start, and at last phase end
+    bool active;            // phases are being recorded
+};
+
 #define NUM_PTRACKS 2
 
 typedef struct MPContext {
     bool initialized;
     bool autodetach;
+    bool tracing; // --trace-file is set
     struct mpv_global *global;
     struct MPOpts *opts;
     struct mp_log *log;
@@ -330,6 +346,12 @@ typedef struct MPContext {
     struct mp_image *next_frames[VO_MAX_REQ_FRAMES + 1];
     int num_next_frames;
     struct mp_image *saved_frame;   // for hrseek_lastframe and hrseek_backstep
+    // Recently displayed frames for --video-backstep-cache (newest first).
+    struct mp_image **backstep_frames;
+    int num_backstep_frames;
+    // Index of the backstep_frames[] entry currently shown (0 if normal
+    // playback, which means the newest frame is shown).
+    int backstep_pos;
 
     enum playback_status video_status, audio_status;
     bool restart_complete;
@@ -353,6 +375,11 @@ typedef struct MPContext {
     bool hrseek_backstep;   // go to frame before seek target
     double hrseek_pts;
     struct seek_params current_seek;
+    // Time from the last seek until its first frame was shown, or -1.
+    double last_seek_latency;
+    // Actual target of the last seek done with --seek-scrubbing.
+    double scrub_seek_pts;
+    bool scrubbing;         // --seek-scrubbing as seen by the last update
     bool ab_loop_clip;      // clip to the "b" part of an A-B loop if available
     // AV sync: the next frame should be shown when the audio out has this
     // much (in seconds) buffered data left. Increased when more data is
@@ -394,6 +421,7 @@ typedef struct MPContext {
 
     double last_idle_tick;
     double next_cache_update;
+    double next_perf_dump;
 
     double sleeptime;      // number of seconds to sleep before next iteration
 
@@ -435,6 +463,9 @@ typedef struct MPContext {
     double cache_stop_time, cache_wait_time;
     int cache_buffer;
 
+    // Accounted memory is over --memory-soft-limit.
+    bool low_memory;
+
     // Set after showing warning about decoding being too slow for realtime
     // playback rate. Used to avoid showing it multiple times.
     bool drop_message_shown;
@@ -449,6 +480,14 @@ typedef struct MPContext {
 
     struct mp_ipc_ctx *ipc_ctx;
 
+    // Reference to the shared thread pool, acquired on first use.
+    struct mp_thread_pool *thread_pool;
+
+    struct startup_profile init_profile, load_profile;
+    // Scripts were started by mp_load_scripts() in --fast-start mode, and
+    // the first file has to wait until they're initialized.
+    bool scripts_loading;
+
     struct mpv_opengl_cb_context *gl_cb_ctx;
 
     pthread_mutex_t lock;
@@ -470,6 +509,7 @@ typedef struct MPContext {
     //     to true.
     struct demuxer *open_res_demuxer;
     int open_res_error;
+    double open_res_stream_time; // mp_time_sec() when the stream was opened
 } MPContext;
 
 // audio.c
@@ -550,6 +590,12 @@ void update_window_title(struct MPContext *mpctx, bool force);
 void error_on_track(struct MPContext *mpctx, struct track *track);
 int stream_dump(struct MPContext *mpctx, const char *source_filename);
 double get_track_seek_offset(struct MPContext *mpctx, struct track *track);
+void startup_profile_begin(struct startup_profile *p);
+void startup_profile_phase(struct startup_profile *p, const char *name);
+void startup_profile_phase_at(struct startup_profile *p, const char *name,
+                              double time);
+void startup_profile_end(struct MPContext *mpctx, struct startup_profile *p,
+                         const char *title);
 
 // osd.c
 void set_osd_bar(struct MPContext *mpctx, int type,
@@ -573,6 +619,7 @@ void set_pause_state(struct MPContext *mpctx, bool user_pause);
 void update_internal_pause_state(struct MPContext *mpctx);
 void update_core_idle_state(struct MPContext *mpctx);
 void add_step_frame(struct MPContext *mpctx, int dir);
+void update_seek_scrubbing(struct MPContext *mpctx);
 void queue_seek(struct MPContext *mpctx, enum seek_type type, double amount,
                 enum seek_precision exact, int flags);
 double get_time_length(struct MPContext *mpctx);
@@ -601,6 +648,7 @@ struct mp_scripting {
     int (*load)(struct mpv_handle *client, const char *filename);
 };
 void mp_load_scripts(struct MPContext *mpctx);
+void mp_wait_scripts_loaded(struct MPContext *mpctx);
 void mp_load_builtin_scripts(struct MPContext *mpctx);
 int mp_load_script(struct MPContext *mpctx, const char *fname);
 int mp_load_user_script(struct MPContext *mpctx, const char *fname);
@@ -618,12 +666,15 @@ bool update_subtitles(struct MPContext *mpctx, double video_pts);
 int video_get_colors(struct vo_chain *vo_c, const char *item, int *value);
 int video_set_colors(struct vo_chain *vo_c, const char *item, int value);
 void reset_video_state(struct MPContext *mpctx);
+bool step_backstep_frame(struct MPContext *mpctx, int dir);
+void sync_backstep_frame(struct MPContext *mpctx);
 int init_video_decoder(struct MPContext *mpctx, struct track *track);
 void reinit_video_chain(struct MPContext *mpctx);
 void reinit_video_chain_src(struct MPContext *mpctx, struct track *track);
 int reinit_video_filters(struct MPContext *mpctx);
 void write_video(struct MPContext *mpctx);
 void mp_force_video_refresh(struct MPContext *mpctx);
+bool init_video_out(struct MPContext *mpctx);
 void uninit_video_out(struct MPContext *mpctx);
 void uninit_video_chain(struct MPContext *mpctx);
 double calc_average_frame_duration(struct MPContext *mpctx);
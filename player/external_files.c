@@ -15,7 +15,6 @@
  * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include <dirent.h>
 #include <string.h>
 #include <strings.h>
 #include <stdlib.h>
@@ -28,6 +27,7 @@
 #include "common/msg.h"
 #include "misc/ctype.h"
 #include "misc/charset_conv.h"
+#include "misc/dir_cache.h"
 #include "options/options.h"
 #include "options/path.h"
 #include "external_files.h"
@@ -128,27 +128,17 @@ static void append_dir_subtitles(struct mpv_global *global,
     if (mp_is_url(bstr0(path0)))
         goto out;
 
-    DIR *d = opendir(path0);
-    if (!d)
+    struct mp_dir_listing *dir = mp_dir_cache_get(global->dir_cache, log, path0);
+    if (!dir)
         goto out;
     mp_verbose(log, "Loading external files in %.*s\n", BSTR_P(path));
-    struct dirent *de;
-    while ((de = readdir(d))) {
-        void *tmpmem2 = talloc_new(tmpmem);
-        struct bstr den = bstr0(de->d_name);
-        struct bstr dename = mp_iconv_to_utf8(log, den,
-                                              "UTF-8-MAC", MP_NO_LATIN1_FALLBACK);
-        // retrieve various parts of the filename
-        struct bstr tmp_fname_noext = bstrdup(tmpmem2, bstr_strip_ext(dename));
-        bstr_lower(tmp_fname_noext);
-        struct bstr tmp_fname_ext = bstr_get_ext(dename);
-        struct bstr tmp_fname_trim = bstr_strip(tmp_fname_noext);
-
-        if (den.start != dename.start)
-            talloc_steal(tmpmem2, dename.start);
+    for (int i = 0; i < dir->num_entries; i++) {
+        struct mp_dir_entry *de = &dir->entries[i];
+        struct bstr dename = de->uname;
+        struct bstr tmp_fname_trim = de->lower_noext;
 
         // check what it is (most likely)
-        int type = test_ext(tmp_fname_ext);
+        int type = test_ext(de->ext);
         char **langs = NULL;
         int fuzz = -1;
         switch (type) {
@@ -163,7 +153,7 @@ static void append_dir_subtitles(struct mpv_global *global,
         }
 
         if (fuzz < 0 || (limit_type >= 0 && limit_type != type))
-            goto next_sub;
+            continue;
 
         // we have a (likely) subtitle file
         // 0 = nothing
@@ -196,7 +186,7 @@ static void append_dir_subtitles(struct mpv_global *global,
         }
 
         mp_dbg(log, "Potential external file: \"%s\"  Priority: %d\n",
-               de->d_name, prio);
+               de->name, prio);
 
         if (prio) {
             prio += prio;
@@ -216,11 +206,8 @@ static void append_dir_subtitles(struct mpv_global *global,
             } else
                 talloc_free(subpath);
         }
-
-    next_sub:
-        talloc_free(tmpmem2);
     }
-    closedir(d);
+    mp_dir_listing_unref(dir);
 
  out:
     talloc_free(tmpmem);
@@ -23,13 +23,16 @@
 #include <unistd.h>
 #include <dirent.h>
 #include <math.h>
+#include <stddef.h>
 #include <stdint.h>
+#include <stdlib.h>
 
 #include <mujs.h>
 
 #include "osdep/io.h"
 #include "mpv_talloc.h"
 #include "common/common.h"
+#include "common/mem_account.h"
 #include "options/m_property.h"
 #include "common/msg.h"
 #include "common/msg_control.h"
@@ -455,6 +458,30 @@ static int s_init_js(js_State *J, struct script_ctx *ctx)
 /**********************************************************************
  *  Initialization - booting the script
  *********************************************************************/
+// mujs doesn't pass the old size to the allocator, so store it in front of each
+// block for the memory accounting.
+union js_alloc_header {
+    size_t size;
+    max_align_t align;
+};
+
+static void *s_js_alloc(void *actx, void *ptr, int size)
+{
+    union js_alloc_header *h = ptr ? (union js_alloc_header *)ptr - 1 : NULL;
+    int64_t old_size = h ? h->size : 0;
+    if (size == 0) {
+        free(h);
+        mp_mem_account(MP_MEM_SCRIPTS, -old_size);
+        return NULL;
+    }
+    union js_alloc_header *n = realloc(h, sizeof(*n) + (size_t)size);
+    if (!n)
+        return NULL;
+    n->size = size;
+    mp_mem_account(MP_MEM_SCRIPTS, size - old_size);
+    return n + 1;
+}
+
 // s_load_javascript: (entry point) creates the js vm, runs the script, returns
 //                    on script exit or uncaught js errors. Never throws.
 // script__run_script: - loads the built in functions and vars into the vm
@@ -475,7 +502,7 @@ static int s_load_javascript(struct mpv_handle *client, const char *fname)
     };
 
     int r = -1;
-    js_State *J = js_newstate(NULL, NULL, 0);
+    js_State *J = js_newstate(s_js_alloc, NULL, 0);
     if (!J || s_init_js(J, ctx))
         goto error_out;
 
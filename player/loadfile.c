@@ -42,6 +42,7 @@
 #include "common/encode.h"
 #include "common/recorder.h"
 #include "input/input.h"
+#include "misc/thread_pool.h"
 
 #include "audio/decode/dec_audio.h"
 #include "audio/out/ao.h"
@@ -568,32 +569,41 @@ bool mp_remove_track(struct MPContext *mpctx, struct track *track)
     return true;
 }
 
-// Add the given file as additional track. Only tracks of type "filter" are
-// included; pass STREAM_TYPE_COUNT to disable filtering.
-struct track *mp_add_external_file(struct MPContext *mpctx, char *filename,
-                                   enum stream_type filter)
+static char *external_disp_filename(char *filename)
 {
-    struct MPOpts *opts = mpctx->opts;
-    if (!filename)
-        return NULL;
+    if (strncmp(filename, "memory://", 9) == 0)
+        return "memory://"; // avoid noise
+    return filename;
+}
 
-    char *disp_filename = filename;
-    if (strncmp(disp_filename, "memory://", 9) == 0)
-        disp_filename = "memory://"; // avoid noise
+static void external_demuxer_params(struct MPContext *mpctx,
+                                    enum stream_type filter,
+                                    struct demuxer_params *params)
+{
+    struct MPOpts *opts = mpctx->opts;
 
-    struct demuxer_params params = {0};
+    *params = (struct demuxer_params){0};
 
     switch (filter) {
     case STREAM_SUB:
-        params.force_format = opts->sub_demuxer_name;
+        params->force_format = opts->sub_demuxer_name;
         break;
     case STREAM_AUDIO:
-        params.force_format = opts->audio_demuxer_name;
+        params->force_format = opts->audio_demuxer_name;
         break;
     }
+}
+
+// Add the tracks of an opened external file. Takes over the demuxer (it's
+// freed on failure). demuxer can be NULL if opening failed.
+static struct track *add_external_demuxer(struct MPContext *mpctx,
+                                          struct demuxer *demuxer,
+                                          char *filename,
+                                          enum stream_type filter)
+{
+    struct MPOpts *opts = mpctx->opts;
+    char *disp_filename = external_disp_filename(filename);
 
-    struct demuxer *demuxer =
-        demux_open_url(filename, &params, mpctx->playback_abort, mpctx->global);
     if (!demuxer)
         goto err_out;
     enable_demux_thread(mpctx, demuxer);
@@ -627,15 +637,184 @@ err_out:
     return false;
 }
 
-static void open_external_files(struct MPContext *mpctx, char **files,
-                                enum stream_type filter)
+// Add the given file as additional track. Only tracks of type "filter" are
+// included; pass STREAM_TYPE_COUNT to disable filtering.
+struct track *mp_add_external_file(struct MPContext *mpctx, char *filename,
+                                   enum stream_type filter)
+{
+    if (!filename)
+        return NULL;
+
+    struct demuxer_params params;
+    external_demuxer_params(mpctx, filter, &params);
+
+    struct demuxer *demuxer =
+        demux_open_url(filename, &params, mpctx->playback_abort, mpctx->global);
+    return add_external_demuxer(mpctx, demuxer, filename, filter);
+}
+
+struct external_open {
+    struct external_batch *batch;
+    char *filename;
+    enum stream_type filter;
+    struct demuxer_params params;
+    bool auto_loaded;
+    char *lang;
+    struct mp_thread_pool_job *job;
+    // Set by the worker thread.
+    struct demuxer *demuxer;
+};
+
+struct external_batch {
+    struct MPContext *mpctx;
+    struct external_open *items;
+    int num_items;
+    int num_started;
+    atomic_int pending;
+};
+
+static void add_external_open(struct external_batch *b, char *filename,
+                              enum stream_type filter)
+{
+    struct external_open item = {
+        .batch = b,
+        .filename = talloc_strdup(b, filename),
+        .filter = filter,
+    };
+    external_demuxer_params(b->mpctx, filter, &item.params);
+    item.params.force_format = talloc_strdup(b, item.params.force_format);
+    MP_TARRAY_APPEND(b, b->items, b->num_items, item);
+}
+
+static bool has_external_open(struct external_batch *b, char *filename)
+{
+    for (int n = 0; n < b->num_items; n++) {
+        if (strcmp(b->items[n].filename, filename) == 0)
+            return true;
+    }
+    return false;
+}
+
+static void open_external_thread(void *ctx)
+{
+    struct external_open *item = ctx;
+    struct MPContext *mpctx = item->batch->mpctx;
+
+    item->demuxer = demux_open_url(item->filename, &item->params,
+                                   mpctx->playback_abort, mpctx->global);
+
+    atomic_fetch_add(&item->batch->pending, -1);
+    mp_wakeup_core(mpctx);
+}
+
+static struct mp_thread_pool *get_thread_pool(struct MPContext *mpctx)
+{
+    if (!mpctx->thread_pool)
+        mpctx->thread_pool = mp_thread_pool_shared_ref();
+    return mpctx->thread_pool;
+}
+
+// Start opening the files added to the batch since the last call. If pool is
+// NULL, they're opened on the calling thread.
+static void start_external_batch(struct external_batch *b,
+                                 struct mp_thread_pool *pool)
+{
+    for (; b->num_started < b->num_items; b->num_started++) {
+        struct external_open *item = &b->items[b->num_started];
+        atomic_fetch_add(&b->pending, 1);
+        if (pool) {
+            item->job = mp_thread_pool_submit(pool, 0, open_external_thread,
+                                              item);
+        } else {
+            open_external_thread(item);
+        }
+    }
+}
+
+// Open all files in the batch concurrently, and add their tracks in the order
+// the files were added to the batch (so track IDs and default track selection
+// do not depend on which file happened to finish first). Frees the batch.
+// If responsive is set, run the core's input processing while waiting. This
+// must not be set if called from a command handler.
+static void run_external_batch(struct external_batch *b, bool responsive)
+{
+    struct MPContext *mpctx = b->mpctx;
+
+    struct mp_thread_pool *pool = NULL;
+    if (b->num_items - b->num_started > 1)
+        pool = get_thread_pool(mpctx);
+    start_external_batch(b, pool);
+
+    // Keep the player responsive, and allow aborting slow network opens.
+    while (responsive && atomic_load(&b->pending) > 0) {
+        mp_idle(mpctx);
+
+        if (mpctx->stop_play) {
+            mp_abort_playback_async(mpctx);
+            break;
+        }
+    }
+
+    // Wait for the remaining opens. Files that were not started yet are not
+    // opened at all if playback is being stopped.
+    for (int n = 0; n < b->num_items; n++) {
+        struct external_open *item = &b->items[n];
+        if (!item->job)
+            continue;
+        if (mpctx->stop_play) {
+            mp_thread_pool_cancel(item->job);
+        } else {
+            mp_thread_pool_wait(item->job);
+        }
+        item->job = NULL;
+    }
+
+    for (int n = 0; n < b->num_items; n++) {
+        struct external_open *item = &b->items[n];
+        struct track *track = add_external_demuxer(mpctx, item->demuxer,
+                                                   item->filename, item->filter);
+        if (track && item->auto_loaded) {
+            track->auto_loaded = true;
+            if (!track->lang)
+                track->lang = talloc_strdup(track, item->lang);
+        }
+    }
+
+    talloc_free(b);
+}
+
+static struct external_batch *new_external_batch(struct MPContext *mpctx)
+{
+    struct external_batch *b = talloc_zero(NULL, struct external_batch);
+    b->mpctx = mpctx;
+    return b;
+}
+
+// Free a batch without adding its tracks. Files still being opened are
+// waited for (or not opened at all, if their jobs have not started yet).
+static void discard_external_batch(struct external_batch *b)
+{
+    for (int n = 0; n < b->num_started; n++) {
+        struct external_open *item = &b->items[n];
+        if (item->job)
+            mp_thread_pool_cancel(item->job);
+        if (item->demuxer)
+            free_demuxer_and_stream(item->demuxer);
+    }
+    talloc_free(b);
+}
+
+static void add_external_files(struct external_batch *b, char **files,
+                               enum stream_type filter)
 {
     for (int n = 0; files && files[n]; n++)
-        mp_add_external_file(mpctx, files[n], filter);
+        add_external_open(b, files[n], filter);
 }
 
-void autoload_external_files(struct MPContext *mpctx)
+static void add_autoload_files(struct external_batch *b)
 {
+    struct MPContext *mpctx = b->mpctx;
+
     if (mpctx->opts->sub_auto < 0 && mpctx->opts->audiofile_auto < 0)
         return;
     if (!mpctx->opts->autoload_files)
@@ -657,6 +836,11 @@ void autoload_external_files(struct MPContext *mpctx)
         if (!mpctx->tracks[n]->attached_picture)
             sc[mpctx->tracks[n]->type]++;
     }
+    // Explicitly given external files, which are opened in the same batch.
+    for (int n = 0; n < b->num_items; n++) {
+        if (b->items[n].filter != STREAM_TYPE_COUNT)
+            sc[b->items[n].filter]++;
+    }
 
     for (int i = 0; list && list[i].fname; i++) {
         char *filename = list[i].fname;
@@ -666,22 +850,60 @@ void autoload_external_files(struct MPContext *mpctx)
             if (t->demuxer && strcmp(t->demuxer->filename, filename) == 0)
                 goto skip;
         }
+        if (has_external_open(b, filename))
+            goto skip;
         if (list[i].type == STREAM_SUB && !sc[STREAM_VIDEO] && !sc[STREAM_AUDIO])
             goto skip;
         if (list[i].type == STREAM_AUDIO && !sc[STREAM_VIDEO])
             goto skip;
-        struct track *track = mp_add_external_file(mpctx, filename, list[i].type);
-        if (track) {
-            track->auto_loaded = true;
-            if (!track->lang)
-                track->lang = talloc_strdup(track, lang);
-        }
+        add_external_open(b, filename, list[i].type);
+        struct external_open *item = &b->items[b->num_items - 1];
+        item->auto_loaded = true;
+        item->lang = talloc_strdup(b, lang);
     skip:;
     }
 
     talloc_free(tmp);
 }
 
+void autoload_external_files(struct MPContext *mpctx)
+{
+    struct external_batch *b = new_external_batch(mpctx);
+    add_autoload_files(b);
+    run_external_batch(b, false);
+}
+
+static void add_option_files(struct external_batch *b)
+{
+    struct MPOpts *opts = b->mpctx->opts;
+    add_external_files(b, opts->audio_files, STREAM_AUDIO);
+    add_external_files(b, opts->sub_name, STREAM_SUB);
+    add_external_files(b, opts->external_files, STREAM_TYPE_COUNT);
+}
+
+// Start opening --audio-file, --sub-file and --external-file files in the
+// background. Unlike autoloaded files, these don't depend on the main demuxer.
+static struct external_batch *start_external_files(struct MPContext *mpctx)
+{
+    struct external_batch *b = new_external_batch(mpctx);
+    add_option_files(b);
+    start_external_batch(b, get_thread_pool(mpctx));
+    return b;
+}
+
+// Open --audio-file, --sub-file, --external-file and autoloaded files. If b is
+// not NULL, it's the batch returned by start_external_files().
+static void open_external_files(struct MPContext *mpctx,
+                                struct external_batch *b)
+{
+    if (!b) {
+        b = new_external_batch(mpctx);
+        add_option_files(b);
+    }
+    add_autoload_files(b);
+    run_external_batch(b, true);
+}
+
 // Do stuff to a newly loaded playlist. This includes any processing that may
 // be required after loading a playlist.
 void prepare_playlist(struct MPContext *mpctx, struct playlist *pl)
@@ -814,6 +1036,7 @@ static void *open_demux_thread(void *ctx)
     };
     mpctx->open_res_demuxer =
         demux_open_url(mpctx->open_url, &p, mpctx->open_cancel, mpctx->global);
+    mpctx->open_res_stream_time = p.stream_opened;
 
     if (mpctx->open_res_demuxer) {
         MP_VERBOSE(mpctx, "Opening done: %s\n", mpctx->open_url);
@@ -877,6 +1100,17 @@ static void start_open(struct MPContext *mpctx, char *url, int url_flags)
     mpctx->open_active = true;
 }
 
+// Start opening the current URL in the background, unless this is already
+// being done (--fast-start). If the URL is changed after this (e.g. by on_load
+// hooks), open_demux_reentrant() discards the result.
+static void start_open_current(struct MPContext *mpctx)
+{
+    char *url = mpctx->stream_open_filename;
+    if (mpctx->open_active && strcmp(mpctx->open_url, url) == 0)
+        return;
+    start_open(mpctx, url, mpctx->playing->stream_flags);
+}
+
 static void open_demux_reentrant(struct MPContext *mpctx)
 {
     char *url = mpctx->stream_open_filename;
@@ -1136,6 +1370,9 @@ static void play_current_file(struct MPContext *mpctx)
 {
     struct MPOpts *opts = mpctx->opts;
     double playback_start = -1e100;
+    struct external_batch *early_files = NULL;
+
+    startup_profile_begin(&mpctx->load_profile);
 
     mp_notify(mpctx, MPV_EVENT_START_FILE, NULL);
 
@@ -1165,6 +1402,9 @@ static void play_current_file(struct MPContext *mpctx)
 
     // let get_current_time() show 0 as start time (before playback_pts is set)
     mpctx->last_seek_pts = 0.0;
+    mpctx->last_seek_latency = -1;
+    mpctx->scrub_seek_pts = MP_NOPTS_VALUE;
+    mpctx->scrubbing = opts->seek_scrubbing;
 
     mpctx->playing = mpctx->playlist->current;
     if (!mpctx->playing || !mpctx->playing->filename)
@@ -1202,23 +1442,54 @@ static void play_current_file(struct MPContext *mpctx)
 
     MP_INFO(mpctx, "Playing: %s\n", mpctx->filename);
 
+    startup_profile_phase(&mpctx->load_profile, "options");
+
 reopen_file:
 
     assert(mpctx->demuxer == NULL);
 
+    bool dump = opts->stream_dump && opts->stream_dump[0];
+
+    // Probe the file while scripts initialize and hooks run.
+    if (opts->fast_start && !dump)
+        start_open_current(mpctx);
+
+    if (mpctx->scripts_loading) {
+        mp_wait_scripts_loaded(mpctx);
+        startup_profile_phase(&mpctx->load_profile, "scripts");
+    }
+
     if (process_open_hooks(mpctx) < 0)
         goto terminate_playback;
 
-    if (opts->stream_dump && opts->stream_dump[0]) {
+    startup_profile_phase(&mpctx->load_profile, "open-hooks");
+
+    if (dump) {
         if (stream_dump(mpctx, mpctx->stream_open_filename) >= 0)
             mpctx->error_playing = 1;
         goto terminate_playback;
     }
 
+    if (opts->fast_start) {
+        start_open_current(mpctx);
+        early_files = start_external_files(mpctx);
+        // The VO is destroyed again if the file turns out to have no video.
+        if (opts->stream_id[0][STREAM_VIDEO] != -2 && !mpctx->encode_lavc_ctx) {
+            init_video_out(mpctx);
+            startup_profile_phase(&mpctx->load_profile, "vo-init");
+        }
+    }
+
     open_demux_reentrant(mpctx);
     if (!mpctx->demuxer || mpctx->stop_play)
         goto terminate_playback;
 
+    // (The stream might have been opened before the current phase started,
+    // if it was prefetched.)
+    startup_profile_phase_at(&mpctx->load_profile, "stream-open",
+                             mpctx->open_res_stream_time);
+    startup_profile_phase(&mpctx->load_profile, "demuxer-probe");
+
     if (mpctx->demuxer->playlist) {
         struct playlist *pl = mpctx->demuxer->playlist;
         int entry_stream_flags = 0;
@@ -1230,7 +1501,7 @@ reopen_file:
         for (struct playlist_entry *e = pl->first; e; e = e->next)
             e->stream_flags |= entry_stream_flags;
         transfer_playlist(mpctx, pl);
-        mp_notify_property(mpctx, "playlist");
+        mp_notify_property_id(mpctx, MP_NOTIFY_PLAYLIST);
         mpctx->error_playing = 2;
         goto terminate_playback;
     }
@@ -1242,10 +1513,10 @@ reopen_file:
     load_chapters(mpctx);
     add_demuxer_tracks(mpctx, mpctx->demuxer);
 
-    open_external_files(mpctx, opts->audio_files, STREAM_AUDIO);
-    open_external_files(mpctx, opts->sub_name, STREAM_SUB);
-    open_external_files(mpctx, opts->external_files, STREAM_TYPE_COUNT);
-    autoload_external_files(mpctx);
+    open_external_files(mpctx, early_files);
+    early_files = NULL;
+
+    startup_profile_phase(&mpctx->load_profile, "external-files");
 
     check_previous_track_selection(mpctx);
 
@@ -1299,10 +1570,14 @@ reopen_file:
 
     update_playback_speed(mpctx);
 
+    startup_profile_phase(&mpctx->load_profile, "track-selection");
+
     reinit_video_chain(mpctx);
     reinit_audio_chain(mpctx);
     reinit_sub_all(mpctx);
 
+    startup_profile_phase(&mpctx->load_profile, "decoder-init");
+
     if (!mpctx->vo_chain && !mpctx->ao_chain && opts->stream_auto_sel) {
         MP_FATAL(mpctx, "No video or audio streams selected.\n");
         mpctx->error_playing = MPV_ERROR_NOTHING_TO_PLAY;
@@ -1374,6 +1649,13 @@ terminate_playback:
 
     mp_abort_playback_async(mpctx);
 
+    if (early_files)
+        discard_external_batch(early_files);
+    early_files = NULL;
+
+    // Loading was aborted before the first frame, or the file is reloaded.
+    mpctx->load_profile.active = false;
+
     close_recorder(mpctx);
 
     // time to uninit all, except global stuff:
@@ -1577,7 +1859,7 @@ void close_recorder_and_error(struct MPContext *mpctx)
     close_recorder(mpctx);
     talloc_free(mpctx->opts->record_file);
     mpctx->opts->record_file = NULL;
-    mp_notify_property(mpctx, "record-file");
+    mp_notify_property_id(mpctx, MP_NOTIFY_RECORD_FILE);
     MP_ERR(mpctx, "Disabling stream recording.\n");
 }
 
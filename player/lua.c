@@ -33,6 +33,7 @@
 #include "mpv_talloc.h"
 
 #include "common/common.h"
+#include "common/mem_account.h"
 #include "options/m_property.h"
 #include "common/msg.h"
 #include "common/msg_control.h"
@@ -83,6 +84,7 @@ struct script_ctx {
     struct mp_log *log;
     struct mpv_handle *client;
     struct MPContext *mpctx;
+    int64_t mem_accounted;  // heap size last added to MP_MEM_SCRIPTS
 };
 
 #if LUA_VERSION_NUM <= 501
@@ -358,6 +360,16 @@ static int run_lua(lua_State *L)
     return 0;
 }
 
+// Update the Lua heap size in the memory accounting. Not done with a custom
+// allocator, because LuaJIT doesn't support them on all platforms.
+static void update_mem_usage(struct script_ctx *ctx, lua_State *L)
+{
+    int64_t size = L ? lua_gc(L, LUA_GCCOUNT, 0) * (int64_t)1024 +
+                       lua_gc(L, LUA_GCCOUNTB, 0) : 0;
+    mp_mem_account(MP_MEM_SCRIPTS, size - ctx->mem_accounted);
+    ctx->mem_accounted = size;
+}
+
 static int load_lua(struct mpv_handle *client, const char *fname)
 {
     struct MPContext *mpctx = mp_client_get_core(client);
@@ -394,6 +406,7 @@ static int load_lua(struct mpv_handle *client, const char *fname)
     r = 0;
 
 error_out:
+    update_mem_usage(ctx, NULL);
     if (ctx->state)
         lua_close(ctx->state);
     talloc_free(ctx);
@@ -471,6 +484,8 @@ static int script_wait_event(lua_State *L)
 {
     struct script_ctx *ctx = get_ctx(L);
 
+    update_mem_usage(ctx, L);
+
     mpv_event *event = mpv_wait_event(ctx->client, luaL_optnumber(L, 1, 1e20));
 
     lua_newtable(L); // event
@@ -907,6 +922,89 @@ static int script_get_property_native(lua_State *L)
     return 2;
 }
 
+// Push a table mapping names to error strings for all failed items, and return
+// the number of values the caller should return.
+static int push_batch_errors(lua_State *L, int num, const char **names,
+                             int *errors)
+{
+    bool failed = false;
+    for (int n = 0; n < num; n++)
+        failed |= errors[n] < 0;
+    if (!failed)
+        return 1;
+    lua_newtable(L); // res errs
+    for (int n = 0; n < num; n++) {
+        if (errors[n] < 0) {
+            lua_pushstring(L, mpv_error_string(errors[n])); // res errs err
+            lua_setfield(L, -2, names[n]); // res errs
+        }
+    }
+    return 2;
+}
+
+static int script_get_properties_native(lua_State *L)
+{
+    struct script_ctx *ctx = get_ctx(L);
+    luaL_checktype(L, 1, LUA_TTABLE);
+    void *tmp = mp_lua_PITA(L);
+
+    int num = mp_lua_len(L, 1);
+    const char **names = talloc_array(tmp, const char *, num);
+    for (int n = 0; n < num; n++) {
+        lua_rawgeti(L, 1, n + 1); // name
+        names[n] = talloc_strdup(tmp, lua_tostring(L, -1));
+        if (!names[n])
+            luaL_error(L, "property names must be strings");
+        lua_pop(L, 1);
+    }
+
+    mpv_node *nodes = talloc_zero_array(tmp, mpv_node, num);
+    int *errors = talloc_zero_array(tmp, int, num);
+    mpv_get_properties(ctx->client, num, names, MPV_FORMAT_NODE, nodes, errors);
+    lua_newtable(L); // res
+    for (int n = 0; n < num; n++) {
+        if (errors[n] >= 0) {
+            auto_free_node(tmp, &nodes[n]);
+            pushnode(L, &nodes[n]); // res val
+            lua_setfield(L, -2, names[n]); // res
+        }
+    }
+    int r = push_batch_errors(L, num, names, errors);
+    talloc_free_children(tmp);
+    return r;
+}
+
+static int script_set_properties_native(lua_State *L)
+{
+    struct script_ctx *ctx = get_ctx(L);
+    luaL_checktype(L, 1, LUA_TTABLE);
+    void *tmp = mp_lua_PITA(L);
+
+    struct mpv_node node;
+    makenode(tmp, &node, L, 1);
+    int num = 0;
+    const char **names = NULL;
+    struct mpv_node *values = NULL;
+    if (node.format == MPV_FORMAT_NODE_MAP) {
+        num = node.u.list->num;
+        names = (const char **)node.u.list->keys;
+        values = node.u.list->values;
+    } else if (node.format != MPV_FORMAT_NODE_ARRAY || node.u.list->num) {
+        luaL_error(L, "table with property names as keys expected");
+    }
+
+    int *errors = talloc_zero_array(tmp, int, num);
+    mpv_set_properties(ctx->client, num, names, MPV_FORMAT_NODE, values, errors);
+    lua_pushboolean(L, 1); // true
+    int r = push_batch_errors(L, num, names, errors);
+    if (r > 1) {
+        lua_pushnil(L); // true errs nil
+        lua_replace(L, -3); // nil errs
+    }
+    talloc_free_children(tmp);
+    return r;
+}
+
 static mpv_format check_property_format(lua_State *L, int arg)
 {
     if (lua_isnil(L, arg))
@@ -929,7 +1027,11 @@ static int script_raw_observe_property(lua_State *L)
     uint64_t id = luaL_checknumber(L, 1);
     const char *name = luaL_checkstring(L, 2);
     mpv_format format = check_property_format(L, 3);
-    return check_error(L, mpv_observe_property(ctx->client, id, name, format));
+    double interval = luaL_optnumber(L, 4, 0);
+    double delta = luaL_optnumber(L, 5, 0);
+    return check_error(L, mpv_observe_property_throttled(ctx->client, id, name,
+                                                         format, interval,
+                                                         delta));
 }
 
 static int script_raw_unobserve_property(lua_State *L)
@@ -1271,10 +1373,12 @@ static const struct fn_entry main_fns[] = {
     FN_ENTRY(get_property_bool),
     FN_ENTRY(get_property_number),
     FN_ENTRY(get_property_native),
+    FN_ENTRY(get_properties_native),
     FN_ENTRY(set_property),
     FN_ENTRY(set_property_bool),
     FN_ENTRY(set_property_number),
     FN_ENTRY(set_property_native),
+    FN_ENTRY(set_properties_native),
     FN_ENTRY(raw_observe_property),
     FN_ENTRY(raw_unobserve_property),
     FN_ENTRY(set_osd_ass),
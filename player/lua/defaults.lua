@@ -344,11 +344,12 @@ end
 local property_id = 0
 local properties = {}
 
-function mp.observe_property(name, t, cb)
+function mp.observe_property(name, t, cb, opts)
     local id = property_id + 1
     property_id = id
     properties[id] = cb
-    mp.raw_observe_property(id, name, t)
+    opts = opts or {}
+    mp.raw_observe_property(id, name, t, opts.interval, opts.delta)
 end
 
 function mp.unobserve_property(cb)
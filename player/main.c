@@ -26,7 +26,9 @@
 #include "config.h"
 #include "mpv_talloc.h"
 
+#include "misc/dir_cache.h"
 #include "misc/dispatch.h"
+#include "misc/thread_pool.h"
 #include "osdep/io.h"
 #include "osdep/terminal.h"
 #include "osdep/timer.h"
@@ -42,6 +44,7 @@
 #include "common/msg.h"
 #include "common/msg_control.h"
 #include "common/global.h"
+#include "common/tracing.h"
 #include "options/parse_configfile.h"
 #include "options/parse_commandline.h"
 #include "common/playlist.h"
@@ -130,6 +133,16 @@ void mp_update_logging(struct MPContext *mpctx, bool preinit)
         }
     }
 
+    bool trace = mpctx->opts->trace_file && mpctx->opts->trace_file[0];
+    if (trace != mpctx->tracing) {
+        if (trace) {
+            mp_tracing_start();
+        } else {
+            mp_tracing_stop();
+        }
+        mpctx->tracing = trace;
+    }
+
     if (mp_msg_has_log_file(mpctx->global) && !had_log_file)
         mp_print_version(mpctx->log, false); // for log-file=... in config files
 
@@ -183,6 +196,9 @@ void mp_destroy(struct MPContext *mpctx)
 
     command_uninit(mpctx);
 
+    mp_thread_pool_shared_unref(mpctx->thread_pool);
+    mpctx->thread_pool = NULL;
+
     mp_clients_destroy(mpctx);
 
     talloc_free(mpctx->gl_cb_ctx);
@@ -203,6 +219,16 @@ void mp_destroy(struct MPContext *mpctx)
 
     uninit_libav(mpctx->global);
 
+    mp_dispatch_log_stats(mpctx->dispatch, mpctx->log, "Core");
+
+    if (mpctx->tracing) {
+        char *path = mp_get_user_path(NULL, mpctx->global,
+                                      mpctx->opts->trace_file);
+        mp_tracing_dump(mpctx->log, path);
+        talloc_free(path);
+        mp_tracing_stop();
+    }
+
     if (mpctx->autodetach)
         pthread_detach(pthread_self());
 
@@ -331,6 +357,7 @@ struct MPContext *mp_create(void)
     pthread_mutex_init(&mpctx->lock, NULL);
 
     mpctx->global = talloc_zero(mpctx, struct mpv_global);
+    mpctx->global->dir_cache = mp_dir_cache_create(mpctx->global);
 
     // Nothing must call mp_msg*() and related before this
     mp_msg_init(mpctx->global);
@@ -382,6 +409,8 @@ int mp_initialize(struct MPContext *mpctx, char **options)
 
     assert(!mpctx->initialized);
 
+    startup_profile_begin(&mpctx->init_profile);
+
     // Preparse the command line, so we can init the terminal early.
     if (options)
         m_config_preparse_command_line(mpctx->mconfig, mpctx->global, options);
@@ -416,6 +445,12 @@ int mp_initialize(struct MPContext *mpctx, char **options)
 
     mp_input_load_config(mpctx->input);
 
+    startup_profile_phase(&mpctx->init_profile, "config");
+
+    // Scripts (including the builtin ones loaded by the option update
+    // handlers) don't need to be waited for until the first file is loaded.
+    mpctx->scripts_loading = opts->fast_start;
+
     // From this point on, all mpctx members are initialized.
     mpctx->initialized = true;
     mpctx->mconfig->option_set_callback = mp_on_set_option;
@@ -468,10 +503,19 @@ int mp_initialize(struct MPContext *mpctx, char **options)
     MP_WARN(mpctx, "There will be no OSD and no text subtitles.\n");
 #endif
 
+    startup_profile_phase(&mpctx->init_profile, "setup");
+
     mp_load_scripts(mpctx);
 
-    if (opts->force_vo == 2 && handle_force_window(mpctx, false) < 0)
-        return -1;
+    startup_profile_phase(&mpctx->init_profile, "scripts");
+
+    if (opts->force_vo == 2) {
+        if (handle_force_window(mpctx, false) < 0)
+            return -1;
+        startup_profile_phase(&mpctx->init_profile, "window");
+    }
+
+    startup_profile_end(mpctx, &mpctx->init_profile, "Initialization");
 
     MP_STATS(mpctx, "end init");
 
@@ -283,3 +283,49 @@ void merge_playlist_files(struct playlist *pl)
     playlist_add_file(pl, edl);
     talloc_free(edl);
 }
+
+void startup_profile_begin(struct startup_profile *p)
+{
+    *p = (struct startup_profile){
+        .start = mp_time_sec(),
+        .active = true,
+    };
+    p->last = p->start;
+}
+
+// End the current phase (which started at the end of the previous phase).
+void startup_profile_phase(struct startup_profile *p, const char *name)
+{
+    startup_profile_phase_at(p, name, mp_time_sec());
+}
+
+// Like startup_profile_phase(), but the phase ended at the given mp_time_sec()
+// time, e.g. as recorded by another thread. (Clamped to the current phase.)
+void startup_profile_phase_at(struct startup_profile *p, const char *name,
+                              double time)
+{
+    if (!p->active || p->num_phases >= MAX_STARTUP_PHASES)
+        return;
+    time = MPCLAMP(time, p->last, mp_time_sec());
+    p->phases[p->num_phases].name = name;
+    p->phases[p->num_phases].duration = time - p->last;
+    p->num_phases++;
+    p->last = time;
+}
+
+// Stop recording, and log a summary.
+void startup_profile_end(struct MPContext *mpctx, struct startup_profile *p,
+                         const char *title)
+{
+    if (!p->active)
+        return;
+    p->active = false;
+    char *s = talloc_asprintf(NULL, "%s took %.1f ms:", title,
+                              (p->last - p->start) * 1e3);
+    for (int n = 0; n < p->num_phases; n++) {
+        s = talloc_asprintf_append(s, " %s %.1f", p->phases[n].name,
+                                   p->phases[n].duration * 1e3);
+    }
+    MP_VERBOSE(mpctx, "%s\n", s);
+    talloc_free(s);
+}
@@ -28,10 +28,13 @@
 #include "options/options.h"
 #include "common/common.h"
 #include "common/encode.h"
+#include "common/mem_account.h"
+#include "common/perf_counters.h"
 #include "common/recorder.h"
 #include "options/m_config.h"
 #include "options/m_property.h"
 #include "common/playlist.h"
+#include "common/tracing.h"
 #include "input/input.h"
 
 #include "misc/dispatch.h"
@@ -170,6 +173,7 @@ void set_pause_state(struct MPContext *mpctx, bool user_pause)
             mpctx->step_frames = 0;
             mpctx->time_frame -= get_relative_time(mpctx);
         } else {
+            sync_backstep_frame(mpctx);
             (void)get_relative_time(mpctx); // ignore time that passed during pause
         }
     }
@@ -199,6 +203,8 @@ void add_step_frame(struct MPContext *mpctx, int dir)
 {
     if (!mpctx->vo_chain)
         return;
+    if (step_backstep_frame(mpctx, dir))
+        return;
     if (dir > 0) {
         mpctx->step_frames += 1;
         set_pause_state(mpctx, false);
@@ -288,6 +294,13 @@ static void mp_seek(MPContext *mpctx, struct seek_params seek)
     default: abort();
     }
 
+    // When scrubbing, only go to the keyframe at or before the target, and
+    // remember the real target for when scrubbing ends.
+    if (opts->seek_scrubbing && seek.type != MPSEEK_BACKSTEP) {
+        mpctx->scrub_seek_pts = seek_pts;
+        seek.exact = MPSEEK_KEYFRAME;
+    }
+
     double demux_pts = seek_pts;
 
     bool hr_seek = opts->correct_pts && seek.exact != MPSEEK_KEYFRAME &&
@@ -377,6 +390,30 @@ static void mp_seek(MPContext *mpctx, struct seek_params seek)
     mpctx->ab_loop_clip = mpctx->last_seek_pts < opts->ab_loop[1];
 
     mpctx->current_seek = seek;
+    if (!seek.start_time) // internal seek, not queued with queue_seek()
+        mpctx->current_seek.start_time = mpctx->start_timestamp;
+}
+
+// Called when --seek-scrubbing is changed. Scrubbing only decodes keyframes,
+// so leaving it does an exact seek to the last target the user scrubbed to.
+void update_seek_scrubbing(struct MPContext *mpctx)
+{
+    // Setting the option to its current value also ends up here.
+    if (mpctx->scrubbing == mpctx->opts->seek_scrubbing)
+        return;
+    mpctx->scrubbing = mpctx->opts->seek_scrubbing;
+
+    if (mpctx->scrubbing || !mpctx->demuxer)
+        return;
+
+    double pts = mpctx->scrub_seek_pts;
+    mpctx->scrub_seek_pts = MP_NOPTS_VALUE;
+    if (pts != MP_NOPTS_VALUE) {
+        queue_seek(mpctx, MPSEEK_ABSOLUTE, pts, MPSEEK_EXACT, 0);
+    } else {
+        // Non-keyframes were skipped by the decoder; resync.
+        issue_refresh_seek(mpctx, MPSEEK_EXACT);
+    }
 }
 
 // This combines consecutive seek requests.
@@ -390,9 +427,14 @@ void queue_seek(struct MPContext *mpctx, enum seek_type type, double amount,
     if (mpctx->stop_play == AT_END_OF_FILE)
         mpctx->stop_play = KEEP_PLAYING;
 
+    // Measure the seek latency from the first request, even if more seeks
+    // are merged into it before it's executed.
+    double start_time = seek->type ? seek->start_time : mp_time_sec();
+
     switch (type) {
     case MPSEEK_RELATIVE:
         seek->flags |= flags;
+        seek->start_time = start_time;
         if (seek->type == MPSEEK_FACTOR)
             return;  // Well... not common enough to bother doing better
         seek->amount += amount;
@@ -411,6 +453,7 @@ void queue_seek(struct MPContext *mpctx, enum seek_type type, double amount,
             .amount = amount,
             .exact = exact,
             .flags = flags,
+            .start_time = start_time,
         };
         return;
     case MPSEEK_NONE:
@@ -430,8 +473,15 @@ void execute_queued_seek(struct MPContext *mpctx)
          * try to finish showing a frame from one location before doing
          * another seek (which could lead to unchanging display). */
         bool delay = mpctx->seek.flags & MPSEEK_FLAG_DELAY;
+        double max_delay = 0.3;
+        // When scrubbing, always wait for the previous seek to show a frame.
+        // Seeks queued meanwhile are coalesced to the newest target.
+        if (mpctx->opts->seek_scrubbing) {
+            delay = true;
+            max_delay = 1.0;
+        }
         if (delay && mpctx->video_status < STATUS_PLAYING &&
-            mp_time_sec() - mpctx->start_timestamp < 0.3)
+            mp_time_sec() - mpctx->start_timestamp < max_delay)
             return;
         mp_seek(mpctx, mpctx->seek);
         mpctx->seek = (struct seek_params){0};
@@ -596,6 +646,48 @@ static void handle_osd_redraw(struct MPContext *mpctx)
     vo_redraw(mpctx->video_out);
 }
 
+// Make caches drop data while the accounted memory is over the soft limit.
+// The low memory state is left only at 90% of the limit, so that the demuxer
+// doesn't fill and drop its backbuffer on every other packet.
+static void handle_memory_limit(struct MPContext *mpctx)
+{
+    int64_t limit = mpctx->opts->memory_soft_limit * (int64_t)(1024 * 1024);
+    int64_t usage = mp_mem_get_total_usage();
+    bool low = limit > 0 &&
+               (usage > limit || (mpctx->low_memory && usage > limit / 10 * 9));
+
+    if (low != mpctx->low_memory) {
+        MP_VERBOSE(mpctx, "%s low memory state (%"PRId64" MiB in use).\n",
+                   low ? "Entering" : "Leaving", usage / (1024 * 1024));
+    }
+    // (Also for demuxers opened while the state was active.)
+    if (mpctx->demuxer && (low || low != mpctx->low_memory))
+        demux_set_low_memory(mpctx->demuxer, low);
+    mpctx->low_memory = low;
+}
+
+// Write the performance counters to the --dump-stats file once per second.
+static void handle_perf_counters(struct MPContext *mpctx)
+{
+    if (!mp_msg_test(mpctx->log, MSGL_STATS))
+        return;
+
+    double now = mp_time_sec();
+    if (now < mpctx->next_perf_dump) {
+        mp_set_timeout(mpctx, mpctx->next_perf_dump - now);
+        return;
+    }
+    mpctx->next_perf_dump = now + 1;
+    mp_set_timeout(mpctx, 1);
+
+    uint64_t values[MP_PERF_MAX_COUNTERS];
+    int num = mp_perf_counters_get(values);
+    for (int n = 0; n < num; n++) {
+        MP_STATS(mpctx, "value %f perf-%s", (double)values[n],
+                 mp_perf_counter_name(n));
+    }
+}
+
 static void handle_pause_on_low_cache(struct MPContext *mpctx)
 {
     bool force_update = false;
@@ -867,20 +959,8 @@ int handle_force_window(struct MPContext *mpctx, bool force)
     if (mpctx->opts->force_vo != 2 && !act)
         return 0;
 
-    if (!mpctx->video_out) {
-        struct vo_extra ex = {
-            .input_ctx = mpctx->input,
-            .osd = mpctx->osd,
-            .encode_lavc_ctx = mpctx->encode_lavc_ctx,
-            .opengl_cb_context = mpctx->gl_cb_ctx,
-            .wakeup_cb = mp_wakeup_core_cb,
-            .wakeup_ctx = mpctx,
-        };
-        mpctx->video_out = init_best_video_out(mpctx->global, &ex);
-        if (!mpctx->video_out)
-            goto err;
-        mpctx->mouse_cursor_visible = true;
-    }
+    if (!init_video_out(mpctx))
+        goto err;
 
     if (!mpctx->video_out->config_ok || force) {
         struct vo *vo = mpctx->video_out;
@@ -973,8 +1053,17 @@ static void handle_playback_restart(struct MPContext *mpctx)
     }
 
     if (!mpctx->restart_complete) {
+        if (mpctx->current_seek.type) {
+            mpctx->last_seek_latency =
+                mp_time_sec() - mpctx->current_seek.start_time;
+            MP_STATS(mpctx, "value %f seek-latency", mpctx->last_seek_latency);
+            MP_VERBOSE(mpctx, "seek to display took %.3f seconds\n",
+                       mpctx->last_seek_latency);
+        }
         mpctx->hrseek_active = false;
         mpctx->restart_complete = true;
+        startup_profile_phase(&mpctx->load_profile, "first-frame");
+        startup_profile_end(mpctx, &mpctx->load_profile, "Loading");
         mpctx->current_seek = (struct seek_params){0};
         mpctx->audio_allow_second_chance_seek = false;
         handle_playback_time(mpctx);
@@ -1066,6 +1155,8 @@ void run_playloop(struct MPContext *mpctx)
     }
 #endif
 
+    mp_trace_begin("playloop");
+
     update_demuxer_properties(mpctx);
 
     handle_complex_filter_decoders(mpctx);
@@ -1081,8 +1172,13 @@ void run_playloop(struct MPContext *mpctx)
             mpctx->stop_play = AT_END_OF_FILE;
     }
 
+    mp_trace_begin("fill-audio");
     fill_audio_out_buffers(mpctx);
+    mp_trace_end("fill-audio");
+
+    mp_trace_begin("write-video");
     write_video(mpctx);
+    mp_trace_end("write-video");
 
     handle_playback_restart(mpctx);
 
@@ -1104,15 +1200,25 @@ void run_playloop(struct MPContext *mpctx)
 
     update_core_idle_state(mpctx);
 
-    if (mpctx->stop_play)
+    if (mpctx->stop_play) {
+        mp_trace_end("playloop");
         return;
+    }
 
     handle_osd_redraw(mpctx);
 
+    mp_trace_end("playloop");
+
     mp_wait_events(mpctx);
 
+    mp_trace_begin("playloop-input");
+
     handle_pause_on_low_cache(mpctx);
 
+    handle_memory_limit(mpctx);
+
+    handle_perf_counters(mpctx);
+
     mp_process_input(mpctx);
 
     handle_chapter_change(mpctx);
@@ -1120,6 +1226,8 @@ void run_playloop(struct MPContext *mpctx)
     handle_force_window(mpctx, false);
 
     execute_queued_seek(mpctx);
+
+    mp_trace_end("playloop-input");
 }
 
 void mp_idle(struct MPContext *mpctx)
@@ -1145,6 +1253,7 @@ void idle_loop(struct MPContext *mpctx)
         if (need_reinit) {
             uninit_audio_out(mpctx);
             handle_force_window(mpctx, true);
+            mp_wait_scripts_loaded(mpctx);
             mp_wakeup_core(mpctx);
             mp_notify(mpctx, MPV_EVENT_IDLE, NULL);
             need_reinit = false;
@@ -149,12 +149,27 @@ int mp_load_script(struct MPContext *mpctx, const char *fname)
         return -1;
     }
 
-    wait_loaded(mpctx);
-    MP_VERBOSE(mpctx, "Done loading %s.\n", fname);
+    // With --fast-start, scripts initialize concurrently with each other and
+    // with the start of file loading; see mp_wait_scripts_loaded().
+    if (!mpctx->scripts_loading) {
+        wait_loaded(mpctx);
+        MP_VERBOSE(mpctx, "Done loading %s.\n", fname);
+    }
 
     return 0;
 }
 
+// Wait until the scripts started in --fast-start mode have initialized (and,
+// for example, registered their hooks).
+void mp_wait_scripts_loaded(struct MPContext *mpctx)
+{
+    if (mpctx->scripts_loading) {
+        wait_loaded(mpctx);
+        MP_VERBOSE(mpctx, "Done loading scripts.\n");
+        mpctx->scripts_loading = false;
+    }
+}
+
 int mp_load_user_script(struct MPContext *mpctx, const char *fname)
 {
     char *path = mp_get_user_path(NULL, mpctx->global, fname);
@@ -228,6 +228,113 @@ static void vo_chain_reset_state(struct vo_chain *vo_c)
         vo_c->input_mpi = mp_image_new_ref(vo_c->cached_coverart);
 }
 
+static void clear_backstep_frames(struct MPContext *mpctx)
+{
+    for (int n = 0; n < mpctx->num_backstep_frames; n++)
+        talloc_free(mpctx->backstep_frames[n]);
+    mpctx->num_backstep_frames = 0;
+    mpctx->backstep_pos = 0;
+}
+
+// Remember a frame for --video-backstep-cache. Frames must be added in display
+// order, without skipping frames.
+static void add_backstep_frame(struct MPContext *mpctx, struct mp_image *img)
+{
+    int max = mpctx->opts->video_backstep_cache;
+    if (max < 1 || img->pts == MP_NOPTS_VALUE ||
+        IMGFMT_IS_HWACCEL(img->imgfmt))
+    {
+        clear_backstep_frames(mpctx);
+        return;
+    }
+
+    if (mpctx->num_backstep_frames) {
+        double last_pts = mpctx->backstep_frames[0]->pts;
+        if (img->pts == last_pts)
+            return; // already added (hr-seek backstep target)
+        if (img->pts < last_pts)
+            clear_backstep_frames(mpctx); // discontinuity
+    }
+
+    struct mp_image *ref = mp_image_new_ref(img);
+    if (!ref)
+        return;
+
+    while (mpctx->num_backstep_frames >= max) {
+        mpctx->num_backstep_frames -= 1;
+        talloc_free(mpctx->backstep_frames[mpctx->num_backstep_frames]);
+    }
+    MP_TARRAY_INSERT_AT(mpctx, mpctx->backstep_frames,
+                        mpctx->num_backstep_frames, 0, ref);
+}
+
+// Display backstep_frames[pos] as still frame. Returns false if that's not
+// possible right now.
+static bool show_backstep_frame(struct MPContext *mpctx, int pos)
+{
+    struct vo *vo = mpctx->video_out;
+    struct mp_image *img = mpctx->backstep_frames[pos];
+
+    if (!vo->params || !mp_image_params_equal(&img->params, vo->params))
+        return false;
+
+    vo_wait_frame(vo);
+    if (!vo_is_ready_for_frame(vo, -1))
+        return false;
+
+    struct vo_frame dummy = {
+        .pts = mp_time_us(),
+        .duration = -1,
+        .still = true,
+        .num_frames = 1,
+        .num_vsyncs = 1,
+        .frames = {img},
+    };
+    vo_queue_frame(vo, vo_frame_ref(&dummy));
+
+    mpctx->backstep_pos = pos;
+    mpctx->video_pts = img->pts;
+    mpctx->last_vo_pts = img->pts;
+    mpctx->playback_pts = img->pts;
+
+    update_subtitles(mpctx, img->pts);
+    mpctx->osd_force_update = true;
+    mp_notify(mpctx, MPV_EVENT_TICK, NULL);
+    mp_wakeup_core(mpctx);
+    return true;
+}
+
+// Step one frame back (dir<0) or forward (dir>0) within the frames kept by
+// --video-backstep-cache. Returns true if this was possible; otherwise the
+// caller has to step by seeking or decoding.
+bool step_backstep_frame(struct MPContext *mpctx, int dir)
+{
+    if (!mpctx->vo_chain || mpctx->vo_chain->is_coverart ||
+        mpctx->video_status < STATUS_READY || mpctx->seek.type)
+        return false;
+
+    int pos = mpctx->backstep_pos + (dir < 0 ? 1 : -1);
+    if (pos < 0 || pos >= mpctx->num_backstep_frames)
+        return false;
+
+    // Cached frames are only navigated while paused (unpausing resyncs).
+    set_pause_state(mpctx, true);
+
+    MP_VERBOSE(mpctx, "Stepping to cached frame %d.\n", pos);
+    return show_backstep_frame(mpctx, pos);
+}
+
+// If a frame from the backstep cache is displayed, make the decoder continue
+// from this frame. Must be called before resuming playback.
+void sync_backstep_frame(struct MPContext *mpctx)
+{
+    if (mpctx->backstep_pos > 0) {
+        double pts = mpctx->backstep_frames[mpctx->backstep_pos]->pts;
+        mpctx->backstep_pos = 0;
+        queue_seek(mpctx, MPSEEK_ABSOLUTE, pts, MPSEEK_VERY_EXACT, 0);
+    }
+}
+
 void reset_video_state(struct MPContext *mpctx)
 {
     if (mpctx->vo_chain)
@@ -237,6 +344,7 @@ void reset_video_state(struct MPContext *mpctx)
         mp_image_unrefp(&mpctx->next_frames[n]);
     mpctx->num_next_frames = 0;
     mp_image_unrefp(&mpctx->saved_frame);
+    clear_backstep_frames(mpctx);
 
     mpctx->delay = 0;
     mpctx->time_frame = 0;
@@ -354,11 +462,9 @@ void reinit_video_chain(struct MPContext *mpctx)
     reinit_video_chain_src(mpctx, track);
 }
 
-// (track=NULL creates a blank chain, used for lavfi-complex)
-void reinit_video_chain_src(struct MPContext *mpctx, struct track *track)
+// Create the VO, if it doesn't exist yet. Returns false on failure.
+bool init_video_out(struct MPContext *mpctx)
 {
-    assert(!mpctx->vo_chain);
-
     if (!mpctx->video_out) {
         struct vo_extra ex = {
             .input_ctx = mpctx->input,
@@ -369,14 +475,24 @@ void reinit_video_chain_src(struct MPContext *mpctx, struct track *track)
             .wakeup_ctx = mpctx,
         };
         mpctx->video_out = init_best_video_out(mpctx->global, &ex);
-        if (!mpctx->video_out) {
-            MP_FATAL(mpctx, "Error opening/initializing "
-                    "the selected video_out (--vo) device.\n");
-            mpctx->error_playing = MPV_ERROR_VO_INIT_FAILED;
-            goto err_out;
-        }
+        if (!mpctx->video_out)
+            return false;
         mpctx->mouse_cursor_visible = true;
     }
+    return true;
+}
+
+// (track=NULL creates a blank chain, used for lavfi-complex)
+void reinit_video_chain_src(struct MPContext *mpctx, struct track *track)
+{
+    assert(!mpctx->vo_chain);
+
+    if (!init_video_out(mpctx)) {
+        MP_FATAL(mpctx, "Error opening/initializing "
+                "the selected video_out (--vo) device.\n");
+        mpctx->error_playing = MPV_ERROR_VO_INIT_FAILED;
+        goto err_out;
+    }
 
     update_window_title(mpctx, true);
 
@@ -484,6 +600,7 @@ static int decode_image(struct MPContext *mpctx)
         video_set_start(d_video, hrseek ? mpctx->hrseek_pts : MP_NOPTS_VALUE);
 
         video_set_framedrop(d_video, check_framedrop(mpctx, vo_c));
+        video_set_keyframes_only(d_video, mpctx->opts->seek_scrubbing);
 
         video_work(d_video);
         res = video_get_frame(d_video, &vo_c->input_mpi);
@@ -765,6 +882,10 @@ static int video_output_image(struct MPContext *mpctx)
                 /* just skip - but save if backstep active */
                 if (mpctx->hrseek_backstep)
                     mp_image_setrefp(&mpctx->saved_frame, img);
+                // Without framedrop, this refills the backstep cache with
+                // the frames between the keyframe and the seek target.
+                if (!mpctx->hrseek_framedrop)
+                    add_backstep_frame(mpctx, img);
             } else if (mpctx->video_status == STATUS_SYNCING &&
                        mpctx->playback_pts != MP_NOPTS_VALUE &&
                        img->pts < mpctx->playback_pts && !vo_c->is_coverart)
@@ -1385,6 +1506,9 @@ void write_video(struct MPContext *mpctx)
     mpctx->osd_force_update = true;
     update_osd_msg(mpctx);
 
+    // (Before queuing: the VO owns and may free the frame after that.)
+    add_backstep_frame(mpctx, frame->frames[0]);
+
     vo_queue_frame(vo, frame);
 
     // The frames were shifted down; "initialize" the new first entry.
@@ -52,6 +52,7 @@
 #include "osdep/timer.h"
 #include "osdep/threads.h"
 
+#include "common/mem_account.h"
 #include "common/msg.h"
 #include "common/tags.h"
 #include "options/options.h"
@@ -402,6 +403,7 @@ static int resize_cache(struct priv *s, int64_t size)
     }
 
     free(s->buffer);
+    mp_mem_account(MP_MEM_STREAM_CACHE, buffer_size - s->buffer_size);
 
     s->buffer_size = buffer_size;
     s->buffer = buffer;
@@ -716,6 +718,7 @@ static void cache_uninit(stream_t *cache)
     pthread_mutex_destroy(&s->mutex);
     pthread_cond_destroy(&s->wakeup);
     free(s->buffer);
+    mp_mem_account(MP_MEM_STREAM_CACHE, -s->buffer_size);
     talloc_free(s);
 }
 
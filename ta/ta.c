@@ -14,6 +14,7 @@
  */
 
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 #include <stdio.h>
 #include <assert.h>
@@ -64,11 +65,48 @@ struct ta_ext_header {
     struct ta_header *header;  // points back to normal header
     struct ta_header children; // list of children, with this as sentinel
     void (*destructor)(void *);
+    struct ta_arena *arena;    // arena new children are allocated from
 };
 
 // ta_ext_header.children.size is set to this
 #define CHILDREN_SENTINEL ((size_t)-1)
 
+/* Arenas:
+ *
+ * All allocations that (recursively) have an arena context as parent are
+ * carved from large chunks owned by the arena. Such an allocation stores the
+ * arena as ta_header.ext, tagged with ARENA_TAG, until it gets a real extended
+ * header (which is allocated from the arena as well, and points to the arena).
+ * The arena context itself is a normal allocation.
+ *
+ * Freeing an arena allocation returns its memory only if it was the most
+ * recent allocation. Freeing all children of the arena context releases all
+ * chunks. This doesn't need to visit the children, unless there could be a
+ * destructor, or a non-arena allocation in the tree (needs_walk).
+ */
+#define ARENA_TAG ((uintptr_t)1)
+
+#define ARENA_MIN_CHUNK 4096
+#define ARENA_MAX_CHUNK (256 * 1024)
+
+struct arena_chunk {
+    struct arena_chunk *next;
+    size_t size;
+};
+
+#define CHUNK_HEADER_SIZE \
+    ((sizeof(struct arena_chunk) + MIN_ALIGN - 1) & ~(size_t)(MIN_ALIGN - 1))
+
+struct ta_arena {
+    struct ta_header *owner;        // the arena context
+    struct arena_chunk *chunks;     // all chunks
+    struct arena_chunk *current;    // chunk new allocations are taken from
+    char *pos, *end;                // free space in current
+    char *last;                     // most recent allocation in current
+    size_t next_chunk_size;
+    bool needs_walk;
+};
+
 static void ta_dbg_add(struct ta_header *h);
 static void ta_dbg_check_header(struct ta_header *h);
 static void ta_dbg_remove(struct ta_header *h);
@@ -80,29 +118,138 @@ static struct ta_header *get_header(void *ptr)
     return h;
 }
 
+static bool is_arena_tag(struct ta_header *h)
+{
+    return (uintptr_t)h->ext & ARENA_TAG;
+}
+
+// Return the real extended header, or NULL.
+static struct ta_ext_header *get_ext(struct ta_header *h)
+{
+    return is_arena_tag(h) ? NULL : h->ext;
+}
+
+// Return the arena children of h are allocated from, or NULL.
+static struct ta_arena *get_arena(struct ta_header *h)
+{
+    if (is_arena_tag(h))
+        return (struct ta_arena *)((uintptr_t)h->ext & ~ARENA_TAG);
+    return h->ext ? h->ext->arena : NULL;
+}
+
+// Return the arena h was allocated from, or NULL.
+static struct ta_arena *get_owning_arena(struct ta_header *h)
+{
+    struct ta_arena *arena = get_arena(h);
+    return arena && arena->owner != h ? arena : NULL;
+}
+
+static bool arena_new_chunk(struct ta_arena *a, size_t min_size)
+{
+    size_t size = a->next_chunk_size;
+    bool large = min_size > size / 4;
+    if (large)
+        size = min_size;
+    struct arena_chunk *c = malloc(CHUNK_HEADER_SIZE + size);
+    if (!c)
+        return false;
+    c->next = a->chunks;
+    c->size = size;
+    a->chunks = c;
+    if (!large) {
+        a->current = c;
+        a->pos = (char *)c + CHUNK_HEADER_SIZE;
+        a->end = a->pos + size;
+        a->last = NULL;
+        if (a->next_chunk_size < ARENA_MAX_CHUNK)
+            a->next_chunk_size *= 2;
+    }
+    return true;
+}
+
+static void *arena_alloc(struct ta_arena *a, size_t size)
+{
+    if (size > ((size_t)-1) / 4)
+        return NULL;
+    size = (size + MIN_ALIGN - 1) & ~(size_t)(MIN_ALIGN - 1);
+    if (size > a->end - a->pos) {
+        if (!arena_new_chunk(a, size))
+            return NULL;
+        // Large allocations get a chunk of their own.
+        if (size > a->end - a->pos)
+            return (char *)a->chunks + CHUNK_HEADER_SIZE;
+    }
+    a->last = a->pos;
+    a->pos += size;
+    return a->last;
+}
+
+// Free the memory of the allocation h, if possible.
+static void arena_release(struct ta_arena *a, struct ta_header *h)
+{
+    if ((char *)h == a->last) {
+        a->pos = a->last;
+        a->last = NULL;
+    }
+}
+
+// Free all chunks, except the current one if keep_current is set.
+static void arena_reset(struct ta_arena *a, bool keep_current)
+{
+    struct arena_chunk *keep = keep_current ? a->current : NULL;
+    while (a->chunks) {
+        struct arena_chunk *c = a->chunks;
+        a->chunks = c->next;
+        if (c != keep)
+            free(c);
+    }
+    a->chunks = a->current = keep;
+    a->pos = a->end = a->last = NULL;
+    if (keep) {
+        keep->next = NULL;
+        a->pos = (char *)keep + CHUNK_HEADER_SIZE;
+        a->end = a->pos + keep->size;
+    }
+    a->needs_walk = false;
+}
+
 static struct ta_ext_header *get_or_alloc_ext_header(void *ptr)
 {
     struct ta_header *h = get_header(ptr);
     if (!h)
         return NULL;
-    if (!h->ext) {
-        h->ext = malloc(sizeof(struct ta_ext_header));
-        if (!h->ext)
+    if (!get_ext(h)) {
+        struct ta_arena *arena = get_arena(h);
+        struct ta_ext_header *eh = arena ? arena_alloc(arena, sizeof(*eh))
+                                         : malloc(sizeof(*eh));
+        if (!eh)
             return NULL;
-        *h->ext = (struct ta_ext_header) {
+        *eh = (struct ta_ext_header) {
             .header = h,
             .children = {
-                .next = &h->ext->children,
-                .prev = &h->ext->children,
+                .next = &eh->children,
+                .prev = &eh->children,
                 // Needed by ta_find_parent():
                 .size = CHILDREN_SENTINEL,
-                .ext = h->ext,
+                .ext = eh,
             },
+            .arena = arena,
         };
+        h->ext = eh;
     }
     return h->ext;
 }
 
+// Link to new parent - insert at end of list (possibly orders destructors)
+static void link_child(struct ta_ext_header *parent_eh, struct ta_header *ch)
+{
+    struct ta_header *children = &parent_eh->children;
+    ch->next = children;
+    ch->prev = children->prev;
+    children->prev->next = ch;
+    children->prev = ch;
+}
+
 /* Set the parent allocation of ptr. If parent==NULL, remove the parent.
  * Setting parent==NULL (with ptr!=NULL) always succeeds, and unsets the
  * parent of ptr. Operations ptr==NULL always succeed and do nothing.
@@ -120,23 +267,45 @@ bool ta_set_parent(void *ptr, void *ta_parent)
     struct ta_ext_header *parent_eh = get_or_alloc_ext_header(ta_parent);
     if (ta_parent && !parent_eh) // do nothing on OOM
         return false;
+    struct ta_arena *parent_arena = parent_eh ? parent_eh->arena : NULL;
+    struct ta_arena *arena = get_owning_arena(ch);
+    if (arena) {
+        // Can't move arena memory out of the arena.
+        assert(arena == parent_arena);
+        if (arena != parent_arena)
+            return false;
+    } else if (parent_arena) {
+        parent_arena->needs_walk = true;
+    }
     // Unlink from previous parent
     if (ch->next) {
         ch->next->prev = ch->prev;
         ch->prev->next = ch->next;
         ch->next = ch->prev = NULL;
     }
-    // Link to new parent - insert at end of list (possibly orders destructors)
-    if (parent_eh) {
-        struct ta_header *children = &parent_eh->children;
-        ch->next = children;
-        ch->prev = children->prev;
-        children->prev->next = ch;
-        children->prev = ch;
-    }
+    if (parent_eh)
+        link_child(parent_eh, ch);
     return true;
 }
 
+static void *arena_alloc_size(struct ta_arena *a, void *ta_parent, size_t size)
+{
+    // (Before allocating, so that the new allocation can be resized in place.)
+    struct ta_ext_header *parent_eh = get_or_alloc_ext_header(ta_parent);
+    if (!parent_eh)
+        return NULL;
+    struct ta_header *h = arena_alloc(a, sizeof(union aligned_header) + size);
+    if (!h)
+        return NULL;
+    *h = (struct ta_header) {
+        .size = size,
+        .ext = (struct ta_ext_header *)((uintptr_t)a | ARENA_TAG),
+    };
+    ta_dbg_add(h);
+    link_child(parent_eh, h);
+    return PTR_FROM_HEADER(h);
+}
+
 /* Allocate size bytes of memory. If ta_parent is not NULL, this is used as
  * parent allocation (if ta_parent is freed, this allocation is automatically
  * freed as well). size==0 allocates a block of size 0 (i.e. returns non-NULL).
@@ -146,6 +315,10 @@ void *ta_alloc_size(void *ta_parent, size_t size)
 {
     if (size >= MAX_ALLOC)
         return NULL;
+    struct ta_header *ph = get_header(ta_parent);
+    struct ta_arena *arena = ph ? get_arena(ph) : NULL;
+    if (arena)
+        return arena_alloc_size(arena, ta_parent, size);
     struct ta_header *h = malloc(sizeof(union aligned_header) + size);
     if (!h)
         return NULL;
@@ -166,6 +339,14 @@ void *ta_zalloc_size(void *ta_parent, size_t size)
 {
     if (size >= MAX_ALLOC)
         return NULL;
+    struct ta_header *ph = get_header(ta_parent);
+    struct ta_arena *arena = ph ? get_arena(ph) : NULL;
+    if (arena) {
+        void *ptr = arena_alloc_size(arena, ta_parent, size);
+        if (ptr)
+            memset(ptr, 0, size);
+        return ptr;
+    }
     struct ta_header *h = calloc(1, sizeof(union aligned_header) + size);
     if (!h)
         return NULL;
@@ -179,6 +360,47 @@ void *ta_zalloc_size(void *ta_parent, size_t size)
     return ptr;
 }
 
+// Update the links pointing to h after it was moved.
+static void relink(struct ta_header *h)
+{
+    if (h->next) {
+        // Relink siblings
+        h->next->prev = h;
+        h->prev->next = h;
+    }
+    struct ta_ext_header *eh = get_ext(h);
+    if (eh) {
+        // Relink children
+        eh->header = h;
+        eh->children.next->prev = &eh->children;
+        eh->children.prev->next = &eh->children;
+    }
+}
+
+static void *arena_realloc(struct ta_arena *a, struct ta_header *h, size_t size)
+{
+    size_t full = sizeof(union aligned_header) + size;
+    // Resize in place if this is the most recent allocation, or if shrinking.
+    if ((char *)h == a->last && full <= a->end - a->last) {
+        a->pos = a->last + ((full + MIN_ALIGN - 1) & ~(size_t)(MIN_ALIGN - 1));
+        h->size = size;
+        return PTR_FROM_HEADER(h);
+    }
+    if (size < h->size) {
+        h->size = size;
+        return PTR_FROM_HEADER(h);
+    }
+    struct ta_header *new_h = arena_alloc(a, full);
+    if (!new_h)
+        return NULL;
+    memcpy(new_h, h, sizeof(union aligned_header) + h->size);
+    ta_dbg_remove(h);
+    ta_dbg_add(new_h);
+    new_h->size = size;
+    relink(new_h);
+    return PTR_FROM_HEADER(new_h);
+}
+
 /* Reallocate the allocation given by ptr and return a new pointer. Much like
  * realloc(), the returned pointer can be different, and on OOM, NULL is
  * returned.
@@ -205,25 +427,17 @@ void *ta_realloc_size(void *ta_parent, void *ptr, size_t size)
     struct ta_header *old_h = h;
     if (h->size == size)
         return ptr;
+    struct ta_arena *arena = get_owning_arena(h);
+    if (arena)
+        return arena_realloc(arena, h, size);
     ta_dbg_remove(h);
     h = realloc(h, sizeof(union aligned_header) + size);
     ta_dbg_add(h ? h : old_h);
     if (!h)
         return NULL;
     h->size = size;
-    if (h != old_h) {
-        if (h->next) {
-            // Relink siblings
-            h->next->prev = h;
-            h->prev->next = h;
-        }
-        if (h->ext) {
-            // Relink children
-            h->ext->header = h;
-            h->ext->children.next->prev = &h->ext->children;
-            h->ext->children.prev->next = &h->ext->children;
-        }
-    }
+    if (h != old_h)
+        relink(h);
     return PTR_FROM_HEADER(h);
 }
 
@@ -243,11 +457,20 @@ size_t ta_get_size(void *ptr)
 void ta_free_children(void *ptr)
 {
     struct ta_header *h = get_header(ptr);
-    struct ta_ext_header *eh = h ? h->ext : NULL;
+    struct ta_ext_header *eh = h ? get_ext(h) : NULL;
     if (!eh)
         return;
-    while (eh->children.next != &eh->children)
-        ta_free(PTR_FROM_HEADER(eh->children.next));
+    struct ta_arena *arena = eh->arena && eh->arena->owner == h ? eh->arena
+                                                                : NULL;
+    if (arena && !arena->needs_walk) {
+        // All children are plain arena memory.
+        eh->children.next = eh->children.prev = &eh->children;
+    } else {
+        while (eh->children.next != &eh->children)
+            ta_free(PTR_FROM_HEADER(eh->children.next));
+    }
+    if (arena)
+        arena_reset(arena, true);
 }
 
 /* Free the given allocation, and all of its direct and indirect children.
@@ -257,8 +480,9 @@ void ta_free(void *ptr)
     struct ta_header *h = get_header(ptr);
     if (!h)
         return;
-    if (h->ext && h->ext->destructor)
-        h->ext->destructor(ptr);
+    struct ta_ext_header *eh = get_ext(h);
+    if (eh && eh->destructor)
+        eh->destructor(ptr);
     ta_free_children(ptr);
     if (h->next) {
         // Unlink from sibling list
@@ -266,7 +490,14 @@ void ta_free(void *ptr)
         h->prev->next = h->next;
     }
     ta_dbg_remove(h);
-    free(h->ext);
+    struct ta_arena *arena = get_owning_arena(h);
+    if (arena) {
+        arena_release(arena, h);
+        return;
+    }
+    if (eh && eh->arena)
+        arena_reset(eh->arena, false); // h is the arena context
+    free(eh);
     free(h);
 }
 
@@ -288,9 +519,43 @@ bool ta_set_destructor(void *ptr, void (*destructor)(void *))
     if (!eh)
         return false;
     eh->destructor = destructor;
+    if (destructor && eh->arena && eh->arena->owner != eh->header)
+        eh->arena->needs_walk = true;
     return true;
 }
 
+/* Create an empty allocation like ta_new_context(), whose children (and their
+ * children, recursively) are allocated from large chunks of memory. This is
+ * much faster for many small allocations that are freed together, such as
+ * temporary contexts. Freeing such an allocation returns its memory only if
+ * it was the last allocation; the memory is released when the arena context
+ * is freed, or when ta_free_children() is called on it.
+ *
+ * Restrictions: allocations made from an arena can't be moved out of it with
+ * ta_set_parent() (this fails). ta_realloc_size() on an allocation which is
+ * not the most recent one copies the data, and wastes the old memory.
+ *
+ * Returns NULL on OOM.
+ */
+void *ta_new_arena(void *ta_parent)
+{
+    // Never allocate the arena context itself from an arena.
+    struct ta_arena *arena = ta_zalloc_size(NULL, sizeof(struct ta_arena));
+    struct ta_ext_header *eh = get_or_alloc_ext_header(arena);
+    if (!eh) {
+        ta_free(arena);
+        return NULL;
+    }
+    arena->owner = eh->header;
+    arena->next_chunk_size = ARENA_MIN_CHUNK;
+    eh->arena = arena;
+    if (!ta_set_parent(arena, ta_parent)) {
+        ta_free(arena);
+        return NULL;
+    }
+    return arena;
+}
+
 /* Return the ptr's parent allocation, or NULL if there isn't any.
  *
  * Warning: this has O(N) runtime complexity with N sibling allocations!
@@ -319,7 +584,8 @@ static char allocation_is_string;
 static void ta_dbg_add(struct ta_header *h)
 {
     h->canary = CANARY;
-    if (enable_leak_check) {
+    // Arena memory is not individually freed when the arena goes away.
+    if (enable_leak_check && !get_owning_arena(h)) {
         pthread_mutex_lock(&ta_dbg_mutex);
         h->leak_next = &leak_node;
         h->leak_prev = leak_node.leak_prev;
@@ -351,9 +617,10 @@ static void ta_dbg_remove(struct ta_header *h)
 static size_t get_children_size(struct ta_header *h)
 {
     size_t size = 0;
-    if (h->ext) {
+    struct ta_ext_header *eh = get_ext(h);
+    if (eh) {
         struct ta_header *s;
-        for (s = h->ext->children.next; s != &h->ext->children; s = s->next)
+        for (s = eh->children.next; s != &eh->children; s = s->next)
             size += s->size + get_children_size(s);
     }
     return size;
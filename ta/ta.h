@@ -58,6 +58,7 @@ void *ta_find_parent(void *ptr);
 size_t ta_calc_array_size(size_t element_size, size_t count);
 size_t ta_calc_prealloc_elems(size_t nextidx);
 void *ta_new_context(void *ta_parent);
+void *ta_new_arena(void *ta_parent);
 void *ta_steal_(void *ta_parent, void *ptr);
 void *ta_memdup(void *ta_parent, void *ptr, size_t size);
 char *ta_strdup(void *ta_parent, const char *str);
@@ -109,6 +110,7 @@ bool ta_vasprintf_append_buffer(char **str, const char *fmt, va_list ap) TA_PRF(
 #define ta_xset_destructor(...)         ta_oom_b(ta_set_destructor(__VA_ARGS__))
 #define ta_xset_parent(...)             ta_oom_b(ta_set_parent(__VA_ARGS__))
 #define ta_xnew_context(...)            ta_oom_p(ta_new_context(__VA_ARGS__))
+#define ta_xnew_arena(...)              ta_oom_p(ta_new_arena(__VA_ARGS__))
 #define ta_xstrdup_append(...)          ta_oom_b(ta_strdup_append(__VA_ARGS__))
 #define ta_xstrdup_append_buffer(...)   ta_oom_b(ta_strdup_append_buffer(__VA_ARGS__))
 #define ta_xstrndup_append(...)         ta_oom_b(ta_strndup_append(__VA_ARGS__))
@@ -0,0 +1,113 @@
+// Prints the throughput of the bstr scanning functions on a large
+// subtitle-like text, compared to plain byte-by-byte loops.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common/common.h"
+#include "misc/bstr.h"
+#include "osdep/timer.h"
+#include "mpv_talloc.h"
+
+static int ref_bstrchr(struct bstr str, int c)
+{
+    for (int i = 0; i < str.len; i++)
+        if (str.start[i] == c)
+            return i;
+    return -1;
+}
+
+static int ref_bstrcspn(struct bstr str, const char *reject)
+{
+    int i;
+    for (i = 0; i < str.len; i++)
+        if (strchr(reject, str.start[i]))
+            break;
+    return i;
+}
+
+static int ref_bstr_find(struct bstr haystack, struct bstr needle)
+{
+    for (int i = 0; i < haystack.len; i++)
+        if (bstr_startswith(bstr_splice(haystack, i, haystack.len), needle))
+            return i;
+    return -1;
+}
+
+static int ref_bstr_validate_utf8(struct bstr s)
+{
+    while (s.len) {
+        if (bstr_decode_utf8(s, &s) < 0)
+            return -8;
+    }
+    return 0;
+}
+
+// Keeps the compiler from optimizing the scans away.
+static volatile int sink;
+
+// Return the time in microseconds it takes to run the given scan over s.
+static int64_t run_scan(bstr s, int scan, bool ref)
+{
+    int64_t start = mp_time_us();
+    bstr rest = s;
+    int r = 0;
+    switch (scan) {
+    case 0:
+        while (rest.len) {
+            if (ref) {
+                int pos = ref_bstrchr(rest, '\n');
+                rest = pos < 0 ? (bstr){0} : bstr_cut(rest, pos + 1);
+            } else {
+                bstr_splitchar(rest, &rest, '\n');
+            }
+            r++;
+        }
+        break;
+    case 1:
+        while (rest.len) {
+            int pos = ref ? ref_bstrcspn(rest, "\r\n")
+                          : bstrcspn(rest, "\r\n");
+            rest = bstr_cut(rest, pos + 1);
+            r++;
+        }
+        break;
+    case 2:
+        r = ref ? ref_bstr_find(s, bstr0("Needle"))
+                : bstr_find(s, bstr0("Needle"));
+        break;
+    case 3:
+        r = ref ? ref_bstr_validate_utf8(s) : bstr_validate_utf8(s);
+        break;
+    }
+    sink = r;
+    return mp_time_us() - start;
+}
+
+int main(void)
+{
+    static const char *const names[] = {
+        "bstr_splitchar()", "bstrcspn()", "bstr_find()", "bstr_validate_utf8()",
+    };
+    const int len = 16 * 1024 * 1024;
+    unsigned char *buf = talloc_size(NULL, len);
+    srand(2);
+    for (int i = 0; i < len; i++)
+        buf[i] = i % 60 == 59 ? '\n' : 'a' + rand() % 26;
+    bstr s = {buf, len};
+
+    mp_time_init();
+
+    double mb = len / (1024.0 * 1024.0);
+    printf("MB/s on 60 byte ASCII lines (byte loops in parentheses):\n");
+    for (int n = 0; n < MP_ARRAY_SIZE(names); n++) {
+        int64_t t = run_scan(s, n, false);
+        int64_t t_ref = run_scan(s, n, true);
+        printf("  %-22s %6.0f (%.0f)\n", names[n],
+               mb / (MPMAX(t, 1) / 1e6), mb / (MPMAX(t_ref, 1) / 1e6));
+    }
+
+    talloc_free(buf);
+    return 0;
+}
@@ -0,0 +1,304 @@
+// Prints the cost of encoding and decoding a typical IPC message with
+// json_parse() and json_write(), compared to the implementation from before
+// the scanning and formatting fast paths were added (copied below).
+
+#include <errno.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "common/common.h"
+#include "misc/bstr.h"
+#include "misc/json.h"
+#include "osdep/timer.h"
+#include "mpv_talloc.h"
+
+static int ref_json_parse(void *ta_parent, struct mpv_node *dst, char **src,
+                          int max_depth);
+
+static bool ref_eat_c(char **s, char c)
+{
+    if (**s == c) {
+        *s += 1;
+        return true;
+    }
+    return false;
+}
+
+static void ref_eat_ws(char **src)
+{
+    while (1) {
+        char c = **src;
+        if (c != ' ' && c != '\t' && c != '\n' && c != '\r')
+            return;
+        *src += 1;
+    }
+}
+
+static int ref_read_str(void *ta_parent, struct mpv_node *dst, char **src)
+{
+    if (!ref_eat_c(src, '"'))
+        return -1;
+    char *str = *src;
+    char *cur = str;
+    bool has_escapes = false;
+    while (cur[0] && cur[0] != '"') {
+        if (cur[0] == '\\') {
+            has_escapes = true;
+            if (cur[1] == '"' || cur[1] == '\\')
+                cur++;
+        }
+        cur++;
+    }
+    if (cur[0] != '"')
+        return -1;
+    cur[0] = '\0';
+    *src = cur + 1;
+    if (has_escapes) {
+        bstr unescaped = {0};
+        bstr r = bstr0(str);
+        if (!mp_append_escaped_string(ta_parent, &unescaped, &r))
+            return -1;
+        str = unescaped.start;
+    }
+    dst->format = MPV_FORMAT_STRING;
+    dst->u.string = str;
+    return 0;
+}
+
+static int ref_read_sub(void *ta_parent, struct mpv_node *dst, char **src,
+                        int max_depth)
+{
+    bool is_arr = ref_eat_c(src, '[');
+    bool is_obj = !is_arr && ref_eat_c(src, '{');
+    if (!is_arr && !is_obj)
+        return -1;
+    char term = is_obj ? '}' : ']';
+    struct mpv_node_list *list = talloc_zero(ta_parent, struct mpv_node_list);
+    while (1) {
+        ref_eat_ws(src);
+        if (ref_eat_c(src, term))
+            break;
+        if (list->num > 0 && !ref_eat_c(src, ','))
+            return -1;
+        ref_eat_ws(src);
+        if (is_obj) {
+            struct mpv_node keynode;
+            if (ref_read_str(list, &keynode, src) < 0)
+                return -1;
+            ref_eat_ws(src);
+            if (!ref_eat_c(src, ':'))
+                return -1;
+            ref_eat_ws(src);
+            MP_TARRAY_GROW(list, list->keys, list->num);
+            list->keys[list->num] = keynode.u.string;
+        }
+        MP_TARRAY_GROW(list, list->values, list->num);
+        if (ref_json_parse(ta_parent, &list->values[list->num], src,
+                           max_depth) < 0)
+            return -1;
+        list->num++;
+    }
+    dst->format = is_obj ? MPV_FORMAT_NODE_MAP : MPV_FORMAT_NODE_ARRAY;
+    dst->u.list = list;
+    return 0;
+}
+
+static int ref_json_parse(void *ta_parent, struct mpv_node *dst, char **src,
+                          int max_depth)
+{
+    max_depth -= 1;
+    if (max_depth < 0)
+        return -1;
+
+    ref_eat_ws(src);
+
+    char c = **src;
+    if (!c)
+        return -1;
+    if (c == 'n' && strncmp(*src, "null", 4) == 0) {
+        *src += 4;
+        dst->format = MPV_FORMAT_NONE;
+        return 0;
+    } else if (c == 't' && strncmp(*src, "true", 4) == 0) {
+        *src += 4;
+        dst->format = MPV_FORMAT_FLAG;
+        dst->u.flag = 1;
+        return 0;
+    } else if (c == 'f' && strncmp(*src, "false", 5) == 0) {
+        *src += 5;
+        dst->format = MPV_FORMAT_FLAG;
+        dst->u.flag = 0;
+        return 0;
+    } else if (c == '"') {
+        return ref_read_str(ta_parent, dst, src);
+    } else if (c == '[' || c == '{') {
+        return ref_read_sub(ta_parent, dst, src, max_depth);
+    } else if (c == '-' || (c >= '0' && c <= '9')) {
+        char *nsrci = *src, *nsrcf = *src;
+        errno = 0;
+        long long int numi = strtoll(*src, &nsrci, 0);
+        if (errno)
+            nsrci = *src;
+        errno = 0;
+        double numf = strtod(*src, &nsrcf);
+        if (errno)
+            nsrcf = *src;
+        if (nsrci >= nsrcf) {
+            *src = nsrci;
+            dst->format = MPV_FORMAT_INT64;
+            dst->u.int64 = numi;
+            return 0;
+        }
+        if (nsrcf > *src && isfinite(numf)) {
+            *src = nsrcf;
+            dst->format = MPV_FORMAT_DOUBLE;
+            dst->u.double_ = numf;
+            return 0;
+        }
+        return -1;
+    }
+    return -1;
+}
+
+#define APPEND(b, s) bstr_xappend(NULL, (b), bstr0(s))
+
+static void ref_write_str(bstr *b, unsigned char *str)
+{
+    APPEND(b, "\"");
+    while (1) {
+        unsigned char *cur = str;
+        while (cur[0] >= 32 && cur[0] != '"' && cur[0] != '\\')
+            cur++;
+        if (!cur[0])
+            break;
+        bstr_xappend(NULL, b, (bstr){str, cur - str});
+        bstr_xappend_asprintf(NULL, b, "\\u%04x", (unsigned char)cur[0]);
+        str = cur + 1;
+    }
+    APPEND(b, str);
+    APPEND(b, "\"");
+}
+
+static void ref_add_indent(bstr *b, int indent)
+{
+    if (indent < 0)
+        return;
+    bstr_xappend(NULL, b, bstr0("\n"));
+    for (int n = 0; n < indent; n++)
+        bstr_xappend(NULL, b, bstr0(" "));
+}
+
+static int ref_json_append(bstr *b, const struct mpv_node *src, int indent)
+{
+    switch (src->format) {
+    case MPV_FORMAT_NONE:
+        APPEND(b, "null");
+        return 0;
+    case MPV_FORMAT_FLAG:
+        APPEND(b, src->u.flag ? "true" : "false");
+        return 0;
+    case MPV_FORMAT_INT64:
+        bstr_xappend_asprintf(NULL, b, "%"PRId64, src->u.int64);
+        return 0;
+    case MPV_FORMAT_DOUBLE:
+        bstr_xappend_asprintf(NULL, b, "%f", src->u.double_);
+        return 0;
+    case MPV_FORMAT_STRING:
+        ref_write_str(b, src->u.string);
+        return 0;
+    case MPV_FORMAT_NODE_ARRAY:
+    case MPV_FORMAT_NODE_MAP: {
+        struct mpv_node_list *list = src->u.list;
+        bool is_obj = src->format == MPV_FORMAT_NODE_MAP;
+        APPEND(b, is_obj ? "{" : "[");
+        int next_indent = indent >= 0 ? indent + 1 : -1;
+        for (int n = 0; n < list->num; n++) {
+            if (n)
+                APPEND(b, ",");
+            ref_add_indent(b, next_indent);
+            if (is_obj) {
+                ref_write_str(b, list->keys[n]);
+                APPEND(b, ":");
+            }
+            ref_json_append(b, &list->values[n], next_indent);
+        }
+        ref_add_indent(b, indent);
+        APPEND(b, is_obj ? "}" : "]");
+        return 0;
+    }
+    }
+    return -1;
+}
+
+static char *ref_json_write(void *ta_parent, struct mpv_node *src, int indent)
+{
+    bstr b = {0};
+    ref_json_append(&b, src, indent);
+    return talloc_steal(ta_parent, (char *)b.start);
+}
+
+static char *new_json_write(void *ta_parent, struct mpv_node *src)
+{
+    char *s = talloc_strdup(ta_parent, "");
+    json_write(&s, src);
+    return s;
+}
+
+int main(void)
+{
+    void *ta_ctx = talloc_new(NULL);
+    const char *msg =
+        "{\"event\":\"property-change\",\"id\":1,\"name\":\"track-list\","
+        "\"data\":[{\"id\":1,\"type\":\"video\",\"src-id\":0,\"albumart\":false,"
+        "\"default\":true,\"forced\":false,\"codec\":\"h264\",\"demux-w\":1920,"
+        "\"demux-h\":1080,\"demux-fps\":23.976024,\"demux-par\":1.000000,"
+        "\"external\":false,\"selected\":true,\"ff-index\":0,"
+        "\"title\":\"Some \\\"quoted\\\" title with a fairly long name\"},"
+        "{\"id\":1,\"type\":\"audio\",\"src-id\":1,\"lang\":\"eng\","
+        "\"default\":true,\"codec\":\"aac\",\"demux-channel-count\":2,"
+        "\"demux-samplerate\":48000,\"selected\":true,\"ff-index\":1}]}";
+    const int iterations = 20000;
+
+    mp_time_init();
+
+    int64_t t[4];
+    for (int impl = 0; impl < 2; impl++) {
+        int64_t start = mp_time_us();
+        for (int n = 0; n < iterations; n++) {
+            void *tmp = talloc_new(NULL);
+            char *src = talloc_strdup(tmp, msg);
+            struct mpv_node node;
+            int r = impl ? ref_json_parse(tmp, &node, &src, 50)
+                         : json_parse(tmp, &node, &src, 50);
+            if (r < 0) {
+                fprintf(stderr, "Parsing failed.\n");
+                return 1;
+            }
+            talloc_free(tmp);
+        }
+        t[impl] = mp_time_us() - start;
+    }
+
+    char *src = talloc_strdup(ta_ctx, msg);
+    struct mpv_node node;
+    json_parse(ta_ctx, &node, &src, 50);
+    for (int impl = 0; impl < 2; impl++) {
+        int64_t start = mp_time_us();
+        for (int n = 0; n < iterations; n++) {
+            char *s = impl ? ref_json_write(NULL, &node, -1)
+                           : new_json_write(NULL, &node);
+            talloc_free(s);
+        }
+        t[2 + impl] = mp_time_us() - start;
+    }
+
+    printf("json_parse(): %.1f ns/message (reference: %.1f ns/message)\n",
+           t[0] * 1000.0 / iterations, t[1] * 1000.0 / iterations);
+    printf("json_write(): %.1f ns/message (reference: %.1f ns/message)\n",
+           t[2] * 1000.0 / iterations, t[3] * 1000.0 / iterations);
+
+    talloc_free(ta_ctx);
+    return 0;
+}
@@ -0,0 +1,147 @@
+// Prints the cost of allocating and updating m_config caches, using a
+// synthetic root config shaped like the player's.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+#include <malloc.h>
+#define HAVE_MALLINFO2 1
+#else
+#define HAVE_MALLINFO2 0
+#endif
+
+#include "common/common.h"
+#include "common/global.h"
+#include "options/m_config.h"
+#include "options/m_option.h"
+#include "osdep/timer.h"
+#include "mpv_talloc.h"
+
+#define NUM_GROUPS 40
+#define NUM_INTS 30     // int options per group
+#define NUM_STRINGS 6   // string options per group
+#define NUM_ROOT 150    // toplevel int options
+
+struct group_opts {
+    int i[NUM_INTS];
+    char *s[NUM_STRINGS];
+};
+
+struct root_opts {
+    int i[NUM_ROOT];
+    struct group_opts *groups[NUM_GROUPS];
+};
+
+static struct m_option group_options[NUM_GROUPS][NUM_INTS + NUM_STRINGS + 1];
+static struct m_sub_options groups[NUM_GROUPS];
+static struct m_option root_options[NUM_ROOT + NUM_GROUPS + 1];
+
+static size_t mem_used(void)
+{
+#if HAVE_MALLINFO2
+    return mallinfo2().uordblks;
+#else
+    return 0;
+#endif
+}
+
+static void setup_options(void *ta_ctx)
+{
+    for (int g = 0; g < NUM_GROUPS; g++) {
+        struct m_option *opts = group_options[g];
+        for (int n = 0; n < NUM_INTS; n++) {
+            *opts++ = (struct m_option){
+                .name = talloc_asprintf(ta_ctx, "g%d-int%d", g, n),
+                .type = &m_option_type_int,
+                .offset = offsetof(struct group_opts, i[n]),
+            };
+        }
+        for (int n = 0; n < NUM_STRINGS; n++) {
+            *opts++ = (struct m_option){
+                .name = talloc_asprintf(ta_ctx, "g%d-str%d", g, n),
+                .type = &m_option_type_string,
+                .offset = offsetof(struct group_opts, s[n]),
+            };
+        }
+        struct group_opts *defs = talloc_zero(ta_ctx, struct group_opts);
+        for (int n = 0; n < NUM_STRINGS; n++)
+            defs->s[n] = "some default value";
+        groups[g] = (struct m_sub_options){
+            .opts = group_options[g],
+            .size = sizeof(struct group_opts),
+            .defaults = defs,
+        };
+    }
+
+    struct m_option *opts = root_options;
+    for (int n = 0; n < NUM_ROOT; n++) {
+        *opts++ = (struct m_option){
+            .name = talloc_asprintf(ta_ctx, "int%d", n),
+            .type = &m_option_type_int,
+            .offset = offsetof(struct root_opts, i[n]),
+        };
+    }
+    for (int g = 0; g < NUM_GROUPS; g++) {
+        *opts++ = (struct m_option){
+            .name = "",
+            .type = &m_option_type_subconfig,
+            .offset = offsetof(struct root_opts, groups[g]),
+            .priv = &groups[g],
+        };
+    }
+}
+
+int main(void)
+{
+    void *ta_ctx = talloc_new(NULL);
+    mp_time_init();
+    setup_options(ta_ctx);
+
+    struct mpv_global *global = talloc_zero(ta_ctx, struct mpv_global);
+    struct m_config *root = m_config_new(ta_ctx, NULL, sizeof(struct root_opts),
+                                         NULL, root_options);
+    root->global = global;
+    m_config_create_shadow(root);
+
+    // One cache per group (VO, AO, decoders, demuxers, ...), created several
+    // times like during a player session.
+    const int rounds = 20;
+    const int num_caches = rounds * NUM_GROUPS;
+    void *caches = talloc_new(NULL);
+    size_t mem_start = mem_used();
+    int64_t start = mp_time_us();
+    for (int r = 0; r < rounds; r++) {
+        for (int g = 0; g < NUM_GROUPS; g++)
+            m_config_cache_alloc(caches, global, &groups[g]);
+    }
+    int64_t t_alloc = mp_time_us() - start;
+    size_t mem = mem_used() - mem_start;
+
+    // Change an option, and update a cache of the affected group.
+    struct m_config_cache *cache =
+        m_config_cache_alloc(caches, global, &groups[0]);
+    struct m_config_option *co = m_config_get_co(root, bstr0("g0-int3"));
+    const int iterations = 100000;
+    start = mp_time_us();
+    for (int n = 0; n < iterations; n++) {
+        int v = n;
+        m_config_set_option_raw(root, co, &v, 0);
+        m_config_cache_update(cache);
+    }
+    int64_t t_update = mp_time_us() - start;
+    if (((struct group_opts *)cache->opts)->i[3] != iterations - 1) {
+        fprintf(stderr, "Cache was not updated.\n");
+        return 1;
+    }
+
+    printf("%d options, %d caches: allocation %.1f us/cache", root->num_opts,
+           num_caches, t_alloc / (double)num_caches);
+    if (HAVE_MALLINFO2)
+        printf(", %zu bytes/cache", mem / num_caches);
+    printf("; set + update %.0f ns\n", t_update * 1000.0 / iterations);
+
+    talloc_free(caches);
+    talloc_free(ta_ctx);
+    return 0;
+}
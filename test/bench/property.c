@@ -0,0 +1,74 @@
+// Prints the cost of a property lookup via m_property_do(), compared to the
+// linear search over the property list the property table replaced.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "common/common.h"
+#include "options/m_property.h"
+#include "osdep/timer.h"
+#include "mpv_talloc.h"
+
+// Roughly the number of properties the player has (including options).
+#define NUM_PROPS 1200
+#define ITERATIONS 200000
+
+static int prop_value(void *ctx, struct m_property *prop, int action, void *arg)
+{
+    return m_property_int_ro(action, arg, (intptr_t)prop->priv);
+}
+
+// What m_property_do() did for each action before the property table.
+static struct m_property *list_find(const struct m_property *list,
+                                    const char *name)
+{
+    for (int n = 0; list[n].name; n++) {
+        if (strcmp(list[n].name, name) == 0)
+            return (struct m_property *)&list[n];
+    }
+    return NULL;
+}
+
+int main(void)
+{
+    void *ta_ctx = talloc_new(NULL);
+    mp_time_init();
+
+    struct m_property_table *t = m_property_table_create(ta_ctx);
+    for (int n = 0; n < NUM_PROPS; n++) {
+        struct m_property prop = {
+            .name = talloc_asprintf(t, "property-%d", n),
+            .call = prop_value,
+            .priv = (void *)(intptr_t)n,
+        };
+        m_property_table_add(t, prop);
+    }
+    const struct m_property *list = m_property_table_list(t);
+
+    int64_t start = mp_time_us();
+    for (int n = 0; n < ITERATIONS; n++) {
+        int v;
+        const char *name = list[n % NUM_PROPS].name;
+        m_property_do(NULL, t, name, M_PROPERTY_GET, &v, NULL);
+    }
+    int64_t hashed = mp_time_us() - start;
+
+    start = mp_time_us();
+    for (int n = 0; n < ITERATIONS; n++) {
+        // (m_property_do() used to search once for each action)
+        int v;
+        const char *name = list[n % NUM_PROPS].name;
+        struct m_property *prop = list_find(list, name);
+        prop->call(NULL, prop, M_PROPERTY_GET_TYPE, &(struct m_option){0});
+        prop = list_find(list, name);
+        prop->call(NULL, prop, M_PROPERTY_GET, &v);
+    }
+    int64_t linear = mp_time_us() - start;
+
+    printf("m_property_do() with %d properties: %.1f ns/call "
+           "(linear search: %.1f ns/call)\n", NUM_PROPS,
+           hashed * 1000.0 / ITERATIONS, linear * 1000.0 / ITERATIONS);
+
+    talloc_free(ta_ctx);
+    return 0;
+}
@@ -0,0 +1,139 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "test_helpers.h"
+#include "common/common.h"
+#include "misc/bstr.h"
+#include "mpv_talloc.h"
+
+// Byte-by-byte versions of the scanning functions, to compare against.
+
+static int ref_bstrchr(struct bstr str, int c)
+{
+    for (int i = 0; i < str.len; i++)
+        if (str.start[i] == c)
+            return i;
+    return -1;
+}
+
+static int ref_bstrcspn(struct bstr str, const char *reject)
+{
+    int i;
+    for (i = 0; i < str.len; i++)
+        if (strchr(reject, str.start[i]))
+            break;
+    return i;
+}
+
+static int ref_bstrspn(struct bstr str, const char *accept)
+{
+    int i;
+    for (i = 0; i < str.len; i++)
+        if (!strchr(accept, str.start[i]))
+            break;
+    return i;
+}
+
+static int ref_bstr_find(struct bstr haystack, struct bstr needle)
+{
+    for (int i = 0; i < haystack.len; i++)
+        if (bstr_startswith(bstr_splice(haystack, i, haystack.len), needle))
+            return i;
+    return -1;
+}
+
+static int ref_bstr_validate_utf8(struct bstr s)
+{
+    while (s.len) {
+        if (bstr_decode_utf8(s, &s) < 0) {
+            unsigned int codepoint = (unsigned char)s.start[0];
+            int bytes = bstr_parse_utf8_code_length(codepoint);
+            if (bytes > 1 && s.len < 6) {
+                for (int n = 1; n < bytes; n++) {
+                    if (n >= s.len)
+                        return -(bytes - s.len);
+                    int tmp = (unsigned char)s.start[n];
+                    if ((tmp & 0xC0) != 0x80)
+                        break;
+                }
+            }
+            return -8;
+        }
+    }
+    return 0;
+}
+
+// Fill buf with text that is mostly ASCII, with some newlines, 0 bytes, UTF-8
+// sequences and (rarely) invalid bytes.
+static void fill_random(unsigned char *buf, int len)
+{
+    static const char *utf8[] = {"\xc3\xa4", "\xe2\x82\xac", "\xf0\x9f\x98\x80"};
+    int i = 0;
+    while (i < len) {
+        int r = rand() % 100;
+        if (r < 3) {
+            buf[i++] = '\n';
+        } else if (r < 4) {
+            buf[i++] = 0;
+        } else if (r < 8) {
+            const char *s = utf8[rand() % 3];
+            for (int n = 0; s[n] && i < len; n++)
+                buf[i++] = s[n];
+        } else if (r < 9 && rand() % 4 == 0) {
+            buf[i++] = 0x80 + rand() % 128;
+        } else {
+            buf[i++] = 'a' + rand() % 8;
+        }
+    }
+}
+
+static void test_bstr_scan(void **state)
+{
+    unsigned char buf[300];
+    const char *sets[] = {"", ",", "\n", "abc", " \t\r\n", "h\xc3"};
+    srand(1);
+    for (int iter = 0; iter < 20000; iter++) {
+        int len = rand() % 260;
+        int offset = rand() % 32;
+        fill_random(buf + offset, len);
+        bstr s = {buf + offset, len};
+
+        int c = "abh\n\xc3\x80"[rand() % 6] & 0xFF;
+        assert_int_equal(bstrchr(s, c), ref_bstrchr(s, c));
+        assert_int_equal(bstrchr(s, 0), ref_bstrchr(s, 0));
+        assert_int_equal(bstrchr(s, -1), -1);
+
+        const char *set = sets[rand() % MP_ARRAY_SIZE(sets)];
+        assert_int_equal(bstrcspn(s, set), ref_bstrcspn(s, set));
+        assert_int_equal(bstrspn(s, set), ref_bstrspn(s, set));
+
+        bstr needle = bstr_splice(s, rand() % (len + 1), rand() % (len + 1));
+        if (rand() % 2)
+            needle = bstr_splice(needle, 0, rand() % 4);
+        assert_int_equal(bstr_find(s, needle), ref_bstr_find(s, needle));
+        assert_int_equal(bstr_find(s, bstr0("ab\n")),
+                         ref_bstr_find(s, bstr0("ab\n")));
+
+        assert_int_equal(bstr_validate_utf8(s), ref_bstr_validate_utf8(s));
+
+        void *tmp = talloc_new(NULL);
+        bstr *lines = bstr_splitlines(tmp, s);
+        bstr rest = s;
+        int count = 0;
+        while (rest.len) {
+            bstr line = bstr_splitchar(rest, &rest, '\n');
+            assert_true(bstr_equals(line, lines[count]));
+            assert_ptr_equal(line.start, lines[count].start);
+            count++;
+        }
+        assert_int_equal(MP_TALLOC_AVAIL(lines), count);
+        talloc_free(tmp);
+    }
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_bstr_scan),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,183 @@
+#include <pthread.h>
+#include <sched.h>
+
+#include "test_helpers.h"
+#include "misc/dispatch.h"
+#include "mpv_talloc.h"
+
+#define NUM_PRODUCERS 4
+#define ITERATIONS 20000
+
+struct test_ctx {
+    struct mp_dispatch_queue *queue;
+    // Only accessed by the target thread, or while holding mp_dispatch_lock().
+    int64_t value;
+    int last_seq[NUM_PRODUCERS];
+    int notified;
+    int done;
+};
+
+struct producer {
+    struct test_ctx *ctx;
+    int id;
+    int seq;
+    // Statistics of what was queued.
+    int items, notifies, locks;
+};
+
+struct item {
+    struct test_ctx *ctx;
+    int producer;
+    int seq;
+};
+
+static uint32_t next_rand(uint32_t *state)
+{
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+static void run_item(void *p)
+{
+    struct item *item = p;
+    struct test_ctx *ctx = item->ctx;
+    ctx->value++;
+    // Items from the same producer must run in the order they were added,
+    // regardless of how they were queued.
+    assert_int_equal(item->seq, ctx->last_seq[item->producer] + 1);
+    ctx->last_seq[item->producer] = item->seq;
+}
+
+static void run_and_free_item(void *p)
+{
+    run_item(p);
+    talloc_free(p);
+}
+
+static void notify_cb(void *p)
+{
+    struct test_ctx *ctx = p;
+    ctx->notified++;
+}
+
+static void finish_cb(void *p)
+{
+    struct test_ctx *ctx = p;
+    ctx->done++;
+    mp_dispatch_interrupt(ctx->queue);
+}
+
+static struct item *new_item(struct producer *pr)
+{
+    struct item *item = talloc_ptrtype(NULL, item);
+    *item = (struct item){pr->ctx, pr->id, ++pr->seq};
+    pr->items++;
+    return item;
+}
+
+static void *producer_thread(void *p)
+{
+    struct producer *pr = p;
+    struct test_ctx *ctx = pr->ctx;
+    uint32_t rnd = pr->id + 1;
+    for (int n = 0; n < ITERATIONS; n++) {
+        switch (next_rand(&rnd) % 16) {
+        case 0: {
+            mp_dispatch_lock(ctx->queue);
+            // Make a lost update likely if the lock isn't exclusive.
+            int64_t v = ctx->value;
+            sched_yield();
+            ctx->value = v + 1;
+            mp_dispatch_unlock(ctx->queue);
+            pr->locks++;
+            break;
+        }
+        case 1:
+        case 2: {
+            struct item item = {ctx, pr->id, ++pr->seq};
+            pr->items++;
+            mp_dispatch_run(ctx->queue, run_item, &item);
+            break;
+        }
+        case 3:
+        case 4:
+            mp_dispatch_enqueue_notify(ctx->queue, notify_cb, ctx);
+            pr->notifies++;
+            break;
+        case 5:
+        case 6:
+        case 7:
+            mp_dispatch_enqueue_autofree(ctx->queue, run_item, new_item(pr));
+            break;
+        default:
+            mp_dispatch_enqueue(ctx->queue, run_and_free_item, new_item(pr));
+        }
+    }
+    mp_dispatch_enqueue(ctx->queue, finish_cb, ctx);
+    return NULL;
+}
+
+static void noop_wakeup(void *p)
+{
+}
+
+static void run_stress_test(bool wakeup_fn)
+{
+    struct test_ctx ctx = {0};
+    ctx.queue = mp_dispatch_create(NULL);
+    // With a wakeup callback, the target thread must be woken from waiting
+    // on the queue without being interrupted.
+    if (wakeup_fn)
+        mp_dispatch_set_wakeup_fn(ctx.queue, noop_wakeup, NULL);
+
+    struct producer producers[NUM_PRODUCERS];
+    pthread_t threads[NUM_PRODUCERS];
+    for (int n = 0; n < NUM_PRODUCERS; n++) {
+        producers[n] = (struct producer){.ctx = &ctx, .id = n};
+        assert_int_equal(pthread_create(&threads[n], NULL, producer_thread,
+                                        &producers[n]), 0);
+    }
+
+    while (ctx.done < NUM_PRODUCERS)
+        mp_dispatch_queue_process(ctx.queue, 10.0);
+
+    int items = 0, notifies = 0, locks = 0;
+    for (int n = 0; n < NUM_PRODUCERS; n++) {
+        pthread_join(threads[n], NULL);
+        assert_int_equal(ctx.last_seq[n], producers[n].seq);
+        items += producers[n].items;
+        notifies += producers[n].notifies;
+        locks += producers[n].locks;
+    }
+    assert_int_equal(ctx.value, items + locks);
+    // Notifications can be merged, but at least the last one must have run.
+    assert_true(ctx.notified > 0 && ctx.notified <= notifies);
+
+    struct mp_dispatch_stats stats;
+    mp_dispatch_get_stats(ctx.queue, &stats);
+    assert_int_equal(stats.items, items + ctx.notified + NUM_PRODUCERS);
+    assert_int_equal(stats.locks, locks);
+
+    talloc_free(ctx.queue);
+}
+
+static void test_dispatch_interrupt(void **state)
+{
+    run_stress_test(false);
+}
+
+static void test_dispatch_wakeup_fn(void **state)
+{
+    run_stress_test(true);
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_dispatch_interrupt),
+        cmocka_unit_test(test_dispatch_wakeup_fn),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,181 @@
+#include <string.h>
+
+#include "test_helpers.h"
+#include "common/common.h"
+#include "misc/json.h"
+#include "mpv_talloc.h"
+
+static char *write_json(void *ta_parent, struct mpv_node *src, bool pretty)
+{
+    char *s = talloc_strdup(ta_parent, "");
+    if (pretty) {
+        assert_int_equal(json_write_pretty(&s, src), 0);
+    } else {
+        assert_int_equal(json_write(&s, src), 0);
+    }
+    return s;
+}
+
+static void test_json_write_numbers(void **state)
+{
+    void *ta_ctx = talloc_new(NULL);
+
+    static const struct {
+        double v;
+        const char *res;
+    } doubles[] = {
+        {0,                  "0.000000"},
+        {-0.0,               "-0.000000"},
+        {0.5e-6,             "0.000000"},
+        {1.5e-6,             "0.000002"},
+        {2.5e-6,             "0.000003"},
+        {-0.5e-6,            "-0.000000"},
+        {1e-7,               "0.000000"},
+        {-1e-7,              "-0.000000"},
+        {0.1,                "0.100000"},
+        {1.0 / 3,            "0.333333"},
+        {123456.7890125,     "123456.789012"},
+        {999999999.9999995,  "1000000000.000000"},
+        {1e9,                "1000000000.000000"},
+        {1e20,               "100000000000000000000.000000"},
+        {INFINITY,           "inf"},
+        {NAN,                "nan"},
+    };
+    for (int n = 0; n < MP_ARRAY_SIZE(doubles); n++) {
+        struct mpv_node node = {.format = MPV_FORMAT_DOUBLE,
+                                .u.double_ = doubles[n].v};
+        assert_string_equal(write_json(ta_ctx, &node, false), doubles[n].res);
+    }
+
+    static const struct {
+        int64_t v;
+        const char *res;
+    } ints[] = {
+        {0,         "0"},
+        {-1,        "-1"},
+        {9,         "9"},
+        {10,        "10"},
+        {INT64_MAX, "9223372036854775807"},
+        {INT64_MIN, "-9223372036854775808"},
+    };
+    for (int n = 0; n < MP_ARRAY_SIZE(ints); n++) {
+        struct mpv_node node = {.format = MPV_FORMAT_INT64,
+                                .u.int64 = ints[n].v};
+        assert_string_equal(write_json(ta_ctx, &node, false), ints[n].res);
+    }
+
+    talloc_free(ta_ctx);
+}
+
+static void test_json_write_strings(void **state)
+{
+    void *ta_ctx = talloc_new(NULL);
+
+    struct mpv_node node = {
+        .format = MPV_FORMAT_STRING,
+        .u.string = "q\"b\\s/\x01\x1f\t\n\xc3\xa4",
+    };
+    assert_string_equal(write_json(ta_ctx, &node, false),
+        "\"q\\u0022b\\u005cs/\\u0001\\u001f\\u0009\\u000a\xc3\xa4\"");
+
+    char *text = talloc_strdup(ta_ctx,
+        "{\"a\":[1,2.5,\"x\",{}],\"b\":{\"c\":null},\"d\":[]}");
+    assert_int_equal(json_parse(ta_ctx, &node, &text, 3), 0);
+    assert_string_equal(write_json(ta_ctx, &node, false),
+        "{\"a\":[1,2.500000,\"x\",{}],\"b\":{\"c\":null},\"d\":[]}");
+    assert_string_equal(write_json(ta_ctx, &node, true),
+        "{\n \"a\":[\n  1,\n  2.500000,\n  \"x\",\n  {\n  }\n ],\n"
+        " \"b\":{\n  \"c\":null\n },\n \"d\":[\n ]\n}");
+
+    talloc_free(ta_ctx);
+}
+
+static void test_json_parse(void **state)
+{
+    void *ta_ctx = talloc_new(NULL);
+
+    // Input, the parsed value written back with json_write() (NULL if parsing
+    // is expected to fail), and the number of input bytes consumed.
+    static const struct {
+        const char *src;
+        const char *res;
+        int consumed;
+    } tests[] = {
+        {"null", "null", 4},
+        {"true", "true", 4},
+        {"false", "false", 5},
+        {"0", "0", 1},
+        {"-0", "0", 2},
+        {"12", "12", 2},
+        {"-12", "-12", 3},
+        {"0x10", "16", 4},
+        {"010", "8", 3},
+        {"1e3", "1000.000000", 3},
+        {"1.5", "1.500000", 3},
+        {"-inf", NULL},
+        {"123abc", "123", 3},
+        {"999999999999999999", "999999999999999999", 18},
+        {"9223372036854775807", "9223372036854775807", 19},
+        {"9223372036854775808", "9223372036854775808.000000", 19},
+        {"-9223372036854775808", "-9223372036854775808", 20},
+        {"\"\"", "\"\"", 2},
+        {"\"abc\"", "\"abc\"", 5},
+        {"\"with \\\"escapes\\\" and \\\\ \\n \\u0041 in it\"",
+         "\"with \\u0022escapes\\u0022 and \\u005c \\u000a A in it\"", 41},
+        {"\"unterminated", NULL},
+        {"\"ends with backslash\\", NULL},
+        {"\"12345678\\\\\"", "\"12345678\\u005c\"", 12},
+        {"[]", "[]", 2},
+        {"{}", "{}", 2},
+        {"[1,2,3]", "[1,2,3]", 7},
+        {"[1,2,]", NULL},
+        {"{\"a\":1,\"b\":[true,null]}", "{\"a\":1,\"b\":[true,null]}", 23},
+        {"{\"a\" 1}", NULL},
+        {"{1:2}", NULL},
+        {"[[[[[[[[[[[[1]]]]]]]]]]]]", NULL},
+        {"  {  \"command\"  :  [ \"set_property\" , \"pause\" , true ]  }  ",
+         "{\"command\":[\"set_property\",\"pause\",true]}", 57},
+    };
+    for (int n = 0; n < MP_ARRAY_SIZE(tests); n++) {
+        char *text = talloc_strdup(ta_ctx, tests[n].src);
+        char *start = text;
+        struct mpv_node node;
+        int r = json_parse(ta_ctx, &node, &text, 10);
+        if (!tests[n].res) {
+            assert_int_equal(r, -1);
+            continue;
+        }
+        assert_int_equal(r, 0);
+        assert_int_equal(text - start, tests[n].consumed);
+        assert_string_equal(write_json(ta_ctx, &node, false), tests[n].res);
+    }
+
+    char *text = talloc_strdup(ta_ctx, "{\"a\":[1,2.5,\"x\"],\"b\":{}} rest");
+    struct mpv_node node;
+    assert_int_equal(json_parse(ta_ctx, &node, &text, 3), 0);
+    assert_string_equal(text, " rest");
+    assert_int_equal(node.format, MPV_FORMAT_NODE_MAP);
+    assert_int_equal(node.u.list->num, 2);
+    assert_string_equal(node.u.list->keys[0], "a");
+    struct mpv_node *arr = &node.u.list->values[0];
+    assert_int_equal(arr->format, MPV_FORMAT_NODE_ARRAY);
+    assert_int_equal(arr->u.list->num, 3);
+    assert_int_equal(arr->u.list->values[0].u.int64, 1);
+    assert_double_equal(arr->u.list->values[1].u.double_, 2.5);
+    assert_string_equal(arr->u.list->values[2].u.string, "x");
+    assert_int_equal(node.u.list->values[1].u.list->num, 0);
+
+    text = talloc_strdup(ta_ctx, "[[1]]");
+    assert_int_equal(json_parse(ta_ctx, &node, &text, 2), -1);
+
+    talloc_free(ta_ctx);
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_json_write_numbers),
+        cmocka_unit_test(test_json_write_strings),
+        cmocka_unit_test(test_json_parse),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,128 @@
+#include <string.h>
+
+#include "test_helpers.h"
+#include "common/common.h"
+#include "misc/bstr.h"
+#include "misc/json.h"
+#include "misc/msgpack.h"
+#include "mpv_talloc.h"
+
+static const struct {
+    const char *json;
+    const char *msgpack;
+    int len;
+} encodings[] = {
+#define E(j, m) {j, m, sizeof(m) - 1}
+    E("null",               "\xc0"),
+    E("true",               "\xc3"),
+    E("false",              "\xc2"),
+    E("0",                  "\x00"),
+    E("127",                "\x7f"),
+    E("128",                "\xcc\x80"),
+    E("65536",              "\xce\x00\x01\x00\x00"),
+    E("4294967296",         "\xcf\x00\x00\x00\x01\x00\x00\x00\x00"),
+    E("-1",                 "\xff"),
+    E("-32",                "\xe0"),
+    E("-33",                "\xd0\xdf"),
+    E("-32769",             "\xd2\xff\xff\x7f\xff"),
+    E("1.500000",           "\xcb\x3f\xf8\x00\x00\x00\x00\x00\x00"),
+    E("\"\"",               "\xa0"),
+    E("\"abc\"",            "\xa3" "abc"),
+    E("[]",                 "\x90"),
+    E("[1,[2]]",            "\x92\x01\x91\x02"),
+    E("{}",                 "\x80"),
+    E("{\"a\":null}",       "\x81\xa1" "a" "\xc0"),
+#undef E
+};
+
+static char *to_json(void *ta_parent, struct mpv_node *node)
+{
+    char *s = talloc_strdup(ta_parent, "");
+    assert_int_equal(json_write(&s, node), 0);
+    return s;
+}
+
+static void test_msgpack_encodings(void **state)
+{
+    for (int n = 0; n < MP_ARRAY_SIZE(encodings); n++) {
+        void *tmp = talloc_new(NULL);
+
+        char *src = talloc_strdup(tmp, encodings[n].json);
+        struct mpv_node node;
+        assert_int_equal(json_parse(tmp, &node, &src, 10), 0);
+
+        bstr out = {0};
+        assert_int_equal(msgpack_write(tmp, &out, &node), 0);
+        assert_int_equal(out.len, encodings[n].len);
+        assert_memory_equal(out.start, encodings[n].msgpack, out.len);
+
+        struct mpv_node parsed;
+        bstr in = out;
+        assert_int_equal(msgpack_parse(tmp, &parsed, &in, 10), 0);
+        assert_int_equal(in.len, 0);
+        assert_string_equal(to_json(tmp, &parsed), encodings[n].json);
+
+        talloc_free(tmp);
+    }
+}
+
+static void test_msgpack_parse(void **state)
+{
+    void *tmp = talloc_new(NULL);
+    struct mpv_node node;
+
+    // Wider encodings than necessary, float32, bin, uint64 > INT64_MAX.
+    static const char data[] =
+        "\xcd\x00\x05" "\xd3\xff\xff\xff\xff\xff\xff\xff\xfe"
+        "\xca\x3f\xc0\x00\x00" "\xc4\x02" "ab"
+        "\xcf\xff\xff\xff\xff\xff\xff\xff\xff" "\xd9\x01" "x";
+    bstr in = {(unsigned char *)data, sizeof(data) - 1};
+    assert_int_equal(msgpack_parse(tmp, &node, &in, 0), 0);
+    assert_int_equal(node.format, MPV_FORMAT_INT64);
+    assert_int_equal(node.u.int64, 5);
+    assert_int_equal(msgpack_parse(tmp, &node, &in, 0), 0);
+    assert_int_equal(node.format, MPV_FORMAT_INT64);
+    assert_int_equal(node.u.int64, -2);
+    assert_int_equal(msgpack_parse(tmp, &node, &in, 0), 0);
+    assert_int_equal(node.format, MPV_FORMAT_DOUBLE);
+    assert_true(node.u.double_ == 1.5);
+    assert_int_equal(msgpack_parse(tmp, &node, &in, 0), 0);
+    assert_int_equal(node.format, MPV_FORMAT_BYTE_ARRAY);
+    assert_int_equal(node.u.ba->size, 2);
+    assert_memory_equal(node.u.ba->data, "ab", 2);
+    assert_int_equal(msgpack_parse(tmp, &node, &in, 0), 0);
+    assert_int_equal(node.format, MPV_FORMAT_DOUBLE);
+    assert_true(node.u.double_ == 18446744073709551615.0);
+    assert_int_equal(msgpack_parse(tmp, &node, &in, 0), 0);
+    assert_int_equal(node.format, MPV_FORMAT_STRING);
+    assert_string_equal(node.u.string, "x");
+    assert_int_equal(in.len, 0);
+
+    // Invalid or truncated data, unsupported types, non-string map keys,
+    // exceeding max_depth.
+    static const struct { const char *data; int len; } bad[] = {
+        {"", 0},
+        {"\xc1", 1},
+        {"\xd4\x01\x00", 3},
+        {"\xa3" "ab", 3},
+        {"\xcd\x00", 2},
+        {"\x92\x01", 2},
+        {"\xdd\xff\xff\xff\xff\x00", 6},
+        {"\x81\x01\x02", 3},
+        {"\x91\x91\x91\xc0", 4},
+    };
+    for (int n = 0; n < MP_ARRAY_SIZE(bad); n++) {
+        in = (bstr){(unsigned char *)bad[n].data, bad[n].len};
+        assert_true(msgpack_parse(tmp, &node, &in, 2) < 0);
+    }
+
+    talloc_free(tmp);
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_msgpack_encodings),
+        cmocka_unit_test(test_msgpack_parse),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,72 @@
+#include "test_helpers.h"
+#include "common/common.h"
+#include "options/m_property.h"
+#include "mpv_talloc.h"
+
+// Roughly the number of properties the player has (including options).
+#define NUM_PROPS 1200
+
+static int prop_value(void *ctx, struct m_property *prop, int action, void *arg)
+{
+    int value = (intptr_t)prop->priv;
+    if (action == M_PROPERTY_KEY_ACTION) {
+        struct m_property_action_arg *ka = arg;
+        if (strcmp(ka->key, "neg") != 0)
+            return M_PROPERTY_UNKNOWN;
+        return m_property_int_ro(ka->action, ka->arg, -value);
+    }
+    return m_property_int_ro(action, arg, value);
+}
+
+static struct m_property_table *create_table(void *ta_parent)
+{
+    struct m_property_table *t = m_property_table_create(ta_parent);
+    for (int n = 0; n < NUM_PROPS; n++) {
+        struct m_property prop = {
+            .name = talloc_asprintf(t, "property-%d", n),
+            .call = prop_value,
+            .priv = (void *)(intptr_t)n,
+        };
+        assert_true(m_property_table_add(t, prop));
+    }
+    return t;
+}
+
+static void test_property_table_lookup(void **state) {
+    void *ta_ctx = talloc_new(NULL);
+    struct m_property_table *t = create_table(ta_ctx);
+
+    const struct m_property *list = m_property_table_list(t);
+    for (int n = 0; n < NUM_PROPS; n++) {
+        int id = m_property_table_find_id(t, bstr0(list[n].name));
+        assert_int_equal(id, n);
+        assert_ptr_equal(m_property_table_get(t, id), &list[n]);
+    }
+    assert_null(list[NUM_PROPS].name);
+
+    struct m_property dup = { .name = "property-7", .call = prop_value };
+    assert_false(m_property_table_add(t, dup));
+    assert_int_equal(m_property_table_find_id(t, bstr0("property")), -1);
+    assert_null(m_property_table_find(t, "unknown"));
+
+    int v = 0;
+    assert_int_equal(m_property_do(NULL, t, "property-123", M_PROPERTY_GET,
+                                   &v, NULL), M_PROPERTY_OK);
+    assert_int_equal(v, 123);
+    assert_int_equal(m_property_do(NULL, t, "property-123/neg", M_PROPERTY_GET,
+                                   &v, NULL), M_PROPERTY_OK);
+    assert_int_equal(v, -123);
+    assert_int_equal(m_property_do(NULL, t, "property-123/", M_PROPERTY_GET,
+                                   &v, NULL), M_PROPERTY_UNKNOWN);
+    assert_int_equal(m_property_do(NULL, t, "property-", M_PROPERTY_GET,
+                                   &v, NULL), M_PROPERTY_UNKNOWN);
+
+    talloc_free(ta_ctx);
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_property_table_lookup),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,105 @@
+#include <pthread.h>
+#include <sched.h>
+
+#include "test_helpers.h"
+#include "common/common.h"
+#include "misc/ring.h"
+#include "mpv_talloc.h"
+
+#define TOTAL_BYTES (64 * 1024 * 1024)
+
+// Simple xorshift PRNG, so that the threads don't share rand() state.
+static uint32_t next_rand(uint32_t *state)
+{
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+// The stream of bytes passed through the ring is a simple function of the
+// stream position, so the reader can verify it.
+static unsigned char byte_at(int64_t pos)
+{
+    return pos * 7 + (pos >> 11);
+}
+
+static void *writer_thread(void *p)
+{
+    struct mp_ring *ring = p;
+    uint32_t rnd = 1;
+    unsigned char tmp[1000];
+    int64_t pos = 0;
+    while (pos < TOTAL_BYTES) {
+        int len = MPMIN(next_rand(&rnd) % 1000 + 1, TOTAL_BYTES - pos);
+        if (next_rand(&rnd) % 2) {
+            struct mp_ring_span span;
+            len = mp_ring_reserve(ring, len, &span);
+            assert_int_equal(span.len[0] + span.len[1], len);
+            for (int i = 0; i < 2; i++) {
+                for (int n = 0; n < span.len[i]; n++)
+                    span.data[i][n] = byte_at(pos++);
+            }
+            mp_ring_commit(ring, len);
+        } else {
+            for (int n = 0; n < len; n++)
+                tmp[n] = byte_at(pos + n);
+            pos += mp_ring_write(ring, tmp, len);
+        }
+        if (!len)
+            sched_yield();
+    }
+    return NULL;
+}
+
+static void test_ring_spsc(void **state)
+{
+    // Odd size, so that positions and wrap-arounds get misaligned.
+    void *ctx = talloc_new(NULL);
+    struct mp_ring *ring = mp_ring_new(ctx, 4099);
+    assert_int_equal(mp_ring_size(ring), 4099);
+
+    pthread_t writer;
+    assert_int_equal(pthread_create(&writer, NULL, writer_thread, ring), 0);
+
+    uint32_t rnd = 2;
+    unsigned char tmp[1000];
+    int64_t pos = 0;
+    while (pos < TOTAL_BYTES) {
+        int len = next_rand(&rnd) % 1000 + 1;
+        int got;
+        if (next_rand(&rnd) % 2) {
+            struct mp_ring_span span;
+            got = mp_ring_peek(ring, len, &span);
+            assert_int_equal(span.len[0] + span.len[1], got);
+            int64_t p = pos;
+            for (int i = 0; i < 2; i++) {
+                for (int n = 0; n < span.len[i]; n++)
+                    assert_int_equal(span.data[i][n], byte_at(p++));
+            }
+            // Consume only a part sometimes; the rest must be seen again.
+            if (got && next_rand(&rnd) % 4 == 0)
+                got = next_rand(&rnd) % got;
+            assert_int_equal(mp_ring_drain(ring, got), got);
+        } else {
+            got = mp_ring_read(ring, tmp, len);
+            for (int n = 0; n < got; n++)
+                assert_int_equal(tmp[n], byte_at(pos + n));
+        }
+        pos += got;
+        if (!got)
+            sched_yield();
+    }
+
+    pthread_join(writer, NULL);
+    assert_int_equal(mp_ring_buffered(ring), 0);
+    talloc_free(ctx);
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_ring_spsc),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,69 @@
+#include <string.h>
+
+#include "test_helpers.h"
+#include "common/common.h"
+#include "mpv_talloc.h"
+
+static int destructor_calls;
+
+static void count_dtor(void *p)
+{
+    destructor_calls += 1;
+}
+
+static void test_ta_arena(void **state)
+{
+    void *arena = talloc_new_arena(NULL);
+
+    // The most recent allocation is resized in place.
+    char *s = talloc_strdup(arena, "abc");
+    char *s2 = talloc_strdup_append_buffer(s, "def");
+    assert_ptr_equal(s, s2);
+    assert_string_equal(s2, "abcdef");
+
+    // Others are copied.
+    int *a = talloc_array(arena, int, 4);
+    for (int n = 0; n < 4; n++)
+        a[n] = n;
+    char *other = talloc_strdup(arena, "x");
+    a = talloc_realloc(arena, a, int, 10000);
+    for (int n = 0; n < 4; n++)
+        assert_int_equal(a[n], n);
+    assert_int_equal(talloc_get_size(a), 10000 * sizeof(int));
+    assert_string_equal(other, "x");
+
+    // Nested contexts, and allocations with children being moved around.
+    void *ctx = talloc_new(arena);
+    char *child = talloc_strdup(ctx, "child");
+    void *ctx2 = talloc_new(arena);
+    talloc_steal(ctx2, child);
+    talloc_free(ctx);
+    assert_string_equal(child, "child");
+    assert_ptr_equal(talloc_parent(child), ctx2);
+
+    // Children with destructors and non-arena allocations are freed.
+    void *d = talloc_new(ctx2);
+    talloc_set_destructor(d, count_dtor);
+    char *heap = talloc_strdup(NULL, "heap");
+    talloc_steal(ctx2, heap);
+    destructor_calls = 0;
+    talloc_free_children(arena);
+    assert_int_equal(destructor_calls, 1);
+
+    // The arena is still usable after that.
+    int *z = talloc_zero_array(arena, int, 100);
+    for (int n = 0; n < 100; n++)
+        assert_int_equal(z[n], 0);
+
+    void *d2 = talloc_zero_size(arena, 1);
+    talloc_set_destructor(d2, count_dtor);
+    talloc_free(arena);
+    assert_int_equal(destructor_calls, 2);
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_ta_arena),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,130 @@
+#include <unistd.h>
+
+#include "test_helpers.h"
+#include "misc/thread_pool.h"
+#include "osdep/atomic.h"
+#include "mpv_talloc.h"
+
+struct job_ctx {
+    atomic_bool *block;
+    atomic_int *counter;
+    int order;
+};
+
+static void blocking_job(void *p)
+{
+    struct job_ctx *ctx = p;
+    atomic_fetch_add(ctx->counter, 1);
+    while (atomic_load(ctx->block))
+        usleep(1000);
+}
+
+static void counting_job(void *p)
+{
+    struct job_ctx *ctx = p;
+    ctx->order = atomic_fetch_add(ctx->counter, 1);
+}
+
+static void test_thread_pool_order(void **state)
+{
+    struct mp_thread_pool *pool = mp_thread_pool_create(NULL, 1);
+    assert_non_null(pool);
+
+    atomic_bool block = ATOMIC_VAR_INIT(true);
+    atomic_int counter = ATOMIC_VAR_INIT(0);
+    struct job_ctx blocker = {.block = &block, .counter = &counter};
+    struct job_ctx jobs[4];
+    for (int n = 0; n < 4; n++)
+        jobs[n] = (struct job_ctx){.counter = &counter, .order = -1};
+
+    // Make the only worker busy, so all following jobs stay queued.
+    struct mp_thread_pool_job *b = mp_thread_pool_submit(pool, 0, blocking_job,
+                                                         &blocker);
+    while (atomic_load(&counter) < 1)
+        usleep(1000);
+    struct mp_thread_pool_job *h[4];
+    h[0] = mp_thread_pool_submit(pool, MP_THREAD_POOL_BACKGROUND,
+                                 counting_job, &jobs[0]);
+    h[1] = mp_thread_pool_submit(pool, 0, counting_job, &jobs[1]);
+    h[2] = mp_thread_pool_submit(pool, 0, counting_job, &jobs[2]);
+    h[3] = mp_thread_pool_submit(pool, 0, counting_job, &jobs[3]);
+
+    assert_true(mp_thread_pool_cancel(h[2]));
+    atomic_store(&block, false);
+    // (Waiting on a queued job would run it on this thread.)
+    while (atomic_load(&counter) < 4)
+        usleep(1000);
+    mp_thread_pool_wait(b);
+    for (int n = 0; n < 4; n++) {
+        if (n != 2)
+            mp_thread_pool_wait(h[n]);
+    }
+
+    // Interactive jobs in FIFO order, then background jobs.
+    assert_int_equal(jobs[1].order, 1);
+    assert_int_equal(jobs[3].order, 2);
+    assert_int_equal(jobs[0].order, 3);
+    assert_int_equal(jobs[2].order, -1);
+
+    talloc_free(pool);
+}
+
+static struct mp_thread_pool *nested_pool;
+
+static void nested_job(void *p)
+{
+    struct job_ctx *ctx = p;
+    struct job_ctx sub[8];
+    struct mp_thread_pool_job *h[8];
+    for (int n = 0; n < 8; n++) {
+        sub[n] = (struct job_ctx){.counter = ctx->counter};
+        h[n] = mp_thread_pool_submit(nested_pool, 0, counting_job, &sub[n]);
+    }
+    for (int n = 0; n < 8; n++)
+        mp_thread_pool_wait(h[n]);
+}
+
+static void test_thread_pool_nested(void **state)
+{
+    // Jobs waiting on jobs they queued must not deadlock, even if there are
+    // more of them than worker threads.
+    nested_pool = mp_thread_pool_create(NULL, 2);
+    assert_non_null(nested_pool);
+
+    atomic_int counter = ATOMIC_VAR_INIT(0);
+    struct job_ctx ctx[16];
+    struct mp_thread_pool_job *h[16];
+    for (int n = 0; n < 16; n++) {
+        ctx[n] = (struct job_ctx){.counter = &counter};
+        h[n] = mp_thread_pool_submit(nested_pool, 0, nested_job, &ctx[n]);
+    }
+    for (int n = 0; n < 16; n++)
+        mp_thread_pool_wait(h[n]);
+    assert_int_equal(atomic_load(&counter), 16 * 8);
+
+    talloc_free(nested_pool);
+}
+
+static void test_thread_pool_shared(void **state)
+{
+    struct mp_thread_pool *a = mp_thread_pool_shared_ref();
+    struct mp_thread_pool *b = mp_thread_pool_shared_ref();
+    assert_non_null(a);
+    assert_ptr_equal(a, b);
+
+    atomic_int counter = ATOMIC_VAR_INIT(0);
+    struct job_ctx ctx = {.counter = &counter};
+    mp_thread_pool_queue(a, counting_job, &ctx);
+    mp_thread_pool_shared_unref(a);
+    mp_thread_pool_shared_unref(b); // waits for the queued job
+    assert_int_equal(atomic_load(&counter), 1);
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_thread_pool_order),
+        cmocka_unit_test(test_thread_pool_nested),
+        cmocka_unit_test(test_thread_pool_shared),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
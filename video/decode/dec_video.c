@@ -34,6 +34,8 @@
 
 #include "common/codecs.h"
 #include "common/recorder.h"
+#include "common/perf_counters.h"
+#include "common/tracing.h"
 
 #include "video/out/vo.h"
 #include "video/csputils.h"
@@ -276,11 +278,16 @@ static bool send_packet(struct dec_video *d_video, struct demux_packet *packet)
         d_video->first_packet_pdts = pkt_pdts;
 
     MP_STATS(d_video, "start decode video");
+    mp_trace_begin("video-send-packet");
 
     bool res = d_video->vd_driver->send_packet(d_video, packet);
 
+    mp_trace_end("video-send-packet");
     MP_STATS(d_video, "end decode video");
 
+    if (res && packet)
+        mp_perf_inc(MP_PERF_VIDEO_DEC_PACKETS);
+
     // Stream recording can't deal with almost surely wrong fake DTS.
     if (dts_replaced)
         packet->dts = MP_NOPTS_VALUE;
@@ -296,15 +303,19 @@ static bool receive_frame(struct dec_video *d_video, struct mp_image **out_image
     assert(!*out_image);
 
     MP_STATS(d_video, "start decode video");
+    mp_trace_begin("video-receive-frame");
 
     bool progress = d_video->vd_driver->receive_frame(d_video, &mpi);
 
+    mp_trace_end("video-receive-frame");
     MP_STATS(d_video, "end decode video");
 
     // Error, EOF, discarded frame, dropped frame, or initial codec delay.
     if (!mpi)
         return progress;
 
+    mp_perf_inc(MP_PERF_VIDEO_DEC_FRAMES);
+
     // Note: the PTS is reordered, but the DTS is not. Both should be monotonic.
     double pts = mpi->pts;
     double dts = mpi->dts;
@@ -387,6 +398,12 @@ void video_set_framedrop(struct dec_video *d_video, bool enabled)
     d_video->framedrop_enabled = enabled;
 }
 
+// Discard all non-keyframes in the decoder. (Used for scrubbing.)
+void video_set_keyframes_only(struct dec_video *d_video, bool enabled)
+{
+    d_video->keyframes_only = enabled;
+}
+
 // Frames before the start timestamp can be dropped. (Used for hr-seek.)
 void video_set_start(struct dec_video *d_video, double start_pts)
 {
@@ -424,6 +441,8 @@ void video_work(struct dec_video *d_video)
         start_pts = d_video->start;
 
     int framedrop_type = d_video->framedrop_enabled ? 1 : 0;
+    if (d_video->keyframes_only)
+        framedrop_type = 3;
     if (start_pts != MP_NOPTS_VALUE && d_video->packet &&
         d_video->packet->pts < start_pts - .005 &&
         !d_video->has_broken_packet_pts)
@@ -447,8 +466,10 @@ void video_work(struct dec_video *d_video)
     if (!progress) {
         d_video->current_state = DATA_EOF;
     } else if (!d_video->current_mpi) {
-        if (framedrop_type == 1)
+        if (framedrop_type == 1) {
             d_video->dropped_frames += 1;
+            mp_perf_inc(MP_PERF_VIDEO_DEC_DROPPED);
+        }
         d_video->current_state = DATA_AGAIN;
     }
 
@@ -77,6 +77,7 @@ struct dec_video {
     struct demux_packet *new_segment;
     struct demux_packet *packet;
     bool framedrop_enabled;
+    bool keyframes_only;
     struct mp_image *current_mpi;
     int current_state;
 };
@@ -90,6 +91,7 @@ void video_work(struct dec_video *d_video);
 int video_get_frame(struct dec_video *d_video, struct mp_image **out_mpi);
 
 void video_set_framedrop(struct dec_video *d_video, bool enabled);
+void video_set_keyframes_only(struct dec_video *d_video, bool enabled);
 void video_set_start(struct dec_video *d_video, double start_pts);
 
 int video_vd_control(struct dec_video *d_video, int cmd, void *arg);
@@ -949,6 +949,8 @@ static bool prepare_decoding(struct dec_video *vd)
         // Can be much more aggressive for true intra codecs.
         if (ctx->intra_only)
             avctx->skip_frame = AVDISCARD_ALL;
+    } else if (drop == 3) {
+        avctx->skip_frame = AVDISCARD_NONKEY;   // scrubbing
     } else {
         avctx->skip_frame = ctx->skip_frame;    // normal playback
     }
@@ -29,8 +29,11 @@
 #include "common/common.h"
 #include "common/global.h"
 #include "common/msg.h"
+#include "common/perf_counters.h"
+#include "common/tracing.h"
 #include "options/m_option.h"
 #include "options/m_config.h"
+#include "osdep/timer.h"
 
 #include "options/options.h"
 
@@ -237,6 +240,8 @@ static struct vf_instance *vf_open(struct vf_chain *c, const char *name,
         .query_format = vf_default_query_format,
         .out_pool = talloc_steal(vf, mp_image_pool_new(16)),
         .chain = c,
+        .time_counter = mp_perf_counter_register(
+                            mp_tprintf(80, "vf-%s-time-us", name)),
     };
     struct m_config *config =
         m_config_from_obj_desc_and_args(vf, vf->log, c->global, &desc,
@@ -353,10 +358,27 @@ void vf_add_output_frame(struct vf_instance *vf, struct mp_image *img)
     }
 }
 
+// Time a call to one of the filter functions, for tracing and the
+// performance counters.
+static int64_t filter_begin(struct vf_instance *vf)
+{
+    mp_trace_begin(vf->info->name);
+    return mp_time_us();
+}
+
+static void filter_end(struct vf_instance *vf, int64_t start)
+{
+    mp_perf_add(vf->time_counter, mp_time_us() - start);
+    mp_trace_end(vf->info->name);
+}
+
 static bool vf_has_output_frame(struct vf_instance *vf)
 {
     if (!vf->num_out_queued && vf->filter_out) {
-        if (vf->filter_out(vf) < 0)
+        int64_t t = filter_begin(vf);
+        int r = vf->filter_out(vf);
+        filter_end(vf, t);
+        if (r < 0)
             MP_ERR(vf, "Error filtering frame.\n");
     }
     return vf->num_out_queued > 0;
@@ -379,14 +401,19 @@ static int vf_do_filter(struct vf_instance *vf, struct mp_image *img)
         assert(mp_image_params_equal(&img->params, &vf->fmt_in));
 
     if (vf->filter_ext) {
+        int64_t t = filter_begin(vf);
         int r = vf->filter_ext(vf, img);
+        filter_end(vf, t);
         if (r < 0)
             MP_ERR(vf, "Error filtering frame.\n");
         return r;
     } else {
         if (img) {
-            if (vf->filter)
+            if (vf->filter) {
+                int64_t t = filter_begin(vf);
                 img = vf->filter(vf, img);
+                filter_end(vf, t);
+            }
             vf_add_output_frame(vf, img);
         }
         return 0;
@@ -770,6 +797,7 @@ struct vf_chain *vf_new(struct mpv_global *global)
         .log = c->log,
         .info = &in,
         .query_format = input_query_format,
+        .time_counter = -1,
     };
     static const struct vf_info out = { .name = "out" };
     c->last = talloc(c, struct vf_instance);
@@ -779,6 +807,7 @@ struct vf_chain *vf_new(struct mpv_global *global)
         .info = &out,
         .query_format = output_query_format,
         .priv = (void *)c,
+        .time_counter = -1,
     };
     c->first->next = c->last;
     return c;
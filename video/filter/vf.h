@@ -95,6 +95,7 @@ typedef struct vf_instance {
     struct AVBufferRef *in_hwframes_ref, *out_hwframes_ref;
 
     struct mp_image_pool *out_pool;
+    int time_counter; // perf. counter for time spent filtering (-1 if none)
     struct vf_priv_s *priv;
     struct mp_log *log;
     struct mp_hwdec_devices *hwdec_devs;
@@ -29,6 +29,7 @@
 #include "mpv_talloc.h"
 
 #include "common/common.h"
+#include "common/mem_account.h"
 
 #include "fmt-conversion.h"
 #include "mp_image.h"
@@ -62,6 +63,7 @@ struct image_flags {
     bool referenced;            // outside mp_image reference exists
     bool pool_alive;            // the mp_image_pool references this
     unsigned int order;         // for LRU allocation (basically a timestamp)
+    size_t size;                // accounted to MP_MEM_IMAGE_POOLS
 };
 
 static void image_pool_destructor(void *ptr)
@@ -167,10 +169,23 @@ struct mp_image *mp_image_pool_get_no_alloc(struct mp_image_pool *pool, int fmt,
     return ref;
 }
 
+// Freed with the image.
+static void image_flags_destructor(void *ptr)
+{
+    struct image_flags *it = ptr;
+    mp_mem_account(MP_MEM_IMAGE_POOLS, -(int64_t)it->size);
+}
+
 void mp_image_pool_add(struct mp_image_pool *pool, struct mp_image *new)
 {
     struct image_flags *it = talloc_ptrtype(new, it);
-    *it = (struct image_flags) { .pool_alive = true };
+    *it = (struct image_flags) {
+        .pool_alive = true,
+        // (For hw surfaces, this is just the size of the wrapper.)
+        .size = new->bufs[0] ? new->bufs[0]->size : 0,
+    };
+    talloc_set_destructor(it, image_flags_destructor);
+    mp_mem_account(MP_MEM_IMAGE_POOLS, it->size);
     new->priv = it;
     MP_TARRAY_APPEND(pool, pool->images, pool->num_images, new);
 }
@@ -41,6 +41,8 @@
 #include "options/m_config.h"
 #include "common/msg.h"
 #include "common/global.h"
+#include "common/perf_counters.h"
+#include "common/tracing.h"
 #include "video/hwdec.h"
 #include "video/mp_image.h"
 #include "sub/osd.h"
@@ -362,6 +364,7 @@ void vo_destroy(struct vo *vo)
     struct vo_internal *in = vo->in;
     mp_dispatch_run(in->dispatch, terminate_vo, vo);
     pthread_join(vo->in->thread, NULL);
+    mp_dispatch_log_stats(in->dispatch, vo->log, "VO");
     dealloc_vo(vo);
 }
 
@@ -853,6 +856,8 @@ static bool render_frame(struct vo *vo)
 
     if (in->dropped_frame) {
         in->drop_count += 1;
+        mp_perf_inc(MP_PERF_VO_DROPPED);
+        mp_trace_instant("vo-drop");
     } else {
         in->rendering = true;
         in->hasframe_rendered = true;
@@ -861,6 +866,7 @@ static bool render_frame(struct vo *vo)
         wakeup_core(vo); // core can queue new video now
 
         MP_STATS(vo, "start video-draw");
+        mp_trace_begin("vo-draw");
 
         if (vo->driver->draw_frame) {
             vo->driver->draw_frame(vo, frame);
@@ -868,16 +874,23 @@ static bool render_frame(struct vo *vo)
             vo->driver->draw_image(vo, mp_image_new_ref(frame->current));
         }
 
+        mp_trace_end("vo-draw");
         MP_STATS(vo, "end video-draw");
 
+        mp_trace_begin("vo-wait");
         wait_until(vo, target);
+        mp_trace_end("vo-wait");
 
         MP_STATS(vo, "start video-flip");
+        mp_trace_begin("vo-flip");
 
         vo->driver->flip_page(vo);
 
+        mp_trace_end("vo-flip");
         MP_STATS(vo, "end video-flip");
 
+        mp_perf_inc(MP_PERF_VO_RENDERED);
+
         pthread_mutex_lock(&in->lock);
         in->dropped_frame = prev_drop_count < vo->in->drop_count;
         in->rendering = false;
@@ -941,6 +954,7 @@ static void do_redraw(struct vo *vo)
     }
 
     vo->driver->flip_page(vo);
+    mp_perf_inc(MP_PERF_VO_REDRAWN);
 
     if (frame != &dummy)
         talloc_free(frame);
@@ -1041,6 +1055,7 @@ void vo_increment_drop_count(struct vo *vo, int64_t n)
 {
     pthread_mutex_lock(&vo->in->lock);
     vo->in->drop_count += n;
+    mp_perf_add(MP_PERF_VO_DROPPED, n);
     pthread_mutex_unlock(&vo->in->lock);
 }
 
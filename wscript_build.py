@@ -225,7 +225,10 @@ def build(ctx):
         ( "common/codecs.c" ),
         ( "common/encode_lavc.c",                "encoding" ),
         ( "common/common.c" ),
+        ( "common/mem_account.c" ),
+        ( "common/perf_counters.c" ),
         ( "common/tags.c" ),
+        ( "common/tracing.c" ),
         ( "common/msg.c" ),
         ( "common/playlist.c" ),
         ( "common/recorder.c" ),
@@ -266,8 +269,11 @@ def build(ctx):
         ## Misc
         ( "misc/bstr.c" ),
         ( "misc/charset_conv.c" ),
+        ( "misc/dir_cache.c" ),
         ( "misc/dispatch.c" ),
         ( "misc/json.c" ),
+        ( "misc/msgpack.c" ),
+        ( "misc/name_index.c" ),
         ( "misc/node.c" ),
         ( "misc/ring.c" ),
         ( "misc/rendezvous.c" ),
@@ -529,7 +535,7 @@ def build(ctx):
                 ctx.path.find_node('osdep/mpv.rc'),
                 version)
 
-    if ctx.dependency_satisfied('cplayer') or ctx.dependency_satisfied('test'):
+    if any(ctx.dependency_satisfied(d) for d in ['cplayer', 'test', 'benchmarks']):
         ctx(
             target       = "objects",
             source       = ctx.filtered_sources(sources),
@@ -582,6 +588,17 @@ def build(ctx):
                 install_path = None,
             )
 
+    if ctx.dependency_satisfied('benchmarks'):
+        for bench in ctx.path.ant_glob("test/bench/*.c"):
+            ctx(
+                target       = os.path.splitext(bench.srcpath())[0],
+                source       = bench.srcpath(),
+                use          = ctx.dependencies_use() + ['objects'],
+                includes     = _all_includes(ctx),
+                features     = "c cprogram",
+                install_path = None,
+            )
+
     build_shared = ctx.dependency_satisfied('libmpv-shared')
     build_static = ctx.dependency_satisfied('libmpv-static')
     if build_shared or build_static: